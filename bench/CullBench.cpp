@@ -0,0 +1,161 @@
+// Frustum culling microbenchmark: spheres tested per second for each code
+// path, plus the threaded whole-scene cull and the transform update feeding
+// it, what a job costs on the job system, and how many heap allocations the
+// transform update and cull still make once warmed up. The rest of the
+// frame (render graph, passes, submit) needs the app's own heap count, printed
+// with its profile.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "../src/Arena.hpp"
+#include "../src/Culling.hpp"
+#include "../src/Jobs.hpp"
+#include "../src/Scene.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Every heap allocation in the process, from any thread
+static std::atomic<uint64_t> gAllocations{0};
+
+void* operator new(size_t size){
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* pointer = std::malloc(size == 0 ? 1 : size)){
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept{
+    std::free(pointer);
+}
+
+static double secondsSince(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv){
+    const size_t nodeCount  = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    const int iterations    = 20;
+
+    // Flat-ish hierarchy: groups of 64 nodes under a shared parent
+    Scene scene;
+    scene.reserve(nodeCount);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+    NodeId parent = INVALID_NODE;
+    for(size_t i = 0; i < nodeCount; i++){
+        NodeId node = scene.createNode(i % 64 == 0 ? INVALID_NODE : parent);
+        if(i % 64 == 0) parent = node;
+
+        scene.setTranslation(node, glm::vec3(position(rng), position(rng), position(rng)));
+        scene.setLocalBounds(node, glm::vec3(0.0f), radius(rng));
+    }
+
+    auto start = Clock::now();
+    scene.updateTransforms();
+    printf("transform update (all dirty): %8.3f ms for %zu nodes\n", secondsSince(start) * 1e3, nodeCount);
+
+    // Move one group root, only its subtree gets recomputed
+    scene.setTranslation(static_cast<NodeId>(nodeCount / 2 / 64 * 64), glm::vec3(1.0f));
+    start = Clock::now();
+    scene.updateTransforms();
+    printf("transform update (one subtree): %6.3f ms\n", secondsSince(start) * 1e3);
+
+    // Box of roughly a quarter of the volume as the frustum
+    Frustum frustum;
+    frustum.planes[0] = glm::vec4( 1.0f,  0.0f,  0.0f, 25.0f);
+    frustum.planes[1] = glm::vec4(-1.0f,  0.0f,  0.0f, 25.0f);
+    frustum.planes[2] = glm::vec4( 0.0f,  1.0f,  0.0f, 25.0f);
+    frustum.planes[3] = glm::vec4( 0.0f, -1.0f,  0.0f, 25.0f);
+    frustum.planes[4] = glm::vec4( 0.0f,  0.0f,  1.0f, 50.0f);
+    frustum.planes[5] = glm::vec4( 0.0f,  0.0f, -1.0f, 50.0f);
+
+    std::vector<uint32_t> visible(nodeCount);
+
+    const CullPath paths[] = {CullPath::Scalar, CullPath::SSE, CullPath::AVX2};
+    for(CullPath path : paths){
+        if(path == CullPath::AVX2 && bestCullPath() != CullPath::AVX2) continue;
+        if(path != CullPath::Scalar && bestCullPath() == CullPath::Scalar) continue;
+
+        size_t survivors = 0;
+        start = Clock::now();
+        for(int it = 0; it < iterations; it++){
+            survivors = cullSpheres(frustum,
+                                    scene.boundsX.data(), scene.boundsY.data(),
+                                    scene.boundsZ.data(), scene.boundsRadius.data(),
+                                    0, nodeCount, visible.data(), path);
+        }
+        double seconds = secondsSince(start) / iterations;
+
+        printf("cull %-6s 1 thread : %8.3f ms, %7.1f M objects/s, %zu visible\n",
+               cullPathName(path), seconds * 1e3, nodeCount / seconds / 1e6, survivors);
+    }
+
+    CpuProfiler profiler;
+    JobSystem jobs(0, &profiler);
+
+    profiler.beginFrame();
+    start = Clock::now();
+    for(int it = 0; it < iterations; it++){
+        cullScene(scene, frustum, visible, &jobs);
+    }
+    double seconds = secondsSince(start) / iterations;
+    profiler.beginFrame();
+
+    printf("cull %-6s %2u threads: %7.3f ms, %7.1f M objects/s, %zu visible\n",
+           cullPathName(CullPath::Auto), jobs.threadCount(), seconds * 1e3, nodeCount / seconds / 1e6, visible.size());
+
+    for(const ProfileSummary& summary : profiler.summarize()){
+        printf("  %-12s %5u jobs, %7.3f ms longest\n", summary.name, summary.count, summary.longest);
+    }
+
+    // Steady state frame: transforms, cull with a per frame arena, profiler
+    // rollover. The first frames size the arena, queues and profiler buffers.
+    LinearArena frameArena;
+    const int warmupFrames = 4;
+    uint64_t allocations = 0;
+
+    for(int it = 0; it < warmupFrames + iterations; it++){
+        if(it == warmupFrames){
+            allocations = gAllocations.load();
+        }
+
+        frameArena.reset();
+        profiler.beginFrame();
+
+        scene.setTranslation(static_cast<NodeId>(it % (nodeCount / 64) * 64), glm::vec3(float(it)));
+        scene.updateTransforms();
+        cullScene(scene, frustum, visible, &jobs, &frameArena);
+    }
+    allocations = gAllocations.load() - allocations;
+
+    printf("steady transforms + cull: %.2f heap allocations per frame, %zu bytes of frame arena\n",
+           double(allocations) / iterations, frameArena.peak());
+
+    // Scheduling overhead: empty jobs through the queues and back
+    const int jobCount = 100000;
+    JobCounter counter;
+    start = Clock::now();
+    for(int i = 0; i < jobCount; i++){
+        jobs.run("empty", [](){}, &counter);
+    }
+    jobs.wait(counter);
+    seconds = secondsSince(start);
+
+    printf("job system: %d empty jobs, %.3f us each\n", jobCount, seconds * 1e6 / jobCount);
+
+    return EXIT_SUCCESS;
+}
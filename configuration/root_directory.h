@@ -1 +1 @@
-const char * logl_root = "/home/jae/WorkSpace/Personal/VK/VK_WORK";
+static const char * logl_root = "/home/jae/WorkSpace/Personal/VK/VK_WORK";
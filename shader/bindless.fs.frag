@@ -0,0 +1,33 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+// Matches Material in src/Bindless.hpp
+struct Material {
+    vec4 baseColor;
+    uint albedoTexture;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+layout(set = 0, binding = 1) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawConstants {
+    uint materialIndex;
+    uint instanceIndex;
+} draw;
+
+void main() {
+    Material material = materials[draw.materialIndex];
+    vec4 albedo = texture(textures[nonuniformEXT(material.albedoTexture)], fragUV);
+    outColor = vec4(fragColor, 1.0) * albedo * material.baseColor;
+}
\ No newline at end of file
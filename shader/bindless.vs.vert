@@ -0,0 +1,26 @@
+#version 450
+
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+vec3 colors[3] = vec3[](
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0)
+);
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec2 fragUV;
+
+// Drawn again by the depth pre-pass pipeline, whose depth the color pass
+// tests for EQUAL
+invariant gl_Position;
+
+void main(){
+    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex];
+    fragUV = positions[gl_VertexIndex] + vec2(0.5);
+}
\ No newline at end of file
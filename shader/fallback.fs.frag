@@ -0,0 +1,10 @@
+#version 450
+
+// Stands in for a material while its pipeline compiles in the background.
+// Reads nothing, so it links against any of the scene vertex stages.
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
\ No newline at end of file
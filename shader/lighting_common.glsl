@@ -0,0 +1,101 @@
+// Shared by the light culling compute shader and the mesh fragment shader,
+// see src/Lighting.hpp
+
+// ClusteredLighting::CLUSTERS_X/Y/Z and MAX_CLUSTER_LIGHTS in src/Lighting.hpp
+const uint CLUSTERS_X           = 16;
+const uint CLUSTERS_Y           = 9;
+const uint CLUSTERS_Z           = 24;
+const uint CLUSTER_COUNT        = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+const uint MAX_CLUSTER_LIGHTS   = 128;
+
+// Scene pipelines put the set after their own
+#ifndef LIGHT_SET
+#define LIGHT_SET 0
+#endif
+
+// Matches Light in src/Lighting.hpp
+struct Light {
+    vec3  position;
+    float range;
+    vec3  color;
+    float spotScale;
+    vec3  direction;
+    float spotOffset;
+};
+
+// Matches ClusterParams in src/Lighting.hpp
+layout(std430, set = LIGHT_SET, binding = 0) readonly buffer ClusterParams {
+    mat4  view;
+    vec4  eye;
+    vec4  projection;
+    vec2  tileScale;
+    float sliceScale;
+    float sliceBias;
+    float nearPlane;
+    float farPlane;
+    uint  lightCount;
+} clusters;
+
+layout(std430, set = LIGHT_SET, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+
+#ifdef LIGHT_CULL
+#define CLUSTER_ACCESS writeonly
+#else
+#define CLUSTER_ACCESS readonly
+#endif
+
+layout(std430, set = LIGHT_SET, binding = 2) CLUSTER_ACCESS buffer ClusterCounts {
+    uint clusterCounts[];
+};
+
+// MAX_CLUSTER_LIGHTS slots per cluster
+layout(std430, set = LIGHT_SET, binding = 3) CLUSTER_ACCESS buffer ClusterLights {
+    uint clusterLights[];
+};
+
+#ifndef LIGHT_CULL
+// Of a world space position at window position `fragCoord`
+uint fragmentCluster(vec3 position, vec2 fragCoord){
+    float viewDepth = -(clusters.view * vec4(position, 1.0)).z;
+    float slice = log(max(viewDepth, clusters.nearPlane)) * clusters.sliceScale + clusters.sliceBias;
+
+    uvec3 cluster = min(uvec3(fragCoord * clusters.tileScale, max(slice, 0.0)),
+                        uvec3(CLUSTERS_X - 1, CLUSTERS_Y - 1, CLUSTERS_Z - 1));
+    return (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x;
+}
+
+// Inverse square, windowed to reach 0 at the range
+float distanceFalloff(float distanceSquared, float range){
+    float ratio = distanceSquared / (range * range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    return window * window / max(distanceSquared, 0.01);
+}
+
+// Diffuse plus a little Blinn-Phong specular from the lights of `cluster`
+vec3 clusteredLighting(uint cluster, vec3 position, vec3 normal, vec3 albedo){
+    vec3 toEye = normalize(clusters.eye.xyz - position);
+    uint count = clusterCounts[cluster];
+    uint base = cluster * MAX_CLUSTER_LIGHTS;
+
+    vec3 result = vec3(0.0);
+    for(uint i = 0; i < count; i++){
+        Light light = lights[clusterLights[base + i]];
+
+        vec3 toLight = light.position - position;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 l = toLight * inversesqrt(max(distanceSquared, 1e-8));
+
+        // Point lights have a scale of 0 and an offset of 1
+        float spot = clamp(dot(-l, light.direction) * light.spotScale + light.spotOffset, 0.0, 1.0);
+        float attenuation = spot * spot * distanceFalloff(distanceSquared, light.range);
+
+        float diffuse = max(dot(normal, l), 0.0);
+        float specular = pow(max(dot(normal, normalize(l + toEye)), 0.0), 32.0) * 0.25;
+
+        result += light.color * (attenuation * diffuse) * (albedo + specular);
+    }
+    return result;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#version 450
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+#if defined(CLUSTERED_LIGHTING) || defined(SHADOWS)
+#extension GL_GOOGLE_include_directive : require
+#endif
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragMaterial;
+layout(location = 3) in vec3 fragPosition;     // world space, like the normal
+
+layout(location = 0) out vec4 outColor;
+
+// Matches ShadingView in src/Application.hpp, a pipeline constant so every
+// view but the chosen one is compiled out
+layout(constant_id = 0) const uint SHADING_VIEW = 0;
+
+const uint VIEW_LIT     = 0;
+const uint VIEW_ALBEDO  = 1;
+const uint VIEW_NORMALS = 2;
+const uint VIEW_UVS     = 3;
+const uint VIEW_LIGHTS  = 4;
+const uint VIEW_CASCADES = 5;
+
+#ifdef BINDLESS
+// Meshlet pipelines keep their geometry in set 0 and move the table to set 1
+#ifndef MATERIAL_SET
+#define MATERIAL_SET 0
+#endif
+
+// Matches Material in src/Bindless.hpp
+struct Material {
+    vec4 baseColor;
+    uint albedoTexture;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, set = MATERIAL_SET, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+layout(set = MATERIAL_SET, binding = 1) uniform sampler2D textures[];
+#endif
+
+#ifdef CLUSTERED_LIGHTING
+// LIGHT_SET comes with the define, after the other sets
+#include "lighting_common.glsl"
+#endif
+
+#ifdef SHADOWS
+// SHADOW_SET comes with the define, after the lights
+#include "shadow_common.glsl"
+#endif
+
+// Blue through green to red as `t` goes from 0 to 1
+vec3 heat(float t){
+    return clamp(vec3(t * 2.0 - 1.0, 1.0 - abs(t * 2.0 - 1.0), 1.0 - t * 2.0), 0.0, 1.0);
+}
+
+void main() {
+    vec3 normal = normalize(fragNormal);
+
+    // Sky above, ground below, ambient under the clustered lights
+    float ambient = 0.35 + 0.65 * (0.5 + 0.5 * normal.y);
+
+    vec4 albedo = vec4(1.0);
+#ifdef BINDLESS
+    Material material = materials[fragMaterial];
+    albedo = texture(textures[nonuniformEXT(material.albedoTexture)], fragUV) * material.baseColor;
+#endif
+
+    if(SHADING_VIEW == VIEW_ALBEDO){
+        outColor = albedo;
+    } else if(SHADING_VIEW == VIEW_NORMALS){
+        outColor = vec4(0.5 + 0.5 * normal, 1.0);
+    } else if(SHADING_VIEW == VIEW_UVS){
+        outColor = vec4(fract(fragUV), 0.0, 1.0);
+    } else if(SHADING_VIEW == VIEW_LIGHTS){
+        // Lights of the fragment's cluster, red at 32 and up
+#ifdef CLUSTERED_LIGHTING
+        uint count = clusterCounts[fragmentCluster(fragPosition, gl_FragCoord.xy)];
+        outColor = vec4(count == 0 ? vec3(0.0) : heat(float(count) / 32.0), 1.0);
+#else
+        outColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+    } else if(SHADING_VIEW == VIEW_CASCADES){
+        // Red, green, blue and yellow from the nearest cascade out, darkened in shadow
+#ifdef SHADOWS
+        const vec3 tints[4] = vec3[](vec3(1.0, 0.3, 0.3), vec3(0.3, 1.0, 0.3), vec3(0.3, 0.3, 1.0), vec3(1.0, 1.0, 0.3));
+        vec3 coord;
+        uint cascade = shadowCascade(fragPosition, normal, coord);
+        vec3 tint = cascade < MAX_CASCADES ? tints[cascade] : vec3(1.0);
+        outColor = vec4(tint * (0.25 + 0.75 * sunShadow(fragPosition, normal)), 1.0);
+#else
+        outColor = vec4(1.0);
+#endif
+    } else {
+#ifdef CLUSTERED_LIGHTING
+        vec3 lit = albedo.rgb * ambient * 0.1 +
+                   clusteredLighting(fragmentCluster(fragPosition, gl_FragCoord.xy), fragPosition, normal, albedo.rgb);
+#else
+        vec3 lit = albedo.rgb * ambient;
+#endif
+#ifdef SHADOWS
+        lit += sunLighting(fragPosition, normal, albedo.rgb);
+#endif
+        outColor = vec4(lit, albedo.a);
+    }
+}
\ No newline at end of file
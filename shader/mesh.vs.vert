@@ -0,0 +1,57 @@
+#version 450
+
+#ifdef PACKED_VERTICES
+// Half floats and snorm are widened to float by the vertex fetch
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;     // octahedral
+layout(location = 2) in vec2 inUV;
+#else
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+#endif
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragMaterial;
+layout(location = 3) out vec3 fragPosition;
+
+// Drawn again by the depth pre-pass pipeline, whose depth the color pass
+// tests for EQUAL
+invariant gl_Position;
+
+// Matches MeshPushConstants in src/MeshManager.hpp
+layout(push_constant) uniform MeshConstants {
+    mat4 transform;
+    vec4 world[3];
+    uint materialIndex;
+    uint instanceIndex;
+} draw;
+
+#ifdef PACKED_VERTICES
+// Inverse of packVertex() in src/Mesh.cpp
+vec3 octahedralDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#endif
+
+void main(){
+#ifdef PACKED_VERTICES
+    vec4 position = vec4(inPosition.xyz, 1.0);
+    vec3 normal = octahedralDecode(inNormal);
+#else
+    vec4 position = vec4(inPosition, 1.0);
+    vec3 normal = inNormal;
+#endif
+
+    // World space for lighting, scale taken as uniform
+    gl_Position = draw.transform * position;
+    fragPosition = vec3(dot(draw.world[0], position), dot(draw.world[1], position), dot(draw.world[2], position));
+    fragNormal = normalize(vec3(dot(draw.world[0].xyz, normal), dot(draw.world[1].xyz, normal), dot(draw.world[2].xyz, normal)));
+    fragUV = inUV;
+    fragMaterial = draw.materialIndex;
+}
\ No newline at end of file
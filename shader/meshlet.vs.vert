@@ -0,0 +1,34 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet_common.glsl"
+
+// Written by shader/meshlet_cull.comp
+layout(std430, set = 0, binding = 5) readonly buffer Survivors {
+    uvec2 survivors[];
+};
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragMaterial;
+layout(location = 3) out vec3 fragPosition;
+
+// Drawn again by the depth pre-pass pipeline, whose depth the color pass
+// tests for EQUAL
+invariant gl_Position;
+
+// No vertex input: the compacted index names a survivor slot and a vertex of
+// its meshlet, everything else is pulled from storage buffers
+void main(){
+    uvec2 survivor = survivors[gl_VertexIndex >> 6];
+    Meshlet meshlet = meshlets[survivor.x];
+    Instance instance = instances[survivor.y];
+
+    MeshVertex vertex = fetchVertex(meshletVertices[meshlet.vertexOffset + (gl_VertexIndex & 63)]);
+
+    gl_Position = instance.clipFromObject * vec4(vertex.position, 1.0);
+    fragPosition = (instance.world * vec4(vertex.position, 1.0)).xyz;
+    fragNormal = normalize(mat3(instance.world) * vertex.normal);
+    fragUV = vertex.uv;
+    fragMaterial = instance.materialIndex;
+}
\ No newline at end of file
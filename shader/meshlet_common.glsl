@@ -0,0 +1,118 @@
+// Shared by the meshlet culling compute shader and the meshlet draw shaders
+
+// Matches Meshlet in src/Mesh.hpp
+struct Meshlet {
+    vec4 bounds;        // object space sphere
+    vec4 cone;          // axis, sine of the spread (1 = no cone)
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+};
+
+// Matches MeshletInstance in src/Meshlets.hpp
+struct Instance {
+    mat4 world;
+    mat4 clipFromObject;
+    uint meshletOffset;
+    uint meshletCount;
+    uint materialIndex;
+    float scale;
+    uint visibilityOffset;
+    uint _pad[3];
+};
+
+// Raw vertex words, decoded by fetchVertex()
+layout(std430, set = 0, binding = 0) readonly buffer Vertices {
+    uint vertexData[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer MeshletVertices {
+    uint meshletVertices[];
+};
+
+// Three bytes per triangle, four packed in a uint
+layout(std430, set = 0, binding = 3) readonly buffer MeshletTriangles {
+    uint meshletTriangles[];
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Matches MeshletPushConstants in src/Meshlets.hpp
+layout(push_constant) uniform MeshletConstants {
+    vec4 frustum[6];
+    vec4 cameraPosition;
+    uint instanceBase;
+    uint instanceCount;
+    uint survivorCapacity;
+    uint indexCapacity;
+} cull;
+
+uint meshletTriangleVertex(uint byteOffset){
+    return (meshletTriangles[byteOffset >> 2] >> ((byteOffset & 3) * 8)) & 0xff;
+}
+
+// Frustum and backface cone test in world space
+bool meshletVisible(Meshlet meshlet, Instance instance){
+    vec3 center = (instance.world * vec4(meshlet.bounds.xyz, 1.0)).xyz;
+    float radius = meshlet.bounds.w * instance.scale;
+
+    for(int i = 0; i < 6; i++){
+        if(dot(cull.frustum[i].xyz, center) + cull.frustum[i].w < -radius){
+            return false;
+        }
+    }
+
+    vec3 axis = normalize(mat3(instance.world) * meshlet.cone.xyz);
+    vec3 view = center - cull.cameraPosition.xyz;
+    return dot(view, axis) < meshlet.cone.w * length(view) + radius;
+}
+
+struct MeshVertex {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+};
+
+#ifdef PACKED_VERTICES
+// Inverse of packVertex() in src/Mesh.cpp
+vec3 octahedralDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// PackedVertex, 4 words
+MeshVertex fetchVertex(uint index){
+    uint base = index * 4;
+    MeshVertex vertex;
+    vertex.position = vec3(unpackHalf2x16(vertexData[base]), unpackHalf2x16(vertexData[base + 1]).x);
+    vertex.normal   = octahedralDecode(unpackSnorm2x16(vertexData[base + 2]));
+    vertex.uv       = unpackHalf2x16(vertexData[base + 3]);
+    return vertex;
+}
+#else
+// Vertex, 8 words
+MeshVertex fetchVertex(uint index){
+    uint base = index * 8;
+    MeshVertex vertex;
+    vertex.position = uintBitsToFloat(uvec3(vertexData[base], vertexData[base + 1], vertexData[base + 2]));
+    vertex.normal   = uintBitsToFloat(uvec3(vertexData[base + 3], vertexData[base + 4], vertexData[base + 5]));
+    vertex.uv       = uintBitsToFloat(uvec2(vertexData[base + 6], vertexData[base + 7]));
+    return vertex;
+}
+#endif
+
+// Task to mesh shader hand off, one task workgroup covers 32 meshlets
+struct TaskPayload {
+    uint instanceIndex;
+    uint meshlets[32];
+};
\ No newline at end of file
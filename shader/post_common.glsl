@@ -0,0 +1,32 @@
+// Shared by the post processing compute shaders, see src/PostProcess.hpp
+
+// Matches the POST_ flags in src/PostProcess.cpp
+const uint POST_PREFILTER   = 1;
+const uint POST_ENCODE      = 2;
+const uint POST_DECODE      = 4;
+
+// Matches PostPushConstants in src/PostProcess.cpp, params differ per kernel
+layout(push_constant) uniform PostConstants {
+    vec4 params;
+    uint flags;
+} post;
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(set = 0, binding = 1) uniform sampler2D second;
+
+// Of linear or encoded color alike, FXAA only compares them
+float luma(vec3 color){
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 encodeSrgb(vec3 color){
+    vec3 low  = color * 12.92;
+    vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    return mix(high, low, lessThanEqual(color, vec3(0.0031308)));
+}
+
+vec3 decodeSrgb(vec3 color){
+    vec3 low  = color / 12.92;
+    vec3 high = pow((color + 0.055) / 1.055, vec3(2.4));
+    return mix(high, low, lessThanEqual(color, vec3(0.04045)));
+}
\ No newline at end of file
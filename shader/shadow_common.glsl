@@ -0,0 +1,68 @@
+// Sampling the cascaded shadow maps in scene fragment shaders, see
+// src/Shadows.hpp
+
+// CascadedShadows::MAX_CASCADES in src/Shadows.hpp
+const uint MAX_CASCADES = 4;
+
+// Scene pipelines put the set after their own
+#ifndef SHADOW_SET
+#define SHADOW_SET 0
+#endif
+
+// Compares in the sampler, 1 where the reference depth is in front
+layout(set = SHADOW_SET, binding = 0) uniform sampler2DShadow shadowMap;
+
+// Matches ShadowParams in src/Shadows.hpp
+layout(std430, set = SHADOW_SET, binding = 1) readonly buffer ShadowParams {
+    mat4  cascades[MAX_CASCADES];
+    vec4  normalOffsets;
+    vec3  direction;
+    uint  cascadeCount;
+    vec3  color;
+    float atlasTexel;
+} shadows;
+
+// First cascade that covers a world space position with room for the
+// filter, its square's coordinates and depth in `coord`; cascadeCount if none
+uint shadowCascade(vec3 position, vec3 normal, out vec3 coord){
+    // Two texels of the cascade, half the atlas wide
+    float border = shadows.atlasTexel * 4.0;
+
+    for(uint i = 0; i < shadows.cascadeCount; i++){
+        coord = (shadows.cascades[i] * vec4(position + normal * shadows.normalOffsets[i], 1.0)).xyz;
+        if(all(greaterThan(coord.xy, vec2(border))) && all(lessThan(coord.xy, vec2(1.0 - border))) && coord.z <= 1.0){
+            return i;
+        }
+    }
+    return shadows.cascadeCount;
+}
+
+// How much of the light reaches a world space position, 3x3 filtered taps
+// that each compare 2x2 texels
+float sunShadow(vec3 position, vec3 normal){
+    vec3 coord;
+    uint cascade = shadowCascade(position, normal, coord);
+    if(cascade == shadows.cascadeCount){
+        return 1.0;
+    }
+
+    // Cascade i sits at (i % 2, i / 2) in the atlas
+    vec2 uv = (coord.xy + vec2(cascade & 1u, cascade >> 1u)) * 0.5;
+
+    float lit = 0.0;
+    for(int y = -1; y <= 1; y++){
+        for(int x = -1; x <= 1; x++){
+            lit += texture(shadowMap, vec3(uv + vec2(x, y) * shadows.atlasTexel, coord.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+// Lambert from the directional light, shadowed
+vec3 sunLighting(vec3 position, vec3 normal, vec3 albedo){
+    float diffuse = max(dot(normal, -shadows.direction), 0.0);
+    if(diffuse == 0.0){
+        return vec3(0.0);
+    }
+    return shadows.color * albedo * (diffuse * sunShadow(position, normal));
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "Allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> gAllocations{0};
+
+uint64_t heapAllocations(){
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms all end up here
+void* operator new(size_t size){
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* pointer = std::malloc(size == 0 ? 1 : size)){
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept{
+    std::free(pointer);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Heap allocations made through operator new by every thread since the
+ * process started. Allocations.cpp replaces the global operator new to
+ * count them. Only the application links it; the bench keeps its own.
+**/
+
+uint64_t heapAllocations();
@@ -3,11 +3,13 @@
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
 #include <X11/Xlib.h>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_structs.hpp>
@@ -16,6 +18,7 @@
 
 #include <set>
 
+#include "Allocations.hpp"
 #include "vkutil.hpp"
 
 const std::vector<const char*> _validationLayers = {
@@ -28,13 +31,18 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
     void* pUserData ) 
 {   
-    std::cout << "Validation layer: " << pCallbackData->pMessage << std::endl;
+    std::cerr << "Validation layer: " << pCallbackData->pMessage << std::endl;
 
     return VK_FALSE;
 }
 
 App::App(int width, int height, const char* title){
     this->window = initWindow(width, height, title);
+
+    mInputQueue.attach(window.handle);
+    mInput.width    = width;
+    mInput.height   = height;
+
     // Try creating a vulkan instance
     if(! mVkCreateInstance()){
         // Probs no vulkan support
@@ -51,30 +59,358 @@ App::App(int width, int height, const char* title){
 
     mPickPhysicalDevice();
     mCreateLogicalDevice();
+
+    mGpuProfiler.init(mInstance.device, mInstance.physicalDevice, mQueue.graphicsFamilyIndex, MAX_FRAMES_IN_FLIGHT);
+
+    mTextures.init(mInstance.device,
+                   mInstance.physicalDevice,
+                   mQueue.graphicsQueue,
+                   mQueue.graphicsFamilyIndex,
+                   mFeatures.samplerAnisotropy ? mFeatures.maxSamplerAnisotropy : 1.0f);
+
+    // 2M vertices, 8M indices
+    mMeshes.init(mInstance.device,
+                 mInstance.physicalDevice,
+                 mQueue.graphicsQueue,
+                 mQueue.graphicsFamilyIndex,
+                 mPackedVertices ? VertexFormat::Packed : VertexFormat::Float,
+                 1u << 21,
+                 1u << 23);
+
+    if(useBindless()){
+        mCreateBindlessResources();
+    }
+
+    // Up to 16K lights a frame
+    if(useClusteredLighting()){
+        mLighting.init(mInstance.device, mInstance.physicalDevice, MAX_FRAMES_IN_FLIGHT, 1u << 14);
+        mGpuProfiler.setBudget("light cull", 0.2);
+    }
+
+    // Four 2048x2048 cascades; the cache only redraws when the scene settles
+    if(useShadows()){
+        mShadows.init(mInstance.device, mInstance.physicalDevice, mMeshes, MAX_FRAMES_IN_FLIGHT, 2048);
+        mGpuProfiler.setBudget("shadow copy", 0.1);
+        mGpuProfiler.setBudget("shadows", 0.3);
+    }
+
+    // 4096 instances a frame, 64K surviving meshlets and 4M compacted indices
+    if(mUseMeshlets){
+        mMeshlets.init(mInstance.device,
+                       mInstance.physicalDevice,
+                       mMeshes,
+                       useBindless() ? mBindless.layout() : VK_NULL_HANDLE,
+                       useClusteredLighting() ? mLighting.layout() : VK_NULL_HANDLE,
+                       useShadows() ? mShadows.layout() : VK_NULL_HANDLE,
+                       useMeshShaders(),
+                       useOcclusionCulling(),
+                       MAX_FRAMES_IN_FLIGHT,
+                       4096,
+                       1u << 16,
+                       1u << 22);
+    }
+
     mCreateSwapChain();
     mCreateImageViews();
-    mCreateRenderPass();
+    mRenderExtent = mSwapChain.swapChainExtent;
+
+    mGraph.init(mInstance.device, mInstance.physicalDevice);
+    mGraph.setProfiler(&mGpuProfiler);
+
+    // Built from the scene's depth between the two meshlet culling phases
+    if(useOcclusionCulling()){
+        mDepthPyramid.init(mInstance.device, mInstance.physicalDevice, mSwapChain.swapChainExtent, MAX_FRAMES_IN_FLIGHT);
+        mMeshlets.setDepthPyramid(mDepthPyramid.view(), mDepthPyramid.sampler());
+        mGpuProfiler.setBudget("depth pyramid", 0.1);
+    }
+
+    // A frame slot more than in flight, so a consumer keeping up never drops one
+    if(useReadback()){
+        mReadback.init(mInstance.device, mInstance.physicalDevice,
+                       mSwapChain.swapChainExtent, mSwapChain.swapChainImageFormat, MAX_FRAMES_IN_FLIGHT + 1);
+        mGpuProfiler.setBudget("readback", 0.1);
+    }
+
+    if(useStreaming()){
+        mEncoder.init(mSwapChain.swapChainExtent, mSwapChain.swapChainImageFormat);
+    }
+
+    if(usePostProcessing()){
+        mPost.settings.upscale = useDynamicResolution();
+        mPost.init(mInstance.device, mSwapChain.swapChainImageFormat, MAX_FRAMES_IN_FLIGHT);
+
+        // About a millisecond for the whole chain at 1080p on a mid range GPU
+        mGpuProfiler.setBudget("upscale", 0.2);
+        mGpuProfiler.setBudget("bloom down", 0.3);
+        mGpuProfiler.setBudget("bloom up", 0.25);
+        mGpuProfiler.setBudget("tonemap", 0.15);
+        mGpuProfiler.setBudget("fxaa", 0.2);
+        mGpuProfiler.setBudget("post copy", 0.1);
+    }
+
+    mCreateColorResources();
+    mCreateDepthResources();
+
+    // Dynamic rendering needs neither a render pass nor framebuffers
+    if(!useDynamicRendering()){
+        mCreateRenderPass();
+    }
+
+    // Everything but the fallbacks compiles in the background from here on
+    mPipelines.init(mInstance.device,
+                    mInstance.physicalDevice,
+                    useDynamicRendering() ? VK_NULL_HANDLE : mRenderPass.renderPass,
+                    "/cache/pipelines.bin",
+                    "/cache/pipelines.manifest");
+
     mCreateGraphicsPipeline();
-    mCreateFrameBuffers();
+    mCreateMeshPipeline();
+
+    if(mUseMeshlets){
+        mCreateMeshletPipeline();
+    }
+
+    // Everything earlier runs used, before the first frame instead of during
+    mPipelines.warmUp(mJobs);
+
+    if(!useDynamicRendering()){
+        mCreateFrameBuffers();
+    }
+
     mCreateCommandpool();
     mCreateCommandBuffers();
     mCreateSyncObjects();
 }
 
-void App::loop(){    
-    while(!glfwWindowShouldClose(this->window.handle)){
-        glfwPollEvents();
-        this->draw();
-        glfwSwapBuffers(App::window.handle);
-        calculateDeltaTime();
+/**
+ * Runs on its own thread and owns every Vulkan call from here to shutdown.
+ * Each frame first waits for its frame slot, then samples input, so the
+ * camera and everything culled from it see the freshest input the CPU can
+ * give it. The CPU side is a task graph on the job system: transforms, then
+ * culling, then LOD selection, each spreading its own work over the threads.
+**/
+
+void App::renderLoop(){
+    try{
+        TaskGraph frame;
+        TaskGraph::TaskId update   = frame.add("scene update", [this](){ mScene.updateTransforms(); });
+        TaskGraph::TaskId cull     = frame.add("cull", [this](){ mCullScene(); });
+        TaskGraph::TaskId lods     = frame.add("select lods", [this](){ mSelectLods(); });
+        frame.depend(cull, update);
+        frame.depend(lods, cull);
+
+        double lastProfilePrint = glfwGetTime();
+
+        // Heap allocations over a whole render thread frame, from any thread;
+        // the most of any frame since the last print
+        uint64_t frameAllocations = 0;
+
+        while(!mQuit){
+            uint64_t allocationsBefore = heapAllocations();
+            mProfiler.beginFrame();
+
+            {
+                ProfileScope scope(&mProfiler, "wait frame");
+                mWaitForFrame();
+            }
+
+            frameArena().reset();
+
+            mDrainReadback();
+
+            mSampleInput();
+
+            frame.run(mJobs);
+
+            {
+                ProfileScope scope(&mProfiler, "draw");
+                this->draw();
+            }
+
+            // How old the oldest input this frame acted on was by the time it was submitted
+            if(mInput.eventCount > 0){
+                mProfiler.record("input to submit", JobSystem::threadIndex(), mInput.oldestEvent, ProfileClock::now());
+            }
+
+            calculateDeltaTime();
+
+            frameAllocations = std::max(frameAllocations, heapAllocations() - allocationsBefore);
+
+            if(mPrintProfile && currentFrame - lastProfilePrint >= 1.0){
+                mProfiler.print(stdout);
+                mGpuProfiler.print(stdout);
+
+                printf("heap: at most %llu allocations a frame\n", static_cast<unsigned long long>(frameAllocations));
+                frameAllocations = 0;
+
+                if(useDynamicRendering()){
+                    const RenderGraph::Stats& graph = mGraph.stats();
+                    printf("graph: %u passes, %u culled, %u barriers, %u transient images in %.1f MB (%.1f MB unaliased)\n",
+                           graph.passes, graph.culledPasses, graph.barriers, graph.transientImages,
+                           graph.transientBytes / 1048576.0, graph.unaliasedBytes / 1048576.0);
+                }
+
+                if(useClusteredLighting()){
+                    printf("lights: %u of %zu binned\n", mLighting.lightCount(), mLights.size());
+                }
+
+                if(useShadows()){
+                    const CascadedShadows::Stats& shadows = mShadows.stats();
+                    printf("shadows: %u cascades cached, %u copied, %u static and %u moving casters drawn\n",
+                           shadows.cachedCascades, shadows.copiedCascades, shadows.staticCasters, shadows.dynamicCasters);
+                }
+
+                if(useReadback()){
+                    const FrameReadback::Stats& readback = mReadback.stats();
+                    printf("readback: %llu frames captured, %llu dropped\n",
+                           static_cast<unsigned long long>(readback.captured),
+                           static_cast<unsigned long long>(readback.dropped));
+                }
+
+                if(useStreaming()){
+                    FrameEncoder::Stats encoder = mEncoder.stats();
+                    printf("encoder: %llu frames written, %llu queued, %llu stalls\n",
+                           static_cast<unsigned long long>(encoder.written),
+                           static_cast<unsigned long long>(encoder.pushed - encoder.written),
+                           static_cast<unsigned long long>(encoder.stalls));
+                }
+
+                if(useDynamicResolution()){
+                    printf("render scale %.2f, %ux%u\n", mResolution.scale(), mRenderExtent.width, mRenderExtent.height);
+                }
+                lastProfilePrint = currentFrame;
+            }
+        }
+
+        // What the last frames in flight captured gets out too
+        if(useReadback()){
+            vkDeviceWaitIdle(mInstance.device);
+            mDrainReadback(true);
+        }
+    } catch(...){
+        // Rethrown on the main thread once the device is idle and cleaned up
+        mRenderError = std::current_exception();
     }
+
     vkDeviceWaitIdle(mInstance.device);
-    this->cleanup();
+
+    mRenderDone.store(true, std::memory_order_release);
+    glfwPostEmptyEvent();
+}
+
+void App::mWaitForFrame(){
+    // Frame slot is free once the submission that last used it has completed
+    if(useTimeline()){
+        waitTimeline(mTimeline.frameValues[mRenderPass.currentFrame]);
+    }else{
+        vkWaitForFences(mInstance.device, 1, &mRenderPass.inFlightFences[mRenderPass.currentFrame], VK_TRUE, UINT64_MAX);
+    }
+}
+
+void App::mDrainReadback(bool idle){
+    if(!useReadback()){
+        return;
+    }
+
+    ProfileScope scope(&mProfiler, "readback");
+
+    // What this slot's last submission copied has landed, or every slot's
+    // once the device is idle
+    if(idle){
+        for(uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++){
+            mReadback.beginFrame(frame);
+        }
+    } else {
+        mReadback.beginFrame(static_cast<uint32_t>(mRenderPass.currentFrame));
+    }
+
+    ReadbackFrame frame;
+    while(mReadback.acquire(frame)){
+        onFrameReadback(frame);
+
+        // Waits here while the I/O thread is a full queue behind
+        if(useStreaming() && !mEncoder.done()){
+            mEncoder.push(frame);
+        }
+        mReadback.release();
+    }
+
+    if(useStreaming() && mEncoder.done()){
+        terminate();
+    }
+}
+
+void App::mSampleInput(){
+    ProfileScope scope(&mProfiler, "sample input");
+
+    mInput.beginSample();
+
+    InputEvent event;
+    while(mInputQueue.pop(event)){
+        mInput.apply(event);
+    }
+
+    // Not queued, a full queue can't lose it
+    mInput.closeRequested = mInputQueue.closeRequested();
+    if(mInput.closeRequested){
+        terminate();
+    }
+
+    processInput(mInput);
+}
+
+void App::mCullScene(){
+    cullScene(mScene, extractFrustum(mCamera.projection * mCamera.view), mVisible, &mJobs, &frameArena());
+}
+
+void App::mSelectLods(){
+    glm::vec3 eye = glm::vec3(glm::inverse(mCamera.view)[3]);
+
+    // Pixels covered by one unit at distance 1, sign dropped for Y flipped projections
+    float projectionScale = std::abs(mCamera.projection[1][1]) * 0.5f * mRenderExtent.height;
+
+    // Every node is written by exactly one chunk
+    mJobs.parallelFor("select lods chunk", mVisible.size(), 4096, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            uint32_t node = mVisible[i];
+
+            const RenderHandle& handle = mScene.renderHandles[node];
+            if(handle.mesh == UINT32_MAX) continue;
+
+            glm::vec3 center(mScene.boundsX[node], mScene.boundsY[node], mScene.boundsZ[node]);
+            float radius = mScene.boundsRadius[node];
+
+            // Distance to the nearest point of the bounds, LOD errors are in object
+            // units so they scale with the node like its bounds do
+            float distance  = glm::length(center - eye) - radius;
+            float scale     = mScene.localBounds[node].w > 0.0f ? radius / mScene.localBounds[node].w : 1.0f;
+
+            mScene.lodLevels[node] = static_cast<uint8_t>(selectLod(mMeshes.get(handle.mesh).lods,
+                                                                    distance,
+                                                                    projectionScale * scale,
+                                                                    mScene.lodLevels[node],
+                                                                    mLodPixelError));
+        }
+    });
 }
 
 void App::start(){	
     this->initDraw();
-    this->loop();
+
+    std::thread render(&App::renderLoop, this);
+
+    // The main thread only pumps window events into the input queue from
+    // here on, a slow frame can't hold up the event loop
+    while(!mRenderDone.load(std::memory_order_acquire)){
+        glfwWaitEvents();
+    }
+
+    render.join();
+    this->cleanup();
+
+    if(mRenderError){
+        std::rethrow_exception(mRenderError);
+    }
 }
 
 /**
@@ -90,11 +426,19 @@ void App::calculateDeltaTime(){
     }
 
 bool App::keyPressed(int keyCode) const{
-    return glfwGetKey(this->window.handle, keyCode) == GLFW_PRESS;
+    return mInput.keyDown(keyCode);
+}
+
+const InputState& App::input() const{
+    return mInput;
 }
 
-void App::terminate() const{
-    glfwSetWindowShouldClose(window.handle, true);
+LinearArena& App::frameArena(){
+    return mFrameArenas[mRenderPass.currentFrame];
+}
+
+void App::terminate(){
+    mQuit = true;
 }
 
 static WindowInfo initWindow(int width, int height, const char* title){    
@@ -115,22 +459,16 @@ static WindowInfo initWindow(int width, int height, const char* title){
     };
 
     if(window == NULL){
-        std::cout << "Failed to create window" << std::endl;
+        std::cerr << "Failed to create window" << std::endl;
     }
 
     glfwMakeContextCurrent(window);
 
     windowStrct.handle = window;
-
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     
     return windowStrct;
 }
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height){
-    
-}
-
 double App::getDeltaTime(){
     return this->deltaTime;
 }
@@ -152,13 +490,21 @@ bool App::mVkCreateInstance(){
     std::vector<const char*> extensions = 
     getRequiredVkExtensions(mEnableValidationLayers);
     
+    // Vulkan 1.3 for timeline semaphores, dynamic rendering and synchronization2.
+    // A 1.0 loader (no vkEnumerateInstanceVersion) refuses any apiVersion above 1.0,
+    // so stay on 1.0 there
+    auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)
+        vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+
+    mInstance.apiVersion = enumerateInstanceVersion != nullptr ? VK_API_VERSION_1_3 : VK_API_VERSION_1_0;
+
     VkApplicationInfo appInfo{
         .sType              = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pApplicationName   = "Hello, tidy render",
         .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
         .pEngineName        = "No engine yet",
         .engineVersion      = VK_MAKE_VERSION(1, 0, 0),
-        .apiVersion         = VK_API_VERSION_1_0
+        .apiVersion         = mInstance.apiVersion
     };
 
     VkDebugUtilsMessengerCreateInfoEXT debugMessengerInfo{};    
@@ -174,7 +520,7 @@ bool App::mVkCreateInstance(){
     };
 
     if(mEnableValidationLayers){
-        std::cout << "Setting up debug " << std::endl;
+        std::cerr << "Setting up debug " << std::endl;
 
         populateDebugMessengerCreateInfo(debugMessengerInfo, debugCallback);
 
@@ -274,9 +620,119 @@ bool App::mPickPhysicalDevice(){
         return false;
     }
 
+    mQueryDeviceFeatures();
+
     return true;
 }
 
+void App::mQueryDeviceFeatures(){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mInstance.physicalDevice, &properties);
+
+    // Usable version is the lower of what the instance asked for and what the device reports
+    mFeatures.apiVersion = std::min(mInstance.apiVersion, properties.apiVersion);
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(mInstance.physicalDevice, &features);
+
+    mFeatures.samplerAnisotropy         = features.samplerAnisotropy == VK_TRUE;
+    mFeatures.maxSamplerAnisotropy      = properties.limits.maxSamplerAnisotropy;
+    mFeatures.textureCompressionBC      = features.textureCompressionBC == VK_TRUE;
+    mFeatures.textureCompressionETC2    = features.textureCompressionETC2 == VK_TRUE;
+    mFeatures.textureCompressionASTC    = features.textureCompressionASTC_LDR == VK_TRUE;
+
+    if(mFeatures.apiVersion < VK_API_VERSION_1_2){
+        return;
+    }
+
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    // The 1.3 struct may only be chained when the device actually is 1.3
+    if(mFeatures.apiVersion >= VK_API_VERSION_1_3){
+        features12.pNext = &features13;
+    }
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features12;
+
+    vkGetPhysicalDeviceFeatures2(mInstance.physicalDevice, &features2);
+
+    mFeatures.timelineSemaphore = features12.timelineSemaphore == VK_TRUE;
+    mFeatures.descriptorIndexing =
+        features12.runtimeDescriptorArray &&
+        features12.shaderSampledImageArrayNonUniformIndexing &&
+        features12.descriptorBindingPartiallyBound &&
+        features12.descriptorBindingVariableDescriptorCount &&
+        features12.descriptorBindingSampledImageUpdateAfterBind;
+    mFeatures.dynamicRendering  = features13.dynamicRendering == VK_TRUE;
+    mFeatures.synchronization2  = features13.synchronization2 == VK_TRUE;
+
+    // Mesh shaders are an extension, only ask for the features when it's there
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(mInstance.physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(mInstance.physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    bool meshShaderExtension = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension){
+        return strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+
+    if(meshShaderExtension){
+        VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+        meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+        features2.pNext = &meshShaderFeatures;
+        vkGetPhysicalDeviceFeatures2(mInstance.physicalDevice, &features2);
+
+        mFeatures.meshShader = meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+    }
+}
+
+bool App::useDynamicRendering() const{
+    return mUseDynamicRendering && mFeatures.dynamicRendering && mFeatures.synchronization2;
+}
+
+bool App::useBindless() const{
+    return mUseBindless && mFeatures.descriptorIndexing;
+}
+
+bool App::useMeshShaders() const{
+    return mUseMeshlets && mUseMeshShaders && mFeatures.meshShader;
+}
+
+bool App::usePostProcessing() const{
+    return mPostProcessing && useDynamicRendering();
+}
+
+bool App::useDynamicResolution() const{
+    return mDynamicResolution && usePostProcessing() && mGpuProfiler.supported();
+}
+
+bool App::useClusteredLighting() const{
+    return mClusteredLighting;
+}
+
+bool App::useShadows() const{
+    return mCascadedShadows && useDynamicRendering();
+}
+
+bool App::useOcclusionCulling() const{
+    return mOcclusionCulling && mUseMeshlets && !useMeshShaders() && useDynamicRendering();
+}
+
+bool App::useReadback() const{
+    return (mFrameReadback || mStreamFrames) && useDynamicRendering();
+}
+
+bool App::useStreaming() const{
+    return mStreamFrames && useReadback();
+}
+
 bool App::mCreateLogicalDevice(){
 
     QueueFamilyIndices indices = findQueueFamilies( mInstance.physicalDevice, 
@@ -307,6 +763,10 @@ bool App::mCreateLogicalDevice(){
     // Separate update
         
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.samplerAnisotropy            = mFeatures.samplerAnisotropy;
+    deviceFeatures.textureCompressionBC         = mFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2       = mFeatures.textureCompressionETC2;
+    deviceFeatures.textureCompressionASTC_LDR   = mFeatures.textureCompressionASTC;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -316,8 +776,46 @@ bool App::mCreateLogicalDevice(){
 
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    if(mFeatures.apiVersion >= VK_API_VERSION_1_2){
+        features12.timelineSemaphore = mUseTimelineSemaphores && mFeatures.timelineSemaphore;
+        createInfo.pNext = &features12;
+    }
+
+    if(useBindless()){
+        features12.runtimeDescriptorArray                       = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing    = VK_TRUE;
+        features12.descriptorBindingPartiallyBound              = VK_TRUE;
+        features12.descriptorBindingVariableDescriptorCount     = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
+
+    if(useDynamicRendering()){
+        features13.dynamicRendering = VK_TRUE;
+        features13.synchronization2 = VK_TRUE;
+        features12.pNext = &features13;
+    }
+
+    std::vector<const char*> extensions = deviceExtensions;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+    if(useMeshShaders()){
+        extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        meshShaderFeatures.taskShader   = VK_TRUE;
+        meshShaderFeatures.meshShader   = VK_TRUE;
+        meshShaderFeatures.pNext        = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext                = &meshShaderFeatures;
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (mEnableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(_validationLayers.size());
@@ -370,6 +868,27 @@ bool App::mCreateSwapChain(){
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    // The post chain ends in a blit into the swapchain image
+    if(usePostProcessing()){
+        mPostProcessing = (swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) &&
+                          PostProcess::supported(mInstance.physicalDevice, surfaceFormat.format);
+        if(mPostProcessing){
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
+    }
+
+    // Readback copies out of the swapchain image once it's final
+    if(useReadback()){
+        bool readable = (swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) &&
+                        FrameReadback::supported(surfaceFormat.format);
+        if(readable){
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        } else {
+            mFrameReadback  = false;
+            mStreamFrames   = false;
+        }
+    }
+
     QueueFamilyIndices indices = findQueueFamilies(mInstance.physicalDevice);
 
     uint32_t queueFamilyIndices[2] = {mQueue.graphicsFamilyIndex, mQueue.presentFamilyIndex };
@@ -436,7 +955,82 @@ bool App::mCreateImageViews(){
     return true;
 }
 
+bool App::mCreateDepthResources(){
+    mDepth.format = findDepthFormat(mInstance.physicalDevice, mRequestedDepthFormat);
+
+    // The render graph makes its own
+    if(useDynamicRendering()){
+        return true;
+    }
+
+    // Contents never leave the render pass, so the image can be transient
+    createImage(mInstance.device,
+                mInstance.physicalDevice,
+                mSwapChain.swapChainExtent.width,
+                mSwapChain.swapChainExtent.height,
+                1,
+                mMsaa.samples,
+                mDepth.format,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                mDepth.image,
+                mDepth.memory);
+
+    mDepth.view = createImageView(mInstance.device, mDepth.image, mDepth.format, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    return true;
+}
+
+bool App::mCreateColorResources(){
+    mMsaa.samples = getUsableSampleCount(mInstance.physicalDevice, mRequestedSamples);
+
+    if(mMsaa.samples == VK_SAMPLE_COUNT_1_BIT || useDynamicRendering()){
+        return true;
+    }
+
+    // Samples only live for the duration of the pass and are resolved on chip,
+    // so on tilers the multisampled image never needs real memory
+    createImage(mInstance.device,
+                mInstance.physicalDevice,
+                mSwapChain.swapChainExtent.width,
+                mSwapChain.swapChainExtent.height,
+                1,
+                mMsaa.samples,
+                mSwapChain.swapChainImageFormat,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                mMsaa.image,
+                mMsaa.memory);
+
+    mMsaa.view = createImageView(mInstance.device, mMsaa.image, mSwapChain.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    return true;
+}
+
+bool App::mCreateBindlessResources(){
+    mBindless.init(mInstance.device, mInstance.physicalDevice, 16384, 1024);
+
+    // Slot 0 is plain white so untextured materials can still sample
+    TextureData white;
+    white.format        = VK_FORMAT_R8G8B8A8_UNORM;
+    white.width         = 1;
+    white.height        = 1;
+    white.generateMips  = false;
+    white.levels.push_back({255, 255, 255, 255});
+
+    mBindless.registerTexture(mTextures.get(mTextures.createTexture(white)));
+    mBindless.addMaterial(Material{});
+
+    return true;
+}
+
 bool App::mCreateRenderPass(){
+    bool msaa = mMsaa.samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // Attachment 0 is always the swapchain image. With MSAA it becomes the
+    // resolve target and the multisampled color image is attachment 2.
     // Attachment description
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format          = mSwapChain.swapChainImageFormat;
@@ -447,30 +1041,72 @@ bool App::mCreateRenderPass(){
     colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
     colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    
+
+    if(msaa){
+        // Fully overwritten by the resolve
+        colorAttachment.loadOp      = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    }
+
+    VkAttachmentDescription msaaAttachment{};
+    msaaAttachment.format           = mSwapChain.swapChainImageFormat;
+    msaaAttachment.samples          = mMsaa.samples;
+    msaaAttachment.loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    msaaAttachment.storeOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.stencilLoadOp    = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    msaaAttachment.stencilStoreOp   = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    msaaAttachment.initialLayout    = VK_IMAGE_LAYOUT_UNDEFINED;
+    msaaAttachment.finalLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Clear on load and discard on store, depth never touches memory on tilers
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format          = mDepth.format;
+    depthAttachment.samples         = mMsaa.samples;
+    depthAttachment.loadOp          = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp         = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment   = 0;
+    colorAttachmentRef.attachment   = msaa ? 2 : 0;
     colorAttachmentRef.layout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference resolveAttachmentRef{};
+    resolveAttachmentRef.attachment = 0;
+    resolveAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment   = 1;
+    depthAttachmentRef.layout       = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount    = 1;
     subpass.pColorAttachments       = &colorAttachmentRef;    
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    subpass.pResolveAttachments     = msaa ? &resolveAttachmentRef : nullptr;
+
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment, msaaAttachment};
 
     VkPipelineLayout pipelineLayout;
 
     VkRenderPassCreateInfo renderPassCreateInfo{};
     renderPassCreateInfo.sType              = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount    = 1;
-    renderPassCreateInfo.pAttachments       = &colorAttachment;
+    renderPassCreateInfo.attachmentCount    = msaa ? 3 : 2;
+    renderPassCreateInfo.pAttachments       = attachments;
     renderPassCreateInfo.subpassCount       = 1;
     renderPassCreateInfo.pSubpasses         = &subpass;
 
     VkSubpassDependency dependency{};
     dependency.srcSubpass       = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass       = 0;
-    dependency.dstStageMask     = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // Depth and multisampled color images are shared by all frames in flight,
+    // so the clears have to wait for the previous frame's writes as well
+    dependency.srcStageMask     = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask     = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask    = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     renderPassCreateInfo.dependencyCount    = 1;
     renderPassCreateInfo.pDependencies      = &dependency;
@@ -484,132 +1120,283 @@ bool App::mCreateRenderPass(){
 }
 
 bool App::mCreateGraphicsPipeline(){
-    // Fixed function
-    auto vertShaderCode = readFile("/shader/spv/test.vert.spv");
-    auto fragShaderCode = readFile("/shader/spv/test.frag.spv");
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 0;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
 
-    VkShaderModule vertShaderModule = createShaderModule(mInstance.device, vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(mInstance.device, fragShaderCode);
+    VkDescriptorSetLayout bindlessLayout = VK_NULL_HANDLE;
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawPushConstants);
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
+    if (useBindless()) {
+        bindlessLayout = mBindless.layout();
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &bindlessLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    }
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    if (vkCreatePipelineLayout(mInstance.device, &pipelineLayoutInfo, nullptr, &mRenderPass.pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    std::vector<uint64_t> setSignatures;
+    std::vector<VkPushConstantRange> pushConstants;
+    if(useBindless()){
+        setSignatures.push_back(mBindless.layoutSignature());
+        pushConstants.push_back(pushConstantRange);
+    }
+    mPipelines.addLayout("triangle", mRenderPass.pipelineLayout, pipelineLayoutSignature(setSignatures, pushConstants));
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
+    GraphicsPipelineDesc desc;
+    desc.layout = "triangle";
+    desc.frontFace = VK_FRONT_FACE_CLOCKWISE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) mSwapChain.swapChainExtent.width;
-    viewport.height = (float) mSwapChain.swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    if(useBindless()){
+        // No prebuilt blobs for the bindless shaders, compiled from source
+        desc.shaders.push_back({VK_SHADER_STAGE_VERTEX_BIT, "/shader/bindless.vs.vert", {}});
+        desc.shaders.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, "/shader/bindless.fs.frag", {}});
+    } else {
+        desc.shaders.push_back({VK_SHADER_STAGE_VERTEX_BIT, "/shader/spv/test.vert.spv", {}});
+        desc.shaders.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, "/shader/spv/test.frag.spv", {}});
+    }
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = mSwapChain.swapChainExtent;
-
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
+    mBuildScenePipelines(desc, mRenderPass.trianglePipelines);
+
+    return true;
+}
+
+/**
+ * Pipelines for cooked meshes: the shared vertex buffer as input and the
+ * object to clip transform as a push constant. Everything else matches the
+ * triangle pipeline so both can be drawn in the same pass.
+**/
+
+bool App::mCreateMeshPipeline(){
+    bool packed = mMeshes.vertexFormat() == VertexFormat::Packed;
+
+    // Same sources either way, the variants differ in vertex decode and material reads
+    std::vector<std::string> vertexDefines;
+    std::vector<std::string> fragmentDefines;
+    if(packed){
+        vertexDefines.push_back("PACKED_VERTICES");
+    }
+    if(useBindless()){
+        fragmentDefines.push_back("BINDLESS");
+    }
+    if(useClusteredLighting()){
+        fragmentDefines.push_back("CLUSTERED_LIGHTING");
+        fragmentDefines.push_back(useBindless() ? "LIGHT_SET=1" : "LIGHT_SET=0");
+    }
+    if(useShadows()){
+        fragmentDefines.push_back("SHADOWS");
+        fragmentDefines.push_back("SHADOW_SET=" + std::to_string(useBindless() + useClusteredLighting()));
+    }
+
+    std::vector<ShaderConstant> fragmentConstants = {{0, static_cast<uint32_t>(mShadingView)}};
+
+    GraphicsPipelineDesc desc;
+    desc.layout = "mesh";
+    desc.shaders.push_back({VK_SHADER_STAGE_VERTEX_BIT, "/shader/mesh.vs.vert", vertexDefines});
+    desc.shaders.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, "/shader/mesh.fs.frag", fragmentDefines, fragmentConstants});
+
+    VkVertexInputBindingDescription binding{};
+    binding.binding = 0;
+    binding.stride = mMeshes.vertexStride();
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    desc.bindings.push_back(binding);
+
+    // All packed formats are mandatory for vertex buffers, the hardware
+    // converts them to float on fetch; only the normal needs decoding
+    if(packed){
+        desc.attributes.push_back({0, 0, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(PackedVertex, position)});
+        desc.attributes.push_back({1, 0, VK_FORMAT_R16G16_SNORM,        offsetof(PackedVertex, normal)});
+        desc.attributes.push_back({2, 0, VK_FORMAT_R16G16_SFLOAT,       offsetof(PackedVertex, uv)});
+    } else {
+        desc.attributes.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
+        desc.attributes.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
+        desc.attributes.push_back({2, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(Vertex, uv)});
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshPushConstants);
+
+    // The bindless table, then the lights, then the shadows
+    VkDescriptorSetLayout setLayouts[3];
+    uint32_t setLayoutCount = 0;
+    std::vector<uint64_t> setSignatures;
+    if(useBindless()){
+        setLayouts[setLayoutCount++] = mBindless.layout();
+        setSignatures.push_back(mBindless.layoutSignature());
+    }
+    if(useClusteredLighting()){
+        setLayouts[setLayoutCount++] = mLighting.layout();
+        setSignatures.push_back(mLighting.layoutSignature());
+    }
+    if(useShadows()){
+        setLayouts[setLayoutCount++] = mShadows.layout();
+        setSignatures.push_back(mShadows.layoutSignature());
+    }
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.setLayoutCount = setLayoutCount;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
 
-    if (vkCreatePipelineLayout(mInstance.device, &pipelineLayoutInfo, nullptr, &mRenderPass.pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    if (vkCreatePipelineLayout(mInstance.device, &pipelineLayoutInfo, nullptr, &mRenderPass.meshPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mesh pipeline layout!");
+    }
+
+    mPipelines.addLayout("mesh", mRenderPass.meshPipelineLayout, pipelineLayoutSignature(setSignatures, {pushConstantRange}));
+
+    mBuildScenePipelines(desc, mRenderPass.meshPipelines);
+
+    // Shadow casters: the same vertex stage into the shadow atlas, no
+    // fragment stage, both faces, biased away from the surfaces they shadow.
+    // Small enough to build right away.
+    if(useShadows()){
+        GraphicsPipelineDesc shadow = desc;
+        shadow.shaders.pop_back();
+        shadow.cullMode         = VK_CULL_MODE_NONE;
+        shadow.depthBias        = 1.25f;
+        shadow.depthBiasSlope   = 1.75f;
+        shadow.colorWriteMask   = 0;
+        shadow.depthFormat      = mShadows.format();
+        mRenderPass.shadowPipeline = mPipelines.build(shadow);
+    }
+
+    return true;
+}
+
+/**
+ * Meshlet pipelines, layout from MeshletCuller. Either task + mesh shaders,
+ * or a vertex shader pulling the compacted indices the culling pass wrote;
+ * neither has vertex input. Shades exactly like the mesh pipeline.
+**/
+
+bool App::mCreateMeshletPipeline(){
+    std::vector<std::string> geometryDefines;
+    std::vector<std::string> fragmentDefines;
+    if(mMeshes.vertexFormat() == VertexFormat::Packed){
+        geometryDefines.push_back("PACKED_VERTICES");
+    }
+    if(useBindless()){
+        fragmentDefines.push_back("BINDLESS");
+        fragmentDefines.push_back("MATERIAL_SET=1");
+    }
+    if(useClusteredLighting()){
+        fragmentDefines.push_back("CLUSTERED_LIGHTING");
+        fragmentDefines.push_back(useBindless() ? "LIGHT_SET=2" : "LIGHT_SET=1");
+    }
+    if(useShadows()){
+        fragmentDefines.push_back("SHADOWS");
+        fragmentDefines.push_back("SHADOW_SET=" + std::to_string(1 + useBindless() + useClusteredLighting()));
+    }
+
+    // Same sets as the mesh layout, after the meshlet geometry
+    std::vector<uint64_t> setSignatures = {mMeshlets.layoutSignature()};
+    if(useBindless()){
+        setSignatures.push_back(mBindless.layoutSignature());
+    }
+    if(useClusteredLighting()){
+        setSignatures.push_back(mLighting.layoutSignature());
     }
+    if(useShadows()){
+        setSignatures.push_back(mShadows.layoutSignature());
+    }
+    mPipelines.addLayout("meshlet", mMeshlets.drawLayout(), pipelineLayoutSignature(setSignatures, {mMeshlets.drawPushConstants()}));
+
+    GraphicsPipelineDesc desc;
+    desc.layout = "meshlet";
 
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = mRenderPass.pipelineLayout;
-    pipelineInfo.renderPass = mRenderPass.renderPass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    std::vector<ShaderConstant> fragmentConstants = {{0, static_cast<uint32_t>(mShadingView)}};
 
-    if (vkCreateGraphicsPipelines(mInstance.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mRenderPass.graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    if(mMeshlets.meshShaders()){
+        std::vector<ShaderConstant> meshConstants = {{0, mMeshlets.meshGroupSize()}};
+
+        desc.shaders.push_back({VK_SHADER_STAGE_TASK_BIT_EXT, "/shader/meshlet.task", geometryDefines});
+        desc.shaders.push_back({VK_SHADER_STAGE_MESH_BIT_EXT, "/shader/meshlet.mesh", geometryDefines, meshConstants});
+    } else {
+        desc.shaders.push_back({VK_SHADER_STAGE_VERTEX_BIT, "/shader/meshlet.vs.vert", geometryDefines});
     }
+    desc.shaders.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, "/shader/mesh.fs.frag", fragmentDefines, fragmentConstants});
 
-    vkDestroyShaderModule(mInstance.device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(mInstance.device, vertShaderModule, nullptr);
+    mBuildScenePipelines(desc, mRenderPass.meshletPipelines);
 
     return true;
 }
 
+/**
+ * Requests the pipelines of one kind of scene draw from the library: the
+ * real one and, with the depth pre-pass, its vertex only pre-pass variant,
+ * both compiled in the background. The fallback swaps in a flat fragment
+ * shader and tests LESS_OR_EQUAL so it works with or without pre-pass depth
+ * underneath; it's built right away so there's always something to draw.
+ * `desc` brings shaders (fragment last), layout, vertex input and winding.
+**/
+
+void App::mBuildScenePipelines(GraphicsPipelineDesc desc, ScenePipelines& pipelines){
+    desc.samples        = mMsaa.samples;
+    desc.colorFormat    = usePostProcessing() ? PostProcess::HDR_FORMAT : mSwapChain.swapChainImageFormat;
+    desc.depthFormat    = mDepth.format;
+
+    GraphicsPipelineDesc fallback = desc;
+    fallback.shaders.back() = {VK_SHADER_STAGE_FRAGMENT_BIT, "/shader/fallback.fs.frag", {}};
+    fallback.depthWrite     = true;
+    fallback.depthCompare   = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelines.fallback = mPipelines.build(fallback);
+
+    // The fragment shader neither discards nor writes gl_FragDepth, so the
+    // depth test runs before shading (early-Z)
+    GraphicsPipelineDesc main = desc;
+    main.depthWrite     = !mDepthPrePass;
+    main.depthCompare   = mDepthPrePass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    pipelines.main = mPipelines.request(main);
+
+    if(mDepthPrePass){
+        // Same state, no fragment stage, writes depth and no color
+        GraphicsPipelineDesc prePass = desc;
+        prePass.shaders.pop_back();
+        prePass.depthWrite      = true;
+        prePass.depthCompare    = VK_COMPARE_OP_LESS;
+        prePass.colorWriteMask  = 0;
+        pipelines.prePass = mPipelines.request(prePass);
+    }
+}
+
+// What to draw one kind of scene draw with. Until the real pipelines are all
+// in the pre-pass skips it and the main pass uses the fallback.
+VkPipeline App::mScenePipeline(const ScenePipelines& pipelines, bool prePass) const{
+    bool ready = mPipelines.ready(pipelines.main) && (!mDepthPrePass || mPipelines.ready(pipelines.prePass));
+
+    if(prePass){
+        return ready ? mPipelines.get(pipelines.prePass) : VK_NULL_HANDLE;
+    }
+    return mPipelines.get(ready ? pipelines.main : pipelines.fallback);
+}
+
 bool App::mCreateFrameBuffers(){
     mSwapChain.swapChainFramebuffers.resize(mSwapChain.swapChainImageViews.size());
 
     for(size_t i = 0; i < mSwapChain.swapChainImageViews.size(); i++){
         VkImageView attachments[] = {
-            mSwapChain.swapChainImageViews[i]
+            mSwapChain.swapChainImageViews[i],
+            mDepth.view,
+            mMsaa.view
         };
 
         VkFramebufferCreateInfo framebufferCreateInfo{};
         framebufferCreateInfo.sType             = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferCreateInfo.renderPass        = mRenderPass.renderPass;
-        framebufferCreateInfo.attachmentCount   = 1;
+        framebufferCreateInfo.attachmentCount   = mMsaa.samples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
         framebufferCreateInfo.pAttachments      = attachments;
         framebufferCreateInfo.width             = mSwapChain.swapChainExtent.width;
         framebufferCreateInfo.height            = mSwapChain.swapChainExtent.height;
@@ -628,7 +1415,8 @@ bool App::mCreateCommandpool(){
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex   = mQueue.graphicsFamilyIndex;
-    poolInfo.flags              = 0; // optional
+    // Command buffers are re-recorded every frame from the visible list
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     if(vkCreateCommandPool(mInstance.device, &poolInfo, nullptr, &mRenderPass.commandPool) != VK_SUCCESS){
         throw std::runtime_error("failed to create command pool");
@@ -638,7 +1426,7 @@ bool App::mCreateCommandpool(){
 }
 
 void App::mCreateCommandBuffers(){
-    mRenderPass.commandBuffers.resize(mSwapChain.swapChainFramebuffers.size());
+    mRenderPass.commandBuffers.resize(mSwapChain.swapChainImages.size());
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -649,49 +1437,482 @@ void App::mCreateCommandBuffers(){
     if (vkAllocateCommandBuffers(mInstance.device, &allocInfo, mRenderPass.commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
+}
+
+// Caller makes sure the GPU is done with this image's command buffer
+void App::recordCommandBuffer(uint32_t imageIndex){
+    mRecordCommandBuffer(mRenderPass.commandBuffers[imageIndex], imageIndex);
+}
+
+void App::mRecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex){
+    ProfileScope scope(&mProfiler, "record commands");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
 
-    for (size_t i = 0; i < mRenderPass.commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // This frame slot's last submission is complete, its timestamps are in
+    mGpuProfiler.beginFrame(commandBuffer, static_cast<uint32_t>(mRenderPass.currentFrame));
+    mUpdateRenderExtent();
 
-        if (vkBeginCommandBuffer(mRenderPass.commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin recording command buffer!");
+    if(useClusteredLighting()){
+        mLighting.prepare(static_cast<uint32_t>(mRenderPass.currentFrame),
+                          mLights.data(), mLights.size(),
+                          mCamera.view, mCamera.projection, mRenderExtent);
+    }
+
+    if(useShadows()){
+        mShadows.prepare(static_cast<uint32_t>(mRenderPass.currentFrame), mScene, mCamera.view, mCamera.projection);
+    }
+
+    if(useDynamicRendering()){
+        mRecordGraph(commandBuffer, imageIndex);
+    } else {
+        // Compute can't run inside rendering
+        if(mUseMeshlets){
+            GpuScope gpuScope(&mGpuProfiler, commandBuffer, "meshlet cull");
+            mRecordMeshletCull(commandBuffer);
         }
 
+        if(useClusteredLighting()){
+            GpuScope gpuScope(&mGpuProfiler, commandBuffer, "light cull");
+            mLighting.recordCull(commandBuffer);
+
+            VkMemoryBarrier barrier{};
+            barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        GpuScope gpuScope(&mGpuProfiler, commandBuffer, "scene");
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = mRenderPass.renderPass;
-        renderPassInfo.framebuffer = mSwapChain.swapChainFramebuffers[i];
+        renderPassInfo.framebuffer = mSwapChain.swapChainFramebuffers[imageIndex];
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = mSwapChain.swapChainExtent;
 
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+        // Indexed by attachment, [2] is the multisampled color target
+        VkClearValue clearValues[3]{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+        clearValues[2].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        renderPassInfo.clearValueCount = mMsaa.samples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+        renderPassInfo.pClearValues = clearValues;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        mRecordDraws(commandBuffer);
+
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    mGpuProfiler.endFrame(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+// Scene resolution of the frame being recorded, from the GPU times the
+// profiler has just read back
+void App::mUpdateRenderExtent(){
+    VkExtent2D output = mSwapChain.swapChainExtent;
+    mRenderExtent = output;
+
+    if(!useDynamicResolution()){
+        return;
+    }
+
+    // The scene pass follows the pixel count; culling and the post chain
+    // work at output resolution or on the scene's contents
+    if(const GpuTiming* scene = mGpuProfiler.timing("scene")){
+        double sceneTime = scene->last;
+
+        // Occlusion culling's second phase draws more of the same scene
+        if(const GpuTiming* late = mGpuProfiler.timing("scene late")){
+            sceneTime += late->last;
+        }
+
+        // Not frameTime(): with FIFO that includes waiting for the swapchain
+        // image, a vsync bound frame would look over budget and shrink the
+        // scene to the minimum. Scopes don't nest, together they're all of
+        // the frame's passes. The wait happens at the blit in "post copy"
+        // (see acquireWaitStage()), whose time is left out for that.
+        double frameTime = mGpuProfiler.scopeTime();
+        if(const GpuTiming* copy = mGpuProfiler.timing("post copy")){
+            frameTime -= copy->last;
+        }
+
+        mResolution.update(frameTime, sceneTime);
+    }
+
+    float scale = std::min(mResolution.scale(), 1.0f);
+    mRenderExtent.width     = std::max(1u, static_cast<uint32_t>(output.width * scale + 0.5f));
+    mRenderExtent.height    = std::max(1u, static_cast<uint32_t>(output.height * scale + 0.5f));
+}
+
+/**
+ * The frame as a render graph: meshlet and light culling, then the scene,
+ * through a multisampled target with MSAA. With post processing the scene
+ * goes to an HDR target the post chain takes to the swapchain image,
+ * otherwise straight there. The graph works out the barriers and layouts the
+ * render pass used to declare, and keeps depth and the multisampled target
+ * transient.
+ *
+ * With occlusion culling the scene pass only gets the meshlets visible last
+ * frame; its depth goes into the pyramid, the late cull tests the rest
+ * against it and "scene late" draws what it finds on top, and resolves.
+**/
+
+void App::mRecordGraph(VkCommandBuffer commandBuffer, uint32_t imageIndex){
+    VkExtent2D extent = mSwapChain.swapChainExtent;
+    bool msaa = mMsaa.samples != VK_SAMPLE_COUNT_1_BIT;
+    bool occlusion = useOcclusionCulling();
+
+    mGraph.begin();
+
+    // First use waits on the stage the submit waits for the acquire at
+    GraphImportedImage swapchainImage{};
+    swapchainImage.image            = mSwapChain.swapChainImages[imageIndex];
+    swapchainImage.view             = mSwapChain.swapChainImageViews[imageIndex];
+    swapchainImage.format           = mSwapChain.swapChainImageFormat;
+    swapchainImage.extent           = extent;
+    swapchainImage.initialLayout    = VK_IMAGE_LAYOUT_UNDEFINED;
+    swapchainImage.initialStages    = acquireWaitStage();
+    swapchainImage.finalLayout      = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    GraphResource backbuffer = mGraph.importImage("swapchain", swapchainImage);
+
+    GraphResource depth = mGraph.createImage("depth", {mDepth.format, extent, 1, mMsaa.samples});
+
+    VkFormat colorFormat = usePostProcessing() ? PostProcess::HDR_FORMAT : mSwapChain.swapChainImageFormat;
+    GraphResource target = usePostProcessing() ? mGraph.createImage("hdr", {colorFormat, extent}) : backbuffer;
+
+    // Records its own barriers against the last frame's draw and for the draw after
+    if(mUseMeshlets){
+        GraphPass cull = mGraph.addPass("meshlet cull", [this](VkCommandBuffer commandBuffer){
+            mRecordMeshletCull(commandBuffer);
+        });
+        mGraph.sideEffects(cull);
+    }
+
+    // This frame's cluster buffers, the last frame in flight has its own
+    GraphResource clusterCounts = INVALID_GRAPH_RESOURCE;
+    GraphResource clusterLights = INVALID_GRAPH_RESOURCE;
+    if(useClusteredLighting()){
+        clusterCounts = mGraph.importBuffer("cluster counts", mLighting.clusterBuffer());
+        clusterLights = mGraph.importBuffer("cluster lights", mLighting.indexBuffer());
+
+        GraphPass lightCull = mGraph.addPass("light cull", [this](VkCommandBuffer commandBuffer){
+            mLighting.recordCull(commandBuffer);
+        });
+        mGraph.write(lightCull, clusterCounts, GraphUsage::StorageCompute);
+        mGraph.write(lightCull, clusterLights, GraphUsage::StorageCompute);
+    }
+
+    // Whichever of its passes the cache and the moving casters need
+    GraphResource shadowMap = INVALID_GRAPH_RESOURCE;
+    if(useShadows()){
+        shadowMap = mShadows.addPasses(mGraph, mPipelines.get(mRenderPass.shadowPipeline), mRenderPass.meshPipelineLayout);
+    }
+
+    GraphPass scene = mGraph.addRenderPass("scene", [this](VkCommandBuffer commandBuffer){
+        mRecordDraws(commandBuffer);
+    });
+
+    if(useClusteredLighting()){
+        mGraph.read(scene, clusterCounts, GraphUsage::StorageFragment);
+        mGraph.read(scene, clusterLights, GraphUsage::StorageFragment);
+    }
+    if(useShadows()){
+        mGraph.read(scene, shadowMap, GraphUsage::SampledFragment);
+    }
+
+    // With MSAA render into the samples and resolve into the target, in
+    // the last pass drawing the scene
+    GraphResource color = msaa ? mGraph.createImage("msaa color", {colorFormat, extent, 1, mMsaa.samples}) : target;
+    GraphResource resolve = msaa ? target : INVALID_GRAPH_RESOURCE;
+
+    mGraph.color(scene, color, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 1.0f}}, occlusion ? INVALID_GRAPH_RESOURCE : resolve);
+    mGraph.depth(scene, depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+    // Targets stay full size whatever the scale, so a new one never makes new images
+    mGraph.renderArea(scene, mRenderExtent);
+
+    if(occlusion){
+        GraphResource pyramid = mDepthPyramid.addPass(mGraph, static_cast<uint32_t>(mRenderPass.currentFrame),
+                                                      depth, mRenderExtent, mMsaa.samples);
+
+        // Records its own barriers against the first phase and for the draw after
+        GraphPass lateCull = mGraph.addPass("meshlet late cull", [this](VkCommandBuffer commandBuffer){
+            mMeshlets.recordLateCull(commandBuffer);
+        });
+        mGraph.read(lateCull, pyramid, GraphUsage::SampledCompute);
+        mGraph.sideEffects(lateCull);
+
+        GraphPass late = mGraph.addRenderPass("scene late", [this](VkCommandBuffer commandBuffer){
+            mRecordLateDraws(commandBuffer);
+        });
+
+        if(useClusteredLighting()){
+            mGraph.read(late, clusterCounts, GraphUsage::StorageFragment);
+            mGraph.read(late, clusterLights, GraphUsage::StorageFragment);
+        }
+        if(useShadows()){
+            mGraph.read(late, shadowMap, GraphUsage::SampledFragment);
+        }
+
+        mGraph.color(late, color, VK_ATTACHMENT_LOAD_OP_LOAD, {{0.0f, 0.0f, 0.0f, 1.0f}}, resolve);
+        mGraph.depth(late, depth, VK_ATTACHMENT_LOAD_OP_LOAD);
+        mGraph.renderArea(late, mRenderExtent);
+    }
+
+    if(usePostProcessing()){
+        mPost.addPasses(mGraph, static_cast<uint32_t>(mRenderPass.currentFrame),
+                        target, mRenderExtent, backbuffer, extent);
+    }
+
+    if(useReadback()){
+        mReadback.addPass(mGraph, static_cast<uint32_t>(mRenderPass.currentFrame), backbuffer);
+    }
+
+    mGraph.compile();
+    mGraph.execute(commandBuffer);
+}
+
+void App::mRecordDraws(VkCommandBuffer commandBuffer){
+    DrawPushConstants drawConstants{};
+
+    mSetSceneViewport(commandBuffer);
+
+    // Bound once, every draw after this only changes push constants
+    if(useBindless()){
+        mBindless.bind(commandBuffer, mRenderPass.pipelineLayout);
+        vkCmdPushConstants(commandBuffer, mRenderPass.pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(DrawPushConstants), &drawConstants);
+    }
+
+    // The built in triangle lives in clip space, outside the scene
+    if(mDepthPrePass){
+        mRecordTriangle(commandBuffer, mScenePipeline(mRenderPass.trianglePipelines, true));
+        mRecordMeshDraws(commandBuffer, mScenePipeline(mRenderPass.meshPipelines, true));
+        mRecordMeshletDraws(commandBuffer, mScenePipeline(mRenderPass.meshletPipelines, true));
+    }
+
+    mRecordTriangle(commandBuffer, mScenePipeline(mRenderPass.trianglePipelines, false));
+    mRecordMeshDraws(commandBuffer, mScenePipeline(mRenderPass.meshPipelines, false));
+    mRecordMeshletDraws(commandBuffer, mScenePipeline(mRenderPass.meshletPipelines, false));
+}
+
+// Meshlets the first occlusion culling phase missed, over what it drew
+void App::mRecordLateDraws(VkCommandBuffer commandBuffer){
+    mSetSceneViewport(commandBuffer);
+
+    if(mDepthPrePass){
+        mRecordMeshletDraws(commandBuffer, mScenePipeline(mRenderPass.meshletPipelines, true), true);
+    }
+
+    mRecordMeshletDraws(commandBuffer, mScenePipeline(mRenderPass.meshletPipelines, false), true);
+}
+
+// Every library pipeline takes the viewport and scissor from here
+void App::mSetSceneViewport(VkCommandBuffer commandBuffer){
+    VkViewport viewport{};
+    viewport.width = (float) mRenderExtent.width;
+    viewport.height = (float) mRenderExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = mRenderExtent;
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void App::mRecordTriangle(VkCommandBuffer commandBuffer, VkPipeline pipeline){
+    if(pipeline == VK_NULL_HANDLE){
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void App::mRecordMeshDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline){
+    if(mMeshes.count() == 0 || pipeline == VK_NULL_HANDLE){
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    mMeshes.bind(commandBuffer);
+
+    // The push constant range differs from the triangle layout, so the set
+    // isn't compatible across the switch and has to be bound again
+    if(useBindless()){
+        mBindless.bind(commandBuffer, mRenderPass.meshPipelineLayout);
+    }
+    if(useClusteredLighting()){
+        mLighting.bind(commandBuffer, mRenderPass.meshPipelineLayout, useBindless() ? 1 : 0);
+    }
+    if(useShadows()){
+        mShadows.bind(commandBuffer, mRenderPass.meshPipelineLayout, useBindless() + useClusteredLighting());
+    }
+
+    glm::mat4 viewProjection = mCamera.projection * mCamera.view;
+
+    MeshPushConstants constants{};
+
+    for(uint32_t node : mVisible){
+        const RenderHandle& handle = mScene.renderHandles[node];
+        if(handle.mesh == UINT32_MAX) continue;
+
+        // Taken by the meshlet path
+        if(node < mMeshletNodes.size() && mMeshletNodes[node]) continue;
+
+        const GpuMesh& mesh = mMeshes.get(handle.mesh);
+        const MeshLod& lod  = mesh.lods[mScene.lodLevels[node]];
+
+        const glm::mat4& world  = mScene.worldMatrices[node];
+        glm::mat4 worldRows     = glm::transpose(world);
+
+        constants.transform     = viewProjection * world;
+        constants.world[0]      = worldRows[0];
+        constants.world[1]      = worldRows[1];
+        constants.world[2]      = worldRows[2];
+        constants.materialIndex = handle.material;
+        constants.instanceIndex = node;
+
+        vkCmdPushConstants(commandBuffer, mRenderPass.meshPipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(MeshPushConstants), &constants);
+
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, mesh.firstIndex + lod.indexOffset, mesh.vertexOffset, 0);
+    }
+}
+
+// Visible instances at LOD 0 of a mesh cooked with meshlets go through cluster
+// culling, coarser LODs are small enough to draw whole
+void App::mRecordMeshletCull(VkCommandBuffer commandBuffer){
+    // Start over in this frame's arena, the last frame's copies stay in its own
+    mMeshletInstances = ArenaVector<MeshletInstance>(ArenaAllocator<MeshletInstance>(&frameArena()));
+    mMeshletNodes = ArenaVector<uint8_t>(mScene.size(), 0, ArenaAllocator<uint8_t>(&frameArena()));
+
+    // Growing in an arena leaves every outgrown copy behind until the reset
+    mMeshletInstances.reserve(std::min<size_t>(mVisible.size(), mMeshlets.maxInstances()));
+
+    glm::mat4 viewProjection = mCamera.projection * mCamera.view;
 
-        vkCmdBeginRenderPass(mRenderPass.commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    for(uint32_t node : mVisible){
+        const RenderHandle& handle = mScene.renderHandles[node];
+        if(handle.mesh == UINT32_MAX || mScene.lodLevels[node] != 0) continue;
 
-        vkCmdBindPipeline(mRenderPass.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mRenderPass.graphicsPipeline);
+        const GpuMesh& mesh = mMeshes.get(handle.mesh);
+        if(mesh.meshletCount == 0) continue;
 
-        vkCmdDraw(mRenderPass.commandBuffers[i], 3, 1, 0, 0);
+        // The rest fall back to plain indexed draws
+        if(mMeshletInstances.size() >= mMeshlets.maxInstances()) break;
 
-        vkCmdEndRenderPass(mRenderPass.commandBuffers[i]);
+        MeshletInstance instance;
+        instance.world          = mScene.worldMatrices[node];
+        instance.clipFromObject = viewProjection * instance.world;
+        instance.meshletOffset  = mesh.meshletOffset;
+        instance.meshletCount   = mesh.meshletCount;
+        instance.materialIndex  = handle.material;
+        instance.scale          = mScene.localBounds[node].w > 0.0f ? mScene.boundsRadius[node] / mScene.localBounds[node].w : 1.0f;
 
-        if (vkEndCommandBuffer(mRenderPass.commandBuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+        if(useOcclusionCulling()){
+            instance.visibilityOffset = mMeshlets.visibilityOffset(node, mesh.meshletCount);
         }
+
+        mMeshletInstances.push_back(instance);
+        mMeshletNodes[node] = 1;
+    }
+
+    mMeshlets.prepare(static_cast<uint32_t>(mRenderPass.currentFrame),
+                      mMeshletInstances.data(),
+                      mMeshletInstances.size(),
+                      extractFrustum(viewProjection),
+                      glm::vec3(glm::inverse(mCamera.view)[3]));
+
+    mMeshlets.recordCull(commandBuffer);
+}
+
+void App::mRecordMeshletDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, bool late){
+    if(!mUseMeshlets || mMeshletInstances.empty() || pipeline == VK_NULL_HANDLE){
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    if(useBindless()){
+        mBindless.bind(commandBuffer, mMeshlets.drawLayout(), 1);
+    }
+    if(useClusteredLighting()){
+        mLighting.bind(commandBuffer, mMeshlets.drawLayout(), useBindless() ? 2 : 1);
+    }
+    if(useShadows()){
+        mShadows.bind(commandBuffer, mMeshlets.drawLayout(), 1 + useBindless() + useClusteredLighting());
+    }
+
+    if(late){
+        mMeshlets.recordLateDraw(commandBuffer);
+    } else {
+        mMeshlets.recordDraw(commandBuffer);
     }
 }
 
 void App::mCreateSyncObjects(){
     mRenderPass.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     mRenderPass.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    mRenderPass.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    mRenderPass.imagesInFlight.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
+    if(mUseTimelineSemaphores && mFeatures.timelineSemaphore){
+        // Binary semaphores are still needed for acquire/present, the swapchain
+        // can't wait on or signal a timeline. Everything the CPU waits on goes
+        // through the single timeline semaphore.
+        for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
+            if(vkCreateSemaphore(mInstance.device, &semaphoreInfo, nullptr, &mRenderPass.imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(mInstance.device, &semaphoreInfo, nullptr, &mRenderPass.renderFinishedSemaphores[i]) != VK_SUCCESS){
+                throw std::runtime_error("failed to create semaphore");
+            }
+        }
+
+        VkSemaphoreTypeCreateInfo timelineInfo{};
+        timelineInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType  = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue   = 0;
+
+        VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+        timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        timelineSemaphoreInfo.pNext = &timelineInfo;
+
+        if(vkCreateSemaphore(mInstance.device, &timelineSemaphoreInfo, nullptr, &mTimeline.semaphore) != VK_SUCCESS){
+            throw std::runtime_error("failed to create timeline semaphore");
+        }
+
+        mTimeline.value = 0;
+        mTimeline.frameValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+        mTimeline.imageValues.assign(mSwapChain.swapChainImages.size(), 0);
+
+        return;
+    }
+
+    mRenderPass.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    mRenderPass.imagesInFlight.resize(mSwapChain.swapChainImages.size(), VK_NULL_HANDLE);
+
     VkFenceCreateInfo fenceCreateInfo{};
     fenceCreateInfo.sType               = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.flags               = VK_FENCE_CREATE_SIGNALED_BIT;
@@ -705,11 +1926,195 @@ void App::mCreateSyncObjects(){
     }
 }
 
+bool App::useTimeline() const{
+    return mTimeline.semaphore != VK_NULL_HANDLE;
+}
+
+VkPipelineStageFlags2 App::acquireWaitStage() const{
+    // With post processing the scene goes to a target of its own, waiting
+    // any earlier would hold it up (and its timer) until the image is free
+    return usePostProcessing() ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+}
+
+/**
+ * Submits command buffers waiting on at most one semaphore. Without
+ * synchronization2 there is no post processing, so the wait stage is one of
+ * the original stages, whose bits are the same in both flag types.
+**/
+
+void App::submit(VkQueue queue,
+                 uint32_t commandBufferCount,
+                 const VkCommandBuffer* commandBuffers,
+                 VkSemaphore waitSemaphore,
+                 VkPipelineStageFlags2 waitStage,
+                 uint32_t signalCount,
+                 const VkSemaphore* signalSemaphores,
+                 const uint64_t* signalValues,
+                 VkFence fence){
+    // Fixed arrays, nothing allocated per frame
+    const uint32_t MAX_SUBMIT = 4;
+    if(commandBufferCount > MAX_SUBMIT || signalCount > MAX_SUBMIT){
+        throw std::runtime_error("failed to submit, too many command buffers or semaphores");
+    }
+
+    if(mFeatures.synchronization2){
+        VkSemaphoreSubmitInfo waitInfo{};
+        waitInfo.sType      = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        waitInfo.semaphore  = waitSemaphore;
+        waitInfo.stageMask  = waitStage;
+
+        VkSemaphoreSubmitInfo signalInfos[MAX_SUBMIT]{};
+        for(uint32_t i = 0; i < signalCount; i++){
+            signalInfos[i].sType        = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            signalInfos[i].semaphore    = signalSemaphores[i];
+            signalInfos[i].value        = signalValues != nullptr ? signalValues[i] : 0;
+            signalInfos[i].stageMask    = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        }
+
+        VkCommandBufferSubmitInfo commandBufferInfos[MAX_SUBMIT]{};
+        for(uint32_t i = 0; i < commandBufferCount; i++){
+            commandBufferInfos[i].sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+            commandBufferInfos[i].commandBuffer = commandBuffers[i];
+        }
+
+        VkSubmitInfo2 submitInfo{};
+        submitInfo.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        submitInfo.waitSemaphoreInfoCount   = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pWaitSemaphoreInfos      = &waitInfo;
+        submitInfo.commandBufferInfoCount   = commandBufferCount;
+        submitInfo.pCommandBufferInfos      = commandBufferInfos;
+        submitInfo.signalSemaphoreInfoCount = signalCount;
+        submitInfo.pSignalSemaphoreInfos    = signalInfos;
+
+        if(vkQueueSubmit2(queue, 1, &submitInfo, fence) != VK_SUCCESS){
+            throw std::runtime_error("failed to submit command buffers");
+        }
+        return;
+    }
+
+    VkPipelineStageFlags legacyStage = static_cast<VkPipelineStageFlags>(waitStage);
+
+    // Values for binary semaphores are ignored but the arrays must line up
+    uint64_t waitValue = 0;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType                      = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount    = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues       = &waitValue;
+    timelineInfo.signalSemaphoreValueCount  = signalCount;
+    timelineInfo.pSignalSemaphoreValues     = signalValues;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext                = signalValues != nullptr ? &timelineInfo : nullptr;
+    submitInfo.waitSemaphoreCount   = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    submitInfo.pWaitSemaphores      = &waitSemaphore;
+    submitInfo.pWaitDstStageMask    = &legacyStage;
+    submitInfo.commandBufferCount   = commandBufferCount;
+    submitInfo.pCommandBuffers      = commandBuffers;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores    = signalSemaphores;
+
+    if(vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS){
+        throw std::runtime_error("failed to submit command buffers");
+    }
+}
+
+/**
+ * Submits command buffers and signals the next timeline value, which is returned.
+ * Optional binary semaphores cover the swapchain acquire / present hand off.
+**/
+
+uint64_t App::submitTimeline(VkQueue queue,
+                             uint32_t commandBufferCount,
+                             const VkCommandBuffer* commandBuffers,
+                             VkSemaphore waitSemaphore,
+                             VkPipelineStageFlags2 waitStage,
+                             VkSemaphore signalSemaphore){
+    uint64_t signalValue = ++mTimeline.value;
+
+    // Values for binary semaphores are ignored but the arrays must line up
+    uint64_t signalValues[]         = {signalValue, 0};
+    VkSemaphore signalSemaphores[]  = {mTimeline.semaphore, signalSemaphore};
+
+    submit(queue, commandBufferCount, commandBuffers,
+           waitSemaphore, waitStage,
+           signalSemaphore != VK_NULL_HANDLE ? 2 : 1, signalSemaphores, signalValues,
+           VK_NULL_HANDLE);
+
+    return signalValue;
+}
+
+bool App::timelineReached(uint64_t value) const{
+    uint64_t current = 0;
+    vkGetSemaphoreCounterValue(mInstance.device, mTimeline.semaphore, &current);
+    return current >= value;
+}
+
+void App::waitTimeline(uint64_t value) const{
+    // Nothing submitted yet for this slot
+    if(value == 0) return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &mTimeline.semaphore;
+    waitInfo.pValues        = &value;
+
+    vkWaitSemaphores(mInstance.device, &waitInfo, UINT64_MAX);
+}
+
 void App::cleanup(){
+    if(useBindless()){
+        mBindless.cleanup();
+    }
+
+    if(mUseMeshlets){
+        mMeshlets.cleanup();
+    }
+
+    if(useOcclusionCulling()){
+        mDepthPyramid.cleanup();
+    }
+
+    if(useClusteredLighting()){
+        mLighting.cleanup();
+    }
+
+    if(useShadows()){
+        mShadows.cleanup();
+    }
+
+    // Writes out whatever is still queued first. A write failing after the
+    // last push() shows up here; run() reports it like a render error.
+    if(useStreaming()){
+        try{
+            mEncoder.cleanup();
+        } catch(...){
+            if(!mRenderError){
+                mRenderError = std::current_exception();
+            }
+        }
+    }
+
+    if(useReadback()){
+        mReadback.cleanup();
+    }
+
+    mMeshes.cleanup();
+    mTextures.cleanup();
+
     for(int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
         vkDestroySemaphore(mInstance.device, mRenderPass.renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(mInstance.device, mRenderPass.imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(mInstance.device, mRenderPass.inFlightFences[i], nullptr);
+    }
+
+    for(auto fence : mRenderPass.inFlightFences){
+        vkDestroyFence(mInstance.device, fence, nullptr);
+    }
+
+    if(useTimeline()){
+        vkDestroySemaphore(mInstance.device, mTimeline.semaphore, nullptr);
     }
 
     vkDestroyCommandPool(mInstance.device, mRenderPass.commandPool, nullptr);
@@ -718,10 +2123,25 @@ void App::cleanup(){
         vkDestroyFramebuffer(mInstance.device, framebuffer, nullptr);
     }
 
-    vkDestroyPipeline(mInstance.device, mRenderPass.graphicsPipeline, nullptr);
+    if(usePostProcessing()){
+        mPost.cleanup();
+    }
+
+    mGraph.cleanup();
+    mGpuProfiler.cleanup();
+    mPipelines.cleanup();
     vkDestroyPipelineLayout(mInstance.device, mRenderPass.pipelineLayout, nullptr);
+    vkDestroyPipelineLayout(mInstance.device, mRenderPass.meshPipelineLayout, nullptr);
     vkDestroyRenderPass(mInstance.device, mRenderPass.renderPass, nullptr);
 
+    vkDestroyImageView(mInstance.device, mMsaa.view, nullptr);
+    vkDestroyImage(mInstance.device, mMsaa.image, nullptr);
+    vkFreeMemory(mInstance.device, mMsaa.memory, nullptr);
+
+    vkDestroyImageView(mInstance.device, mDepth.view, nullptr);
+    vkDestroyImage(mInstance.device, mDepth.image, nullptr);
+    vkFreeMemory(mInstance.device, mDepth.memory, nullptr);
+
     for (auto imageView : mSwapChain.swapChainImageViews) {
         vkDestroyImageView(mInstance.device, imageView, nullptr);
     }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <exception>
 #include <vector>
  #define NDEBUG
 #define VK_USE_PLATFORM_XCB_KHR
@@ -20,9 +22,27 @@
 
 #include <shaderc/shaderc.hpp>
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+#include "Arena.hpp"
+#include "Bindless.hpp"
+#include "Culling.hpp"
+#include "DepthPyramid.hpp"
+#include "DynamicResolution.hpp"
+#include "FrameEncoder.hpp"
+#include "GpuProfiler.hpp"
+#include "Input.hpp"
+#include "Jobs.hpp"
+#include "Lighting.hpp"
+#include "MeshManager.hpp"
+#include "Meshlets.hpp"
+#include "Pipelines.hpp"
+#include "PostProcess.hpp"
+#include "Readback.hpp"
+#include "RenderGraph.hpp"
+#include "Scene.hpp"
+#include "Shadows.hpp"
+#include "Texture.hpp"
 
-void framebuffer_size_callback(GLFWwindow*, int, int);
+const int MAX_FRAMES_IN_FLIGHT = 2;
 
 struct VulkanShader{
     VkShaderModule  vertexShaderModule;
@@ -38,6 +58,7 @@ struct VulkanInstance{
     VkInstance          instance        = VK_NULL_HANDLE;
     VkPhysicalDevice    physicalDevice  = VK_NULL_HANDLE;
     VkDevice            device          = VK_NULL_HANDLE;    
+    uint32_t            apiVersion      = VK_API_VERSION_1_0;
 };
 
 struct VulkanQueue{
@@ -56,14 +77,86 @@ struct VulkanSwapChain{
     std::vector<VkFramebuffer>  swapChainFramebuffers;
 };
 
+struct VulkanFeatures{
+    uint32_t    apiVersion          = VK_API_VERSION_1_0;
+    bool        timelineSemaphore   = false;
+    bool        dynamicRendering    = false;
+    bool        synchronization2    = false;
+    bool        descriptorIndexing  = false;   // everything the bindless table needs
+    bool        meshShader          = false;   // VK_EXT_mesh_shader with task and mesh stages
+
+    // Core 1.0 features, enabled whenever present
+    bool        samplerAnisotropy       = false;
+    float       maxSamplerAnisotropy    = 1.0f;
+    bool        textureCompressionBC    = false;
+    bool        textureCompressionETC2  = false;
+    bool        textureCompressionASTC  = false;
+};
+
+// Timeline semaphore sync backend (Vulkan 1.2). Every submission signals a
+// monotonically increasing value, so "frame N done" / "upload M done" is just
+// a wait on that value instead of a fence per frame.
+struct VulkanTimeline{
+    VkSemaphore             semaphore = VK_NULL_HANDLE;
+    uint64_t                value     = 0;      // last value handed to a submission
+    std::vector<uint64_t>   frameValues;        // value signalled by each frame in flight
+    std::vector<uint64_t>   imageValues;        // value of the last frame that used each swapchain image
+};
+
+// Depth is cleared on load and never stored, so on tilers it lives in tile
+// memory only and is backed by lazily allocated memory where available. With
+// dynamic rendering the render graph owns the image, only the format is used.
+struct VulkanDepth{
+    VkImage         image   = VK_NULL_HANDLE;
+    VkDeviceMemory  memory  = VK_NULL_HANDLE;
+    VkImageView     view    = VK_NULL_HANDLE;
+    VkFormat        format  = VK_FORMAT_UNDEFINED;
+};
+
+// Multisampled color target, resolved into the swapchain image at the end of
+// the subpass. Never stored, so it is transient/lazily allocated like depth.
+// Also a render graph image with dynamic rendering.
+struct VulkanMsaa{
+    VkSampleCountFlagBits   samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImage                 image   = VK_NULL_HANDLE;
+    VkDeviceMemory          memory  = VK_NULL_HANDLE;
+    VkImageView             view    = VK_NULL_HANDLE;
+};
+
+struct Camera{
+    glm::mat4 view          = glm::mat4(1.0f);
+    glm::mat4 projection    = glm::mat4(1.0f);
+};
+
 struct VulkanSurface{
     VkSurfaceKHR surface;
 };
 
+// What the mesh fragment shader outputs, SHADING_VIEW in shader/mesh.fs.frag
+enum class ShadingView : uint32_t{
+    Lit,
+    Albedo,
+    Normals,
+    UVs,
+    Lights,     // how many lights each pixel's cluster has, with clustered lighting
+    Cascades    // which shadow cascade each pixel reads, with shadows
+};
+
+// Library pipelines of one kind of scene draw
+struct ScenePipelines{
+    PipelineId main     = INVALID_PIPELINE;
+    PipelineId prePass  = INVALID_PIPELINE;    // with the depth pre-pass only
+    PipelineId fallback = INVALID_PIPELINE;    // drawn with until the others are compiled
+};
+
 struct VulkanRenderPass{
-    VkRenderPass renderPass;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    VkPipelineLayout meshPipelineLayout = VK_NULL_HANDLE;
+    ScenePipelines trianglePipelines;
+    ScenePipelines meshPipelines;
+    ScenePipelines meshletPipelines;
+    PipelineId shadowPipeline = INVALID_PIPELINE;     // depth only mesh casters
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
     std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -95,26 +188,144 @@ class App{
 
         VkDebugUtilsMessengerEXT debugMessenger = NULL;
 
+        // Use timeline semaphores instead of per frame fences when supported
+        bool mUseTimelineSemaphores = true;
+
+        // Use vkCmdBeginRendering instead of render pass + framebuffer objects when supported
+        bool mUseDynamicRendering = true;
+
+        // Render the scene in HDR and take it to the swapchain through bloom,
+        // tonemapping and FXAA in compute. Needs dynamic rendering, the render
+        // pass path draws straight into the swapchain image.
+        bool mPostProcessing = true;
+
+        // Render the scene at a fraction of the output resolution, picked to
+        // hold the GPU frame time in mResolution.settings, and upscale it with
+        // sharpening. Needs post processing and GPU timestamps.
+        bool mDynamicResolution = true;
+
+        // VK_FORMAT_UNDEFINED picks the best depth format the device supports
+        VkFormat mRequestedDepthFormat = VK_FORMAT_UNDEFINED;
+
+        // Lay down depth with a position only pass first, then shade with an EQUAL
+        // test so each pixel runs the fragment shader once. Worth it for heavy shaders.
+        bool mDepthPrePass = false;
+
+        // Debug views of meshes and meshlets, a specialization constant each
+        ShadingView mShadingView = ShadingView::Lit;
+
+        // 1x, 2x, 4x or 8x, clamped to what the device supports for color and depth
+        VkSampleCountFlagBits mRequestedSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        // Single update-after-bind descriptor set, resources picked by push constant index
+        bool mUseBindless = true;
+
+        // Keep mesh vertices as half positions, octahedral normals and half UVs
+        // on the GPU, halving vertex fetch bandwidth
+        bool mPackedVertices = true;
+
+        // Coarsest mesh LOD whose simplification error stays under this many pixels
+        float mLodPixelError = 1.0f;
+
+        // Print the CPU and GPU profiles of the last frame once a second
+        bool mPrintProfile = false;
+
+        // Draw LOD 0 of meshes cooked with meshlets through GPU cluster culling
+        bool mUseMeshlets = true;
+
+        // Cull and draw meshlets in task/mesh shaders when VK_EXT_mesh_shader is
+        // there, otherwise a compute pre-pass feeds one indirect draw
+        bool mUseMeshShaders = true;
+
+        // Draw the meshlets visible last frame first, then test the rest
+        // against a depth pyramid of what that drew and draw only what shows
+        // up. The compute meshlet path with dynamic rendering only.
+        bool mOcclusionCulling = true;
+
+        // Shade meshes with mLights, binned into view space clusters by a
+        // compute pass each frame. Without it they only get a sky light.
+        bool mClusteredLighting = true;
+
+        // Cascaded shadow maps for mShadows.settings' directional light, with
+        // static casters cached. Needs dynamic rendering.
+        bool mCascadedShadows = true;
+
+        // Copy every finished frame back to host memory and hand it to
+        // onFrameReadback() frames in flight later. Needs dynamic rendering
+        // and a swapchain that can be copied from.
+        bool mFrameReadback = false;
+
+        // Stream every frame read back to mEncoder.settings' output from an
+        // I/O thread, rendering no faster than it writes. Reads frames back
+        // on its own; ends the render loop after settings.frames. Streaming
+        // to stdout moves everything else printed to stderr.
+        bool mStreamFrames = false;
+
+        // Transient CPU data of each frame in flight, reset once its slot is free
+        LinearArena mFrameArenas[MAX_FRAMES_IN_FLIGHT];
+
+        // What the scene renders at this frame, the top left of its full size
+        // targets. The output's extent without dynamic resolution.
+        VkExtent2D mRenderExtent = {0, 0};
+
+        // This frame's meshlet instances and which visible nodes they cover,
+        // in the frame arena
+        ArenaVector<MeshletInstance> mMeshletInstances;
+        ArenaVector<uint8_t> mMeshletNodes;
+
         double currentFrame = 0;
         double lastFrame = currentFrame;
         double deltaTime;        
+
+        // Filled by the main thread's GLFW callbacks, drained by the render thread
+        InputQueue          mInputQueue;
+        InputState          mInput;
+
+        // Render thread only
+        bool                mQuit = false;
+
+        std::atomic<bool>   mRenderDone{false};
+        std::exception_ptr  mRenderError;
         
-        void loop();
+        void renderLoop();
+        void mWaitForFrame();
+        void mDrainReadback(bool idle = false);
+        void mSampleInput();
         void calculateDeltaTime();
+        void mCullScene();
+        void mSelectLods();
+        void mUpdateRenderExtent();
 
         // Vulkan setup
         bool mVkCreateInstance();
         bool mSetupDebugMessenger();
         bool mCreateSurface();
         bool mPickPhysicalDevice();
+        void mQueryDeviceFeatures();
         bool mCreateLogicalDevice();
         bool mCreateSwapChain();
         bool mCreateImageViews();
+        bool mCreateDepthResources();
+        bool mCreateColorResources();
+        bool mCreateBindlessResources();
         bool mCreateRenderPass();
         bool mCreateGraphicsPipeline();
+        bool mCreateMeshPipeline();
+        bool mCreateMeshletPipeline();
+        void mBuildScenePipelines(GraphicsPipelineDesc, ScenePipelines&);
+        VkPipeline mScenePipeline(const ScenePipelines&, bool prePass) const;
         bool mCreateFrameBuffers();
         bool mCreateCommandpool();
         void mCreateCommandBuffers();
+        void mRecordCommandBuffer(VkCommandBuffer, uint32_t);
+        void mRecordGraph(VkCommandBuffer, uint32_t);
+        void mRecordDraws(VkCommandBuffer);
+        void mRecordLateDraws(VkCommandBuffer);
+        void mSetSceneViewport(VkCommandBuffer);
+        void mRecordTriangle(VkCommandBuffer, VkPipeline);
+        void mRecordMeshDraws(VkCommandBuffer, VkPipeline);
+        void mRecordMeshletCull(VkCommandBuffer);
+        void mRecordMeshletDraws(VkCommandBuffer, VkPipeline, bool late = false);
         void mCreateSyncObjects();
 
         // vulkan cleanup
@@ -130,16 +341,107 @@ class App{
         VulkanSwapChain mSwapChain;
         VulkanShader    mShader;
         VulkanRenderPass mRenderPass;
+        VulkanDepth     mDepth;
+        VulkanMsaa      mMsaa;
+        VulkanFeatures  mFeatures;
+        VulkanTimeline  mTimeline;
+        TextureManager  mTextures;
+        BindlessTable   mBindless;
+        MeshManager     mMeshes;
+        MeshletCuller   mMeshlets;
+        DepthPyramid    mDepthPyramid;
+        PipelineLibrary mPipelines;
+
+        // Passes of the frame with dynamic rendering, rebuilt every frame
+        RenderGraph     mGraph;
+        PostProcess     mPost;
+        DynamicResolution mResolution;
+
+        Scene           mScene;
+        Camera          mCamera;
+
+        // Point and spot lights of the scene, binned into clusters every frame
+        std::vector<Light> mLights;
+        ClusteredLighting mLighting;
+
+        // The sun's shadows, cascades fitted to mCamera every frame
+        CascadedShadows mShadows;
+
+        // Frame phases and their inner loops run as jobs, every job is timed
+        CpuProfiler     mProfiler;
+        JobSystem       mJobs{0, &mProfiler};
+
+        // GPU time of every graph pass, read back a frame in flight later
+        GpuProfiler     mGpuProfiler;
+
+        // Finished frames on their way back to the CPU, with mFrameReadback
+        FrameReadback   mReadback;
+
+        // Writes them out with mStreamFrames
+        FrameEncoder    mEncoder;
+
+        // Scene nodes that survived culling this frame, in node order
+        std::vector<uint32_t> mVisible;
+
+        // Scratch memory for the frame being built, gone after the frame's
+        // submission completes. One thread at a time.
+        LinearArena& frameArena();
 
         virtual void initDraw() = 0;
+
+        // Called on the render thread once the current frame slot is free
         virtual void draw() = 0;
 
+        // Once a frame on the render thread, with input sampled just before
+        virtual void processInput(const InputState&){}
+
+        // On the render thread for every frame read back, in order, before
+        // the frame that frees its slot is drawn. The pixels are gone after.
+        virtual void onFrameReadback(const ReadbackFrame&){}
+
         void start();
 
         WindowInfo getWindow() const;
 
+        // As of the last input sample
         bool keyPressed(int) const;
-        void terminate() const;
+        const InputState& input() const;
+
+        // Ends the render loop after this frame
+        void terminate();
 
         double getDeltaTime();
+
+        void recordCommandBuffer(uint32_t);
+
+        bool useDynamicRendering() const;
+        bool useBindless() const;
+        bool useMeshShaders() const;
+        bool usePostProcessing() const;
+        bool useDynamicResolution() const;
+        bool useClusteredLighting() const;
+        bool useShadows() const;
+        bool useOcclusionCulling() const;
+        bool useReadback() const;
+        bool useStreaming() const;
+
+        // Where a frame waits for its swapchain image: the first write to
+        // it, the post chain's blit or else the scene's color output
+        VkPipelineStageFlags2 acquireWaitStage() const;
+
+        // vkQueueSubmit2 with synchronization2, the only way to wait at the
+        // blit stage alone; `signalValues` only for timeline semaphores
+        void submit(VkQueue, uint32_t, const VkCommandBuffer*,
+                    VkSemaphore waitSemaphore, VkPipelineStageFlags2 waitStage,
+                    uint32_t signalCount, const VkSemaphore* signalSemaphores,
+                    const uint64_t* signalValues, VkFence);
+
+        // Timeline sync
+        bool useTimeline() const;
+        uint64_t submitTimeline(VkQueue, uint32_t, const VkCommandBuffer*,
+                                VkSemaphore waitSemaphore = VK_NULL_HANDLE,
+                                VkPipelineStageFlags2 waitStage = VK_PIPELINE_STAGE_2_NONE,
+                                VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+        bool timelineReached(uint64_t) const;
+        void waitTimeline(uint64_t) const;
 };
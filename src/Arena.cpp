@@ -0,0 +1,78 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+LinearArena::LinearArena(size_t blockSize){
+    addBlock(std::max<size_t>(blockSize, 256));
+}
+
+LinearArena::~LinearArena(){
+    for(Block& block : mBlocks){
+        ::operator delete(block.data);
+    }
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment){
+    Block* block = &mBlocks.back();
+
+    // Aligned on the address, blocks themselves only come max_align_t aligned
+    uintptr_t base      = reinterpret_cast<uintptr_t>(block->data);
+    uintptr_t aligned   = (base + mOffset + alignment - 1) & ~uintptr_t(alignment - 1);
+
+    if(aligned + size > base + block->size){
+        addBlock(std::max(block->size * 2, size + alignment));
+
+        block   = &mBlocks.back();
+        base    = reinterpret_cast<uintptr_t>(block->data);
+        aligned = (base + alignment - 1) & ~uintptr_t(alignment - 1);
+    }
+
+    mOffset = aligned + size - base;
+    mUsed   += size;
+    mPeak   = std::max(mPeak, mUsed);
+
+    return reinterpret_cast<void*>(aligned);
+}
+
+void LinearArena::reset(){
+    // Replace a chain with one block that would have held all of it
+    if(mBlocks.size() > 1){
+        size_t total = capacity();
+
+        for(Block& block : mBlocks){
+            ::operator delete(block.data);
+        }
+        mBlocks.clear();
+
+        addBlock(total);
+    }
+
+    mOffset = 0;
+    mUsed   = 0;
+}
+
+size_t LinearArena::used() const{
+    return mUsed;
+}
+
+size_t LinearArena::peak() const{
+    return mPeak;
+}
+
+size_t LinearArena::capacity() const{
+    size_t total = 0;
+    for(const Block& block : mBlocks){
+        total += block.size;
+    }
+    return total;
+}
+
+void LinearArena::addBlock(size_t size){
+    Block block;
+    block.data = static_cast<uint8_t*>(::operator new(size));
+    block.size = size;
+    mBlocks.push_back(block);
+
+    mOffset = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bump allocator for data that only lives for a frame. Allocating moves an
+ * offset through the current block and nothing is freed on its own; reset()
+ * drops everything at once. A frame that outgrows the block chains more
+ * blocks, and the next reset() folds them into one block that fits the whole
+ * frame, so once the frame size settles the arena never goes to the heap.
+ *
+ * Not thread safe, one thread at a time uses an arena.
+**/
+
+class LinearArena{
+    public:
+        explicit LinearArena(size_t blockSize = 64 * 1024);
+        ~LinearArena();
+
+        LinearArena(const LinearArena&) = delete;
+        LinearArena& operator=(const LinearArena&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+        void reset();
+
+        // Bytes handed out since the last reset, and the most any frame used
+        size_t used() const;
+        size_t peak() const;
+        size_t capacity() const;
+
+    private:
+        struct Block{
+            uint8_t*    data = nullptr;
+            size_t      size = 0;
+        };
+
+        void addBlock(size_t);
+
+        std::vector<Block>  mBlocks;       // allocating from the last one
+        size_t              mOffset     = 0;
+        size_t              mUsed       = 0;
+        size_t              mPeak       = 0;
+};
+
+/**
+ * Standard allocator over a LinearArena, so std containers can live in frame
+ * memory. deallocate() is a no-op, the memory comes back on reset. Without an
+ * arena it falls back to the heap, which lets the same container type be used
+ * where no arena is at hand.
+**/
+
+template<typename T>
+class ArenaAllocator{
+    public:
+        using value_type = T;
+
+        // Containers take the arena along when they are assigned or swapped
+        using propagate_on_container_copy_assignment    = std::true_type;
+        using propagate_on_container_move_assignment    = std::true_type;
+        using propagate_on_container_swap               = std::true_type;
+
+        ArenaAllocator(LinearArena* arena = nullptr) noexcept : mArena(arena){}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : mArena(other.arena()){}
+
+        T* allocate(size_t count){
+            if(mArena != nullptr){
+                return static_cast<T*>(mArena->allocate(count * sizeof(T), alignof(T)));
+            }
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T* pointer, size_t){
+            if(mArena == nullptr){
+                ::operator delete(pointer);
+            }
+        }
+
+        LinearArena* arena() const noexcept{
+            return mArena;
+        }
+
+    private:
+        LinearArena* mArena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+    return a.arena() != b.arena();
+}
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,189 @@
+#include "Bindless.hpp"
+
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+void BindlessTable::init(VkDevice device,
+                         VkPhysicalDevice physicalDevice,
+                         uint32_t maxTextures,
+                         uint32_t maxMaterials){
+    mDevice         = device;
+    mMaxMaterials   = maxMaterials;
+
+    // Clamp the array to what the device allows for update-after-bind sets.
+    // Combined image samplers count against both the sampler and image limits.
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &properties12;
+
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+    mMaxTextures = std::min({maxTextures,
+                             properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                             properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+                             properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                             properties12.maxDescriptorSetUpdateAfterBindSamplers});
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding             = 0;
+    bindings[0].descriptorType      = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount     = 1;
+    bindings[0].stageFlags          = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Variable count has to be the last binding
+    bindings[1].binding             = 1;
+    bindings[1].descriptorType      = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount     = mMaxTextures;
+    bindings[1].stageFlags          = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount   = 2;
+    bindingFlagsInfo.pBindingFlags  = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext        = &bindingFlagsInfo;
+    layoutInfo.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create bindless descriptor set layout");
+    }
+    mSignature = setLayoutSignature(layoutInfo);
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount    = 1;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount    = mMaxTextures;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets        = 1;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+
+    if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create bindless descriptor pool");
+    }
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+    variableCountInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    variableCountInfo.descriptorSetCount    = 1;
+    variableCountInfo.pDescriptorCounts     = &mMaxTextures;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext                 = &variableCountInfo;
+    allocInfo.descriptorPool        = mPool;
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &mLayout;
+
+    if(vkAllocateDescriptorSets(mDevice, &allocInfo, &mSet) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate bindless descriptor set");
+    }
+
+    // Materials are small and written from the CPU, keep them host visible and mapped
+    VkDeviceSize materialBytes = sizeof(Material) * mMaxMaterials;
+
+    createBuffer(mDevice, physicalDevice, materialBytes,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 mMaterialBuffer, mMaterialMemory);
+
+    vkMapMemory(mDevice, mMaterialMemory, 0, materialBytes, 0, reinterpret_cast<void**>(&mMaterials));
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer   = mMaterialBuffer;
+    bufferInfo.offset   = 0;
+    bufferInfo.range    = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet            = mSet;
+    write.dstBinding        = 0;
+    write.descriptorCount   = 1;
+    write.descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo       = &bufferInfo;
+
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+}
+
+void BindlessTable::cleanup(){
+    vkUnmapMemory(mDevice, mMaterialMemory);
+    vkDestroyBuffer(mDevice, mMaterialBuffer, nullptr);
+    vkFreeMemory(mDevice, mMaterialMemory, nullptr);
+
+    vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mLayout, nullptr);
+}
+
+uint32_t BindlessTable::registerTexture(const Texture& texture){
+    if(mTextureCount >= mMaxTextures){
+        throw std::runtime_error("bindless texture array is full");
+    }
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler       = texture.sampler;
+    imageInfo.imageView     = texture.view;
+    imageInfo.imageLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // Update-after-bind, so this is fine while earlier frames still use the set
+    VkWriteDescriptorSet write{};
+    write.sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet            = mSet;
+    write.dstBinding        = 1;
+    write.dstArrayElement   = mTextureCount;
+    write.descriptorCount   = 1;
+    write.descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo        = &imageInfo;
+
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+
+    return mTextureCount++;
+}
+
+uint32_t BindlessTable::addMaterial(const Material& material){
+    if(mMaterialCount >= mMaxMaterials){
+        throw std::runtime_error("bindless material buffer is full");
+    }
+
+    mMaterials[mMaterialCount] = material;
+
+    return mMaterialCount++;
+}
+
+void BindlessTable::updateMaterial(uint32_t index, const Material& material){
+    mMaterials[index] = material;
+}
+
+void BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set) const{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, set, 1, &mSet, 0, nullptr);
+}
+
+VkDescriptorSetLayout BindlessTable::layout() const{
+    return mLayout;
+}
+
+uint64_t BindlessTable::layoutSignature() const{
+    return mSignature;
+}
+
+uint32_t BindlessTable::textureCount() const{
+    return mTextureCount;
+}
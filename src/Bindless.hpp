@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan_core.h>
+
+#include "Texture.hpp"
+
+// std430 layout, must match `Material` in shader/bindless.fs.frag
+struct Material{
+    float       baseColor[4]    = {1.0f, 1.0f, 1.0f, 1.0f};
+    uint32_t    albedoTexture   = 0;
+    uint32_t    _pad[3]         = {0, 0, 0};
+};
+
+// Everything a draw needs to find its resources, pushed per draw
+struct DrawPushConstants{
+    uint32_t    materialIndex   = 0;
+    uint32_t    instanceIndex   = 0;
+};
+
+/**
+ * One descriptor set for the whole frame: binding 0 is the material storage
+ * buffer, binding 1 a large partially bound, update-after-bind array of
+ * combined image samplers. The set is bound once per command buffer and
+ * draws pick textures/materials by index through push constants.
+**/
+
+class BindlessTable{
+    public:
+        void init(VkDevice, VkPhysicalDevice, uint32_t maxTextures, uint32_t maxMaterials);
+        void cleanup();
+
+        // Returns the array slot the shaders use to sample this texture
+        uint32_t registerTexture(const Texture&);
+
+        uint32_t addMaterial(const Material&);
+        void updateMaterial(uint32_t, const Material&);
+
+        void bind(VkCommandBuffer, VkPipelineLayout, uint32_t set = 0) const;
+
+        VkDescriptorSetLayout layout() const;
+        uint64_t layoutSignature() const;      // setLayoutSignature() of layout()
+        uint32_t textureCount() const;
+
+    private:
+        VkDevice                mDevice         = VK_NULL_HANDLE;
+        VkDescriptorSetLayout   mLayout         = VK_NULL_HANDLE;
+        uint64_t                mSignature      = 0;
+        VkDescriptorPool        mPool           = VK_NULL_HANDLE;
+        VkDescriptorSet         mSet            = VK_NULL_HANDLE;
+
+        VkBuffer                mMaterialBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory          mMaterialMemory = VK_NULL_HANDLE;
+        Material*               mMaterials      = nullptr;     // persistently mapped
+
+        uint32_t                mMaxTextures    = 0;
+        uint32_t                mMaxMaterials   = 0;
+        uint32_t                mTextureCount   = 0;
+        uint32_t                mMaterialCount  = 0;
+};
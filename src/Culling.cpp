@@ -0,0 +1,236 @@
+#include "Culling.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define CULL_X86 1
+    #include <immintrin.h>
+#endif
+
+Frustum extractFrustum(const glm::mat4& m){
+    // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;    // left
+    frustum.planes[1] = row3 - row0;    // right
+    frustum.planes[2] = row3 + row1;    // bottom
+    frustum.planes[3] = row3 - row1;    // top
+    frustum.planes[4] = row2;           // near, z >= 0
+    frustum.planes[5] = row3 - row2;    // far
+
+    for(glm::vec4& plane : frustum.planes){
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+// Scalar
+// .............................................................................
+
+static size_t cullScalar(const Frustum& frustum,
+                         const float* x, const float* y, const float* z, const float* radius,
+                         size_t begin, size_t end, uint32_t* visible){
+    size_t count = 0;
+
+    for(size_t i = begin; i < end; i++){
+        bool inside = true;
+
+        for(const glm::vec4& plane : frustum.planes){
+            float distance = plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w;
+            inside &= distance >= -radius[i];
+        }
+
+        // Branch free append
+        visible[count] = static_cast<uint32_t>(i);
+        count += inside;
+    }
+
+    return count;
+}
+
+#ifdef CULL_X86
+
+// Writes the index of every set bit in `mask`, lowest first
+static inline size_t appendMask(uint32_t mask, size_t base, uint32_t* visible){
+    size_t count = 0;
+    while(mask){
+        visible[count++] = static_cast<uint32_t>(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+// SSE, 4 spheres per iteration
+// .............................................................................
+
+static size_t cullSSE(const Frustum& frustum,
+                      const float* x, const float* y, const float* z, const float* radius,
+                      size_t begin, size_t end, uint32_t* visible){
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for(int p = 0; p < 6; p++){
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+
+    for(; i + 4 <= end; i += 4){
+        __m128 cx       = _mm_loadu_ps(x + i);
+        __m128 cy       = _mm_loadu_ps(y + i);
+        __m128 cz       = _mm_loadu_ps(z + i);
+        __m128 negR     = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+        __m128 inside   = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for(int p = 0; p < 6; p++){
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx),
+                                                    _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negR));
+        }
+
+        count += appendMask(_mm_movemask_ps(inside), i, visible + count);
+    }
+
+    return count + cullScalar(frustum, x, y, z, radius, i, end, visible + count);
+}
+
+// AVX2 + FMA, 8 spheres per iteration. Compiled for the target on its own so
+// the rest of the binary keeps running on CPUs without it.
+// .............................................................................
+
+__attribute__((target("avx2,fma")))
+static size_t cullAVX2(const Frustum& frustum,
+                       const float* x, const float* y, const float* z, const float* radius,
+                       size_t begin, size_t end, uint32_t* visible){
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for(int p = 0; p < 6; p++){
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+
+    for(; i + 8 <= end; i += 8){
+        __m256 cx       = _mm256_loadu_ps(x + i);
+        __m256 cy       = _mm256_loadu_ps(y + i);
+        __m256 cz       = _mm256_loadu_ps(z + i);
+        __m256 negR     = _mm256_sub_ps(zero, _mm256_loadu_ps(radius + i));
+        __m256 inside   = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for(int p = 0; p < 6; p++){
+            __m256 distance = _mm256_fmadd_ps(planeX[p], cx,
+                              _mm256_fmadd_ps(planeY[p], cy,
+                              _mm256_fmadd_ps(planeZ[p], cz, planeW[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negR, _CMP_GE_OQ));
+        }
+
+        count += appendMask(_mm256_movemask_ps(inside), i, visible + count);
+    }
+
+    return count + cullScalar(frustum, x, y, z, radius, i, end, visible + count);
+}
+
+#endif
+
+CullPath bestCullPath(){
+#ifdef CULL_X86
+    static const CullPath best = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ?
+                                 CullPath::AVX2 : CullPath::SSE;
+    return best;
+#else
+    return CullPath::Scalar;
+#endif
+}
+
+const char* cullPathName(CullPath path){
+    switch(path){
+        case CullPath::Auto:    return cullPathName(bestCullPath());
+        case CullPath::Scalar:  return "scalar";
+        case CullPath::SSE:     return "sse";
+        case CullPath::AVX2:    return "avx2";
+    }
+    return "unknown";
+}
+
+size_t cullSpheres(const Frustum& frustum,
+                   const float* x, const float* y, const float* z, const float* radius,
+                   size_t begin, size_t end,
+                   uint32_t* visible,
+                   CullPath path){
+    if(path == CullPath::Auto){
+        path = bestCullPath();
+    }
+
+#ifdef CULL_X86
+    if(path == CullPath::AVX2 && bestCullPath() == CullPath::AVX2){
+        return cullAVX2(frustum, x, y, z, radius, begin, end, visible);
+    }
+    if(path != CullPath::Scalar){
+        return cullSSE(frustum, x, y, z, radius, begin, end, visible);
+    }
+#endif
+
+    return cullScalar(frustum, x, y, z, radius, begin, end, visible);
+}
+
+void cullScene(const Scene& scene, const Frustum& frustum, std::vector<uint32_t>& visible,
+               JobSystem* jobs, LinearArena* scratch){
+    const size_t count = scene.size();
+
+    // Every chunk writes its survivors at its own offset, the gaps are closed afterwards
+    visible.resize(count);
+
+    // Not worth spreading small scenes
+    const size_t minChunk = 16384;
+    size_t threads = jobs != nullptr ? jobs->threadCount() : 1;
+    size_t chunks = std::min<size_t>(threads, std::max<size_t>(1, count / minChunk));
+    // Multiple of 8 so only the last chunk has a scalar tail
+    size_t chunkSize = ((count + chunks - 1) / chunks + 7) & ~size_t(7);
+
+    ArenaVector<size_t> chunkCounts(chunks, 0, ArenaAllocator<size_t>(scratch));
+
+    auto cullChunk = [&](size_t c){
+        size_t begin = c * chunkSize;
+        size_t end   = std::min(count, begin + chunkSize);
+        if(begin >= end) return;
+        chunkCounts[c] = cullSpheres(frustum,
+                                     scene.boundsX.data(), scene.boundsY.data(),
+                                     scene.boundsZ.data(), scene.boundsRadius.data(),
+                                     begin, end, visible.data() + begin);
+    };
+
+    if(chunks == 1){
+        cullChunk(0);
+    } else {
+        // One chunk per job, grain 1 over the chunk indices
+        jobs->parallelFor("cull chunk", chunks, 1, [&](size_t begin, size_t end){
+            for(size_t c = begin; c < end; c++){
+                cullChunk(c);
+            }
+        });
+    }
+
+    size_t total = chunkCounts[0];
+    for(size_t c = 1; c < chunks; c++){
+        memmove(visible.data() + total, visible.data() + c * chunkSize, chunkCounts[c] * sizeof(uint32_t));
+        total += chunkCounts[c];
+    }
+
+    visible.resize(total);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Arena.hpp"
+#include "Jobs.hpp"
+#include "Scene.hpp"
+
+// Six normalised planes (xyz normal pointing inwards, w distance)
+struct Frustum{
+    glm::vec4 planes[6];
+};
+
+// Planes of a Vulkan style projection (clip space z in [0, 1])
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+enum class CullPath{
+    Auto,       // widest path the CPU supports
+    Scalar,
+    SSE,        // 4 spheres per test
+    AVX2        // 8 spheres per test
+};
+
+CullPath bestCullPath();
+const char* cullPathName(CullPath);
+
+/**
+ * Tests spheres [begin, end) of the SoA arrays against the frustum and writes
+ * the indices of the ones that intersect it to `visible`, in order.
+ * Returns how many were written.
+**/
+
+size_t cullSpheres(const Frustum&,
+                   const float* x, const float* y, const float* z, const float* radius,
+                   size_t begin, size_t end,
+                   uint32_t* visible,
+                   CullPath = CullPath::Auto);
+
+// Culls every scene node, split over the job system's threads (on the calling
+// thread only without one). `visible` ends up holding the surviving node
+// indices in ascending order. Bookkeeping goes in `scratch` when given.
+void cullScene(const Scene&, const Frustum&, std::vector<uint32_t>& visible,
+               JobSystem* = nullptr, LinearArena* scratch = nullptr);
@@ -0,0 +1,286 @@
+#include "DepthPyramid.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+// Matches PyramidConstants in shader/depth_pyramid.comp
+struct PyramidPushConstants{
+    int32_t     sourceSize[2];
+    int32_t     targetSize[2];
+    int32_t     samples;
+};
+
+// Local size in shader/depth_pyramid.comp
+static const uint32_t GROUP_SIZE = 8;
+
+static uint32_t previousPowerOfTwo(uint32_t value){
+    uint32_t power = 1;
+    while(power * 2 <= value){
+        power *= 2;
+    }
+    return power;
+}
+
+void DepthPyramid::init(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t framesInFlight){
+    mDevice = device;
+    mExtent = {previousPowerOfTwo(std::max(extent.width, 1u)), previousPowerOfTwo(std::max(extent.height, 1u))};
+
+    mLevels = 1;
+    while(mLevels < MAX_LEVELS && (std::max(mExtent.width, mExtent.height) >> mLevels) > 0){
+        mLevels++;
+    }
+
+    // Image
+    // .........................................................................
+
+    createImage(mDevice, physicalDevice, mExtent.width, mExtent.height, mLevels, VK_SAMPLE_COUNT_1_BIT, FORMAT,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                mImage, mMemory);
+
+    mView = createImageView(mDevice, mImage, FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, mLevels);
+
+    // Each level is written through its own view and read by the next through it
+    for(uint32_t i = 0; i < mLevels; i++){
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType              = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image              = mImage;
+        viewInfo.viewType           = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format             = FORMAT;
+        viewInfo.subresourceRange   = {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1};
+
+        if(vkCreateImageView(mDevice, &viewInfo, nullptr, &mLevelViews[i]) != VK_SUCCESS){
+            throw std::runtime_error("failed to create depth pyramid level view");
+        }
+    }
+
+    // Only ever read with texelFetch(), the sampler is for the descriptor type
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType           = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter       = VK_FILTER_NEAREST;
+    samplerInfo.minFilter       = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode      = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod          = static_cast<float>(mLevels);
+
+    if(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler) != VK_SUCCESS){
+        throw std::runtime_error("failed to create depth pyramid sampler");
+    }
+
+    // Descriptors
+    // .........................................................................
+
+    // The level above, or the depth, and the level written
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    for(uint32_t i = 0; i < 2; i++){
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount    = MAX_LEVELS;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount    = MAX_LEVELS;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = MAX_LEVELS;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+
+    mPools.resize(framesInFlight);
+    for(VkDescriptorPool& pool : mPools){
+        if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create depth pyramid descriptor pool");
+        }
+    }
+
+    // Pipelines
+    // .........................................................................
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(PyramidPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &mSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    if(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create depth pyramid pipeline layout");
+    }
+
+    VkPipeline* pipelines[2] = {&mPipeline, &mMultisampled};
+    for(uint32_t i = 0; i < 2; i++){
+        std::vector<std::string> defines;
+        if(i == 1){
+            defines.push_back("MULTISAMPLED");
+        }
+
+        VkShaderModule shaderModule = createShaderModule(mDevice, compileShader("/shader/depth_pyramid.comp", shaderc_compute_shader, defines));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module   = shaderModule;
+        pipelineInfo.stage.pName    = "main";
+        pipelineInfo.layout         = mPipelineLayout;
+
+        if(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, pipelines[i]) != VK_SUCCESS){
+            throw std::runtime_error("failed to create depth pyramid pipeline");
+        }
+
+        vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    }
+}
+
+void DepthPyramid::cleanup(){
+    vkDestroyPipeline(mDevice, mPipeline, nullptr);
+    vkDestroyPipeline(mDevice, mMultisampled, nullptr);
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+
+    for(VkDescriptorPool pool : mPools){
+        vkDestroyDescriptorPool(mDevice, pool, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    vkDestroySampler(mDevice, mSampler, nullptr);
+
+    for(uint32_t i = 0; i < mLevels; i++){
+        vkDestroyImageView(mDevice, mLevelViews[i], nullptr);
+    }
+    vkDestroyImageView(mDevice, mView, nullptr);
+    vkDestroyImage(mDevice, mImage, nullptr);
+    vkFreeMemory(mDevice, mMemory, nullptr);
+}
+
+GraphResource DepthPyramid::addPass(RenderGraph& graph, uint32_t frame,
+                                    GraphResource depth, VkExtent2D renderExtent, VkSampleCountFlagBits samples){
+    mGraph          = &graph;
+    mFrame          = frame;
+    mDepth          = depth;
+    mRenderExtent   = renderExtent;
+    mSamples        = samples;
+
+    // The slot's last frame is done with its sets
+    vkResetDescriptorPool(mDevice, mPools[frame], 0);
+
+    // The last frame's readers were compute; they're left sampling it
+    GraphImportedImage imported{};
+    imported.image          = mImage;
+    imported.view           = mView;
+    imported.format         = FORMAT;
+    imported.extent         = mExtent;
+    imported.mipLevels      = mLevels;
+    imported.initialLayout  = mImageLayout;
+    imported.initialStages  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    imported.finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    GraphResource pyramid = graph.importImage("depth pyramid", imported);
+
+    mImageLayout = imported.finalLayout;
+
+    GraphPass pass = graph.addPass("depth pyramid", [this](VkCommandBuffer commandBuffer){
+        record(commandBuffer);
+    });
+    graph.read(pass, depth, GraphUsage::SampledCompute);
+    graph.write(pass, pyramid, GraphUsage::StorageCompute);
+
+    return pyramid;
+}
+
+void DepthPyramid::record(VkCommandBuffer commandBuffer){
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool        = mPools[mFrame];
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &mSetLayout;
+
+    VkExtent2D source = mRenderExtent;
+
+    for(uint32_t level = 0; level < mLevels; level++){
+        VkExtent2D target = {std::max(mExtent.width >> level, 1u), std::max(mExtent.height >> level, 1u)};
+
+        VkDescriptorSet set;
+        if(vkAllocateDescriptorSets(mDevice, &allocInfo, &set) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate depth pyramid descriptor set");
+        }
+
+        // The whole image is in GENERAL for the pass, the depth is sampled
+        VkDescriptorImageInfo imageInfos[2]{};
+        imageInfos[0] = level == 0 ?
+                        VkDescriptorImageInfo{mSampler, mGraph->sampledView(mDepth), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL} :
+                        VkDescriptorImageInfo{mSampler, mLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+        imageInfos[1] = {VK_NULL_HANDLE, mLevelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+
+        VkWriteDescriptorSet writes[2]{};
+        for(uint32_t i = 0; i < 2; i++){
+            writes[i].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet            = set;
+            writes[i].dstBinding        = i;
+            writes[i].descriptorCount   = 1;
+            writes[i].descriptorType    = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo        = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(mDevice, 2, writes, 0, nullptr);
+
+        PyramidPushConstants constants{};
+        constants.sourceSize[0] = static_cast<int32_t>(source.width);
+        constants.sourceSize[1] = static_cast<int32_t>(source.height);
+        constants.targetSize[0] = static_cast<int32_t>(target.width);
+        constants.targetSize[1] = static_cast<int32_t>(target.height);
+        constants.samples       = level == 0 ? static_cast<int32_t>(mSamples) : 1;
+
+        bool multisampled = level == 0 && mSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? mMultisampled : mPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidPushConstants), &constants);
+
+        vkCmdDispatch(commandBuffer,
+                      (target.width + GROUP_SIZE - 1) / GROUP_SIZE,
+                      (target.height + GROUP_SIZE - 1) / GROUP_SIZE,
+                      1);
+
+        // The next level reads this one
+        if(level + 1 < mLevels){
+            VkMemoryBarrier barrier{};
+            barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        source = target;
+    }
+}
+
+VkImageView DepthPyramid::view() const{
+    return mView;
+}
+
+VkSampler DepthPyramid::sampler() const{
+    return mSampler;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "RenderGraph.hpp"
+
+/**
+ * Hierarchical depth for occlusion culling: a mip chain where every texel
+ * holds the farthest depth under it, so a test against any texel of any
+ * level is conservative. Depth runs from 0 near to 1 far here, the reduction
+ * keeps the maximum.
+ *
+ * Level 0 is the largest power of two within the full extent and covers the
+ * top left render extent of the depth. Each of its texels takes every depth
+ * texel and sample it overlaps, so a render extent that doesn't halve evenly
+ * still leaves nothing out; every level after halves the one above.
+ *
+ * Built in one render graph pass, "depth pyramid", a dispatch per level with
+ * a barrier in between. The image lives outside the graph and is shared by
+ * the frames in flight, the graph orders each frame's build after the last
+ * frame's readers.
+**/
+
+class DepthPyramid{
+    public:
+        static constexpr VkFormat FORMAT = VK_FORMAT_R32_SFLOAT;
+        static constexpr uint32_t MAX_LEVELS = 16;
+
+        // For depth up to `extent`
+        void init(VkDevice, VkPhysicalDevice, VkExtent2D extent, uint32_t framesInFlight);
+        void cleanup();
+
+        // Adds the pass building the pyramid from `depth`, with the scene in
+        // its top left `renderExtent`, and returns the pyramid for readers as
+        // GraphUsage::SampledCompute. Between RenderGraph::begin() and
+        // compile(), once the frame's slot is free.
+        GraphResource addPass(RenderGraph&, uint32_t frame,
+                              GraphResource depth, VkExtent2D renderExtent, VkSampleCountFlagBits samples);
+
+        // All levels, for a sampler2D read with texelFetch()
+        VkImageView view() const;
+        VkSampler sampler() const;
+
+    private:
+        void record(VkCommandBuffer);
+
+        VkDevice                        mDevice         = VK_NULL_HANDLE;
+        VkExtent2D                      mExtent         = {0, 0};   // level 0
+        uint32_t                        mLevels         = 0;
+
+        VkImage                         mImage          = VK_NULL_HANDLE;
+        VkDeviceMemory                  mMemory         = VK_NULL_HANDLE;
+        VkImageView                     mView           = VK_NULL_HANDLE;
+        VkImageView                     mLevelViews[MAX_LEVELS]{};
+        VkImageLayout                   mImageLayout    = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkSampler                       mSampler        = VK_NULL_HANDLE;
+        VkDescriptorSetLayout           mSetLayout      = VK_NULL_HANDLE;
+        VkPipelineLayout                mPipelineLayout = VK_NULL_HANDLE;
+        VkPipeline                      mPipeline       = VK_NULL_HANDLE;
+        VkPipeline                      mMultisampled   = VK_NULL_HANDLE;   // level 0 from multisampled depth
+        std::vector<VkDescriptorPool>   mPools;         // per frame in flight
+
+        // This frame's
+        RenderGraph*                    mGraph          = nullptr;
+        uint32_t                        mFrame          = 0;
+        GraphResource                   mDepth          = INVALID_GRAPH_RESOURCE;
+        VkExtent2D                      mRenderExtent   = {0, 0};
+        VkSampleCountFlagBits           mSamples        = VK_SAMPLE_COUNT_1_BIT;
+};
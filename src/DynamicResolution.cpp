@@ -0,0 +1,36 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::update(double frameTime, double scaledTime){
+    if(++mSinceChange < settings.interval || frameTime <= 0.0 || scaledTime <= 0.0){
+        return;
+    }
+
+    // What the passes that scale may take; when the fixed part alone blows
+    // the target they get a sliver and the scale goes to the minimum
+    double fixedTime    = std::max(frameTime - scaledTime, 0.0);
+    double scaledBudget = std::max(settings.targetTime - fixedTime, scaledTime * 0.01);
+
+    float ideal = static_cast<float>(mScale * std::sqrt(scaledBudget / scaledTime));
+    ideal = std::clamp(ideal, settings.minScale, settings.maxScale);
+
+    // Close enough, the difference is noise
+    if(std::abs(ideal - mScale) < settings.deadband){
+        return;
+    }
+
+    // The last stretch in one go, so the limits are reached and not crept up on
+    float next = mScale + (ideal - mScale) * settings.rate;
+    if(std::abs(ideal - next) < settings.deadband){
+        next = ideal;
+    }
+
+    mScale          = next;
+    mSinceChange    = 0;
+}
+
+float DynamicResolution::scale() const{
+    return std::clamp(mScale, settings.minScale, settings.maxScale);
+}
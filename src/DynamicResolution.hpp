@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+struct DynamicResolutionSettings{
+    double      targetTime  = 14.0;     // GPU milliseconds a frame, some room under the refresh interval
+    float       minScale    = 0.5f;     // of the output's width and height
+    float       maxScale    = 1.0f;     // at most 1, the post chain only upscales
+    float       rate        = 0.25f;    // part of the way to the ideal scale taken per update
+    float       deadband    = 0.02f;    // smaller changes are ignored
+    uint32_t    interval    = 4;        // frames between updates, more than the frames in flight
+};
+
+/**
+ * Picks the fraction of the output resolution the scene renders at so the
+ * GPU holds a target frame time. Only part of a frame follows the pixel
+ * count: given how long those passes took at the current scale, the rest of
+ * the frame is taken as fixed, and the ideal scale is the one whose scaled
+ * passes fit in what the fixed part leaves of the target,
+ *
+ *      ideal = scale * sqrt((target - fixed) / scaled)
+ *
+ * Timings arrive frames in flight late, so updates are `interval` frames
+ * apart, which lets the frames measured catch up with the last change; each
+ * update moves only part of the way and skips tiny steps, so noise doesn't
+ * make the resolution hunt.
+**/
+
+class DynamicResolution{
+    public:
+        // Once a frame, with the GPU time of the latest measured frame and of
+        // its passes whose cost scales with resolution
+        void update(double frameTime, double scaledTime);
+
+        float scale() const;
+
+        DynamicResolutionSettings settings;
+
+    private:
+        float       mScale          = 1.0f;
+        uint32_t    mSinceChange    = 0;
+};
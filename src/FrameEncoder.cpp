@@ -0,0 +1,427 @@
+#include "FrameEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "Mesh.hpp"
+
+static uint8_t unorm8(float value){
+    // NaN fails every comparison, std::clamp would pass it through
+    if(!(value > 0.0f)){
+        return 0;
+    }
+    return static_cast<uint8_t>(std::min(value, 1.0f) * 255.0f + 0.5f);
+}
+
+static void putBigEndian(uint8_t* out, uint32_t value){
+    out[0] = uint8_t(value >> 24);
+    out[1] = uint8_t(value >> 16);
+    out[2] = uint8_t(value >> 8);
+    out[3] = uint8_t(value);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc){
+    static const auto table = [](){
+        std::vector<uint32_t> entries(256);
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++){
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++){
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size){
+    uint32_t a = 1, b = 0;
+    for(size_t i = 0; i < size; i++){
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void writeChunk(std::FILE* file, const char* type, const uint8_t* data, uint32_t size){
+    uint8_t header[8];
+    putBigEndian(header, size);
+    std::memcpy(header + 4, type, 4);
+
+    uint8_t crc[4];
+    putBigEndian(crc, crc32(data, size, crc32(header + 4, 4, 0)));
+
+    std::fwrite(header, 1, sizeof(header), file);
+    if(size > 0){
+        std::fwrite(data, 1, size, file);
+    }
+    std::fwrite(crc, 1, sizeof(crc), file);
+}
+
+bool FrameEncoder::supported(VkFormat format){
+    // convertRow() takes everything there is a readback for
+    return FrameReadback::supported(format);
+}
+
+void FrameEncoder::init(VkExtent2D extent, VkFormat format){
+    if(!supported(format)){
+        throw std::runtime_error("failed to create frame encoder, unsupported format");
+    }
+
+    mExtent     = extent;
+    mFormat     = format;
+    mFrameBytes = extent.width * extent.height * FrameReadback::texelSize(format);
+    mStats      = {};
+    mError      = nullptr;
+
+    if(settings.output == EncoderOutput::Raw || settings.output == EncoderOutput::Y4M){
+        if(settings.path == "-"){
+            // The frames get stdout to themselves: the stream writes to a
+            // copy of it and stdout goes to stderr, so the profile, the
+            // validation layers or the driver printing can't land in the video
+            int descriptor = dup(STDOUT_FILENO);
+            mStream = descriptor != -1 ? fdopen(descriptor, "wb") : nullptr;
+            if(mStream == nullptr || dup2(STDERR_FILENO, STDOUT_FILENO) == -1){
+                throw std::runtime_error("failed to take over stdout for encoder output");
+            }
+        } else {
+            mStream = std::fopen(settings.path.c_str(), "wb");
+        }
+
+        if(mStream == nullptr){
+            throw std::runtime_error("failed to open encoder output " + settings.path);
+        }
+    }
+
+    if(settings.output == EncoderOutput::Y4M){
+        std::fprintf(mStream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", extent.width, extent.height, settings.fps);
+    }
+
+    mRow.resize(size_t(extent.width) * 3);
+    if(settings.output == EncoderOutput::Y4M){
+        mPlanes.resize(size_t(extent.width) * extent.height * 3);
+    } else if(settings.output == EncoderOutput::PNG){
+        mPlanes.resize((size_t(extent.width) * 3 + 1) * extent.height);
+    }
+
+    // Everything the encoder will ever hold, allocated here
+    uint32_t depth = std::max(settings.queueDepth, 1u);
+    mBuffers.resize(depth);
+    for(uint32_t i = 0; i < depth; i++){
+        mBuffers[i].pixels.resize(mFrameBytes);
+        mFree.push_back(i);
+    }
+
+    mRunning = true;
+    mThread = std::thread(&FrameEncoder::ioLoop, this);
+}
+
+void FrameEncoder::cleanup(){
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mQueueWake.notify_all();
+
+    if(mThread.joinable()){
+        mThread.join();
+    }
+
+    if(mStream != nullptr){
+        // Buffered frames only get written here. With "-" this closes the
+        // last copy of stdout, and the process at the other end sees the end;
+        // stdout stays on stderr so nothing trails the video.
+        if(std::fclose(mStream) != 0 && !mError){
+            mError = std::make_exception_ptr(std::runtime_error("failed to write encoder output " + settings.path));
+        }
+        mStream = nullptr;
+    }
+
+    mBuffers.clear();
+    mFree.clear();
+    mQueued.clear();
+
+    // Nothing pushed after the I/O thread failed, or it failed closing
+    if(mError){
+        std::exception_ptr error = mError;
+        mError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void FrameEncoder::push(const ReadbackFrame& frame){
+    if(frame.extent.width != mExtent.width || frame.extent.height != mExtent.height || frame.format != mFormat){
+        throw std::runtime_error("failed to encode frame, extent or format changed");
+    }
+
+    uint32_t buffer;
+
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if(mFree.empty() && !mError){
+            mStats.stalls++;
+            mFreeWake.wait(lock, [this](){ return !mFree.empty() || mError; });
+        }
+
+        if(mError){
+            std::rethrow_exception(mError);
+        }
+
+        buffer = mFree.back();
+        mFree.pop_back();
+    }
+
+    // The buffer is the render thread's alone until queued
+    uint32_t rowBytes = mExtent.width * FrameReadback::texelSize(mFormat);
+    uint8_t* pixels = mBuffers[buffer].pixels.data();
+    for(uint32_t y = 0; y < mExtent.height; y++){
+        std::memcpy(pixels + size_t(y) * rowBytes, frame.pixels + size_t(y) * frame.rowPitch, rowBytes);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBuffers[buffer].index = mStats.pushed++;
+        mQueued.push_back(buffer);
+    }
+    mQueueWake.notify_one();
+}
+
+bool FrameEncoder::done() const{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return settings.frames != 0 && mStats.pushed >= settings.frames;
+}
+
+FrameEncoder::Stats FrameEncoder::stats() const{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void FrameEncoder::ioLoop(){
+    while(true){
+        uint32_t buffer;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQueueWake.wait(lock, [this](){ return !mQueued.empty() || !mRunning; });
+
+            // Stopping only once everything pushed is written
+            if(mQueued.empty()){
+                return;
+            }
+
+            buffer = mQueued.front();
+            mQueued.pop_front();
+        }
+
+        try{
+            write(mBuffers[buffer]);
+        } catch(...){
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mError = std::current_exception();
+            }
+            mFreeWake.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFree.push_back(buffer);
+            mStats.written++;
+        }
+        mFreeWake.notify_one();
+    }
+}
+
+void FrameEncoder::write(const Buffer& buffer){
+    uint32_t rowBytes = mExtent.width * FrameReadback::texelSize(mFormat);
+
+    switch(settings.output){
+        case EncoderOutput::Raw:
+            for(uint32_t y = 0; y < mExtent.height; y++){
+                convertRow(buffer.pixels.data() + size_t(y) * rowBytes, mRow.data());
+                std::fwrite(mRow.data(), 1, mRow.size(), mStream);
+            }
+            break;
+
+        case EncoderOutput::Y4M:
+            writeY4M(buffer);
+            break;
+
+        case EncoderOutput::PPM:
+        case EncoderOutput::PNG:{
+            bool png = settings.output == EncoderOutput::PNG;
+            std::string path = framePath(buffer.index, png ? "png" : "ppm");
+
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if(file == nullptr){
+                throw std::runtime_error("failed to open encoder output " + path);
+            }
+
+            if(png){
+                writePNG(file, buffer);
+            } else {
+                std::fprintf(file, "P6\n%u %u\n255\n", mExtent.width, mExtent.height);
+                for(uint32_t y = 0; y < mExtent.height; y++){
+                    convertRow(buffer.pixels.data() + size_t(y) * rowBytes, mRow.data());
+                    std::fwrite(mRow.data(), 1, mRow.size(), file);
+                }
+            }
+
+            bool failed = std::ferror(file) != 0;
+            if(std::fclose(file) != 0 || failed){
+                throw std::runtime_error("failed to write " + path);
+            }
+            return;
+        }
+    }
+
+    // A pipe whose reader went away ends up here too
+    if(std::ferror(mStream)){
+        throw std::runtime_error("failed to write encoder output " + settings.path);
+    }
+}
+
+void FrameEncoder::writeY4M(const Buffer& buffer){
+    uint32_t rowBytes   = mExtent.width * FrameReadback::texelSize(mFormat);
+    size_t planeSize    = size_t(mExtent.width) * mExtent.height;
+
+    uint8_t* luma   = mPlanes.data();
+    uint8_t* blue   = luma + planeSize;
+    uint8_t* red    = blue + planeSize;
+
+    for(uint32_t y = 0; y < mExtent.height; y++){
+        convertRow(buffer.pixels.data() + size_t(y) * rowBytes, mRow.data());
+
+        for(uint32_t x = 0; x < mExtent.width; x++){
+            int r = mRow[x * 3 + 0];
+            int g = mRow[x * 3 + 1];
+            int b = mRow[x * 3 + 2];
+
+            size_t i = size_t(y) * mExtent.width + x;
+            luma[i] = uint8_t((( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16);
+            blue[i] = uint8_t(((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128);
+            red[i]  = uint8_t(((112 * r -  94 * g -  18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    std::fputs("FRAME\n", mStream);
+    std::fwrite(mPlanes.data(), 1, mPlanes.size(), mStream);
+}
+
+void FrameEncoder::writePNG(std::FILE* file, const Buffer& buffer){
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    uint32_t rowBytes   = mExtent.width * FrameReadback::texelSize(mFormat);
+    size_t scanline     = size_t(mExtent.width) * 3 + 1;
+
+    // Scanlines with filter type 0, none
+    for(uint32_t y = 0; y < mExtent.height; y++){
+        uint8_t* line = mPlanes.data() + y * scanline;
+        line[0] = 0;
+        convertRow(buffer.pixels.data() + size_t(y) * rowBytes, line + 1);
+    }
+
+    // A zlib stream of stored deflate blocks. Compressing would cost the I/O
+    // thread more than the disk saves; recompress offline where size matters.
+    mDeflate.clear();
+    mDeflate.push_back(0x78);
+    mDeflate.push_back(0x01);
+
+    for(size_t offset = 0; offset < mPlanes.size(); offset += 65535){
+        size_t length = std::min<size_t>(65535, mPlanes.size() - offset);
+        bool last = offset + length == mPlanes.size();
+
+        mDeflate.push_back(last ? 1 : 0);
+        mDeflate.push_back(uint8_t(length));
+        mDeflate.push_back(uint8_t(length >> 8));
+        mDeflate.push_back(uint8_t(~length));
+        mDeflate.push_back(uint8_t(~length >> 8));
+        mDeflate.insert(mDeflate.end(), mPlanes.begin() + offset, mPlanes.begin() + offset + length);
+    }
+
+    uint8_t checksum[4];
+    putBigEndian(checksum, adler32(mPlanes.data(), mPlanes.size()));
+    mDeflate.insert(mDeflate.end(), checksum, checksum + 4);
+
+    // 8 bit RGB, no interlacing
+    uint8_t header[13] = {};
+    putBigEndian(header, mExtent.width);
+    putBigEndian(header + 4, mExtent.height);
+    header[8] = 8;
+    header[9] = 2;
+
+    std::fwrite(signature, 1, sizeof(signature), file);
+    writeChunk(file, "IHDR", header, sizeof(header));
+    writeChunk(file, "IDAT", mDeflate.data(), static_cast<uint32_t>(mDeflate.size()));
+    writeChunk(file, "IEND", nullptr, 0);
+}
+
+// One row as read back to 8 bit RGB. sRGB formats keep their encoding,
+// half floats are clamped to [0, 1] and written as they are.
+void FrameEncoder::convertRow(const uint8_t* source, uint8_t* rgb) const{
+    for(uint32_t x = 0; x < mExtent.width; x++, rgb += 3){
+        switch(mFormat){
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+            case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+                rgb[0] = source[x * 4 + 0];
+                rgb[1] = source[x * 4 + 1];
+                rgb[2] = source[x * 4 + 2];
+                break;
+
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+                rgb[0] = source[x * 4 + 2];
+                rgb[1] = source[x * 4 + 1];
+                rgb[2] = source[x * 4 + 0];
+                break;
+
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_A2R10G10B10_UNORM_PACK32:{
+                uint32_t texel;
+                std::memcpy(&texel, source + x * 4, sizeof(texel));
+
+                uint8_t low     = uint8_t((texel >> 2) & 0xFF);
+                uint8_t middle  = uint8_t((texel >> 12) & 0xFF);
+                uint8_t high    = uint8_t((texel >> 22) & 0xFF);
+
+                bool redLow = mFormat == VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+                rgb[0] = redLow ? low : high;
+                rgb[1] = middle;
+                rgb[2] = redLow ? high : low;
+                break;
+            }
+
+            case VK_FORMAT_R16G16B16A16_SFLOAT:{
+                uint16_t texel[4];
+                std::memcpy(texel, source + x * 8, sizeof(texel));
+
+                rgb[0] = unorm8(halfToFloat(texel[0]));
+                rgb[1] = unorm8(halfToFloat(texel[1]));
+                rgb[2] = unorm8(halfToFloat(texel[2]));
+                break;
+            }
+
+            default:
+                rgb[0] = rgb[1] = rgb[2] = 0;
+                break;
+        }
+    }
+}
+
+std::string FrameEncoder::framePath(uint64_t index, const char* extension) const{
+    char number[32];
+    std::snprintf(number, sizeof(number), "%06llu.", static_cast<unsigned long long>(index));
+    return settings.path + number + extension;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "Readback.hpp"
+
+enum class EncoderOutput : uint8_t{
+    Raw,        // rgb24 frames back to back, for ffmpeg -f rawvideo
+    Y4M,        // YUV4MPEG2, 4:4:4 BT.601 studio range
+    PPM,        // a numbered binary PPM per frame
+    PNG         // a numbered PNG per frame, stored without compression
+};
+
+struct EncoderSettings{
+    EncoderOutput   output      = EncoderOutput::Y4M;
+
+    // Raw and Y4M: a file or named pipe, "-" for stdout. PPM and PNG: the
+    // start of every file name, "frames/f" gives frames/f000000.png and on.
+    std::string     path        = "-";
+
+    // Frames copied out and not yet written; the render thread waits for
+    // the I/O thread beyond that
+    uint32_t        queueDepth  = 8;
+
+    uint32_t        fps         = 60;   // Y4M header only
+    uint64_t        frames      = 0;    // done after this many, 0 never is
+};
+
+/**
+ * Streams frames read back from the GPU to disk or a pipe from its own I/O
+ * thread. push() copies a frame into one of queueDepth buffers allocated up
+ * front and returns; the I/O thread converts and writes them in order. With
+ * every buffer queued push() waits for one to come free, so a renderer
+ * outrunning the disk or the process at the other end of the pipe slows to
+ * its pace instead of growing memory.
+ *
+ *      encoder.settings.output = EncoderOutput::Raw;
+ *      encoder.init(extent, format);
+ *      ...
+ *      encoder.push(captured);     // from FrameReadback::acquire()
+ *      ...
+ *      encoder.cleanup();          // writes out what's left
+ *
+ * An error writing ends the I/O thread; the next push() rethrows it, or
+ * cleanup() when there is none. Streaming to "-" points the process' stdout
+ * at stderr for good, everything else printed goes there.
+**/
+
+class FrameEncoder{
+    public:
+        struct Stats{
+            uint64_t    pushed  = 0;
+            uint64_t    written = 0;
+            uint64_t    stalls  = 0;    // pushes that waited for a free buffer
+        };
+
+        EncoderSettings settings;
+
+        // Whether frames in `format` can be converted
+        static bool supported(VkFormat);
+
+        // Opens the output and starts the I/O thread, for frames of `extent`
+        // in `format`
+        void init(VkExtent2D extent, VkFormat format);
+        void cleanup();
+
+        // Render thread only
+        void push(const ReadbackFrame&);
+
+        // settings.frames have been pushed
+        bool done() const;
+
+        Stats stats() const;
+
+    private:
+        struct Buffer{
+            std::vector<uint8_t>    pixels;     // as read back
+            uint64_t                index   = 0;
+        };
+
+        void ioLoop();
+        void write(const Buffer&);
+        void writeY4M(const Buffer&);
+        void writePNG(std::FILE*, const Buffer&);
+        void convertRow(const uint8_t* source, uint8_t* rgb) const;
+        std::string framePath(uint64_t index, const char* extension) const;
+
+        VkExtent2D                  mExtent     = {0, 0};
+        VkFormat                    mFormat     = VK_FORMAT_UNDEFINED;
+        uint32_t                    mFrameBytes = 0;
+        std::FILE*                  mStream     = nullptr;  // Raw and Y4M
+
+        // I/O thread's scratch
+        std::vector<uint8_t>        mRow;
+        std::vector<uint8_t>        mPlanes;        // Y4M planes, PNG scanlines
+        std::vector<uint8_t>        mDeflate;       // PNG image data
+
+        // Guards everything below; a buffer is in exactly one of the lists
+        // or with one of the threads
+        mutable std::mutex          mMutex;
+        std::vector<Buffer>         mBuffers;
+        std::vector<uint32_t>       mFree;
+        std::deque<uint32_t>        mQueued;
+        std::condition_variable     mQueueWake;     // something queued, or stopping
+        std::condition_variable     mFreeWake;      // a buffer came free
+        std::exception_ptr          mError;
+        Stats                       mStats;
+        bool                        mRunning    = false;
+
+        std::thread                 mThread;
+};
@@ -0,0 +1,211 @@
+#include "GpuProfiler.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+// Weight of the newest frame in the moving averages
+static const double AVERAGE_WEIGHT = 0.1;
+
+static double smooth(double average, double value){
+    return average == 0.0 ? value : average + (value - average) * AVERAGE_WEIGHT;
+}
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                       uint32_t framesInFlight, uint32_t maxScopes){
+    mDevice     = device;
+    mMaxScopes  = maxScopes;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+    if(validBits == 0 || properties.limits.timestampPeriod == 0.0f){
+        return;
+    }
+
+    mPeriod     = properties.limits.timestampPeriod / 1e6;
+    mValidMask  = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = firstQuery(framesInFlight);
+
+    if(vkCreateQueryPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create timestamp query pool");
+    }
+
+    mFrames.resize(framesInFlight);
+    for(FrameQueries& frame : mFrames){
+        frame.names.resize(maxScopes);
+    }
+    mResults.resize(firstQuery(1));
+}
+
+void GpuProfiler::cleanup(){
+    if(mPool != VK_NULL_HANDLE){
+        vkDestroyQueryPool(mDevice, mPool, nullptr);
+        mPool = VK_NULL_HANDLE;
+    }
+}
+
+bool GpuProfiler::supported() const{
+    return mPool != VK_NULL_HANDLE;
+}
+
+// Frame start and end, then a begin and end per scope
+uint32_t GpuProfiler::firstQuery(uint32_t frame) const{
+    return frame * (2 + mMaxScopes * 2);
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame){
+    if(!supported()) return;
+
+    mFrame = frame;
+    FrameQueries& queries = mFrames[frame];
+
+    if(queries.recorded){
+        collect(queries);
+    }
+
+    queries.count       = 0;
+    queries.recorded    = false;
+
+    vkCmdResetQueryPool(commandBuffer, mPool, firstQuery(frame), firstQuery(1));
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool, firstQuery(frame));
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer){
+    if(!supported()) return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool, firstQuery(mFrame) + 1);
+    mFrames[mFrame].recorded = true;
+}
+
+uint32_t GpuProfiler::begin(VkCommandBuffer commandBuffer, const char* name){
+    if(!supported()) return UINT32_MAX;
+
+    FrameQueries& queries = mFrames[mFrame];
+    if(queries.count == mMaxScopes){
+        return UINT32_MAX;
+    }
+
+    uint32_t scope = queries.count++;
+    queries.names[scope] = name;
+
+    // Bottom of pipe: written once all earlier commands are done
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool, firstQuery(mFrame) + 2 + scope * 2);
+    return scope;
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t scope){
+    if(scope == UINT32_MAX) return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool, firstQuery(mFrame) + 3 + scope * 2);
+}
+
+void GpuProfiler::collect(FrameQueries& queries){
+    uint32_t first = static_cast<uint32_t>(&queries - mFrames.data());
+    uint32_t count = 2 + queries.count * 2;
+
+    // The submission is complete, so this doesn't wait
+    if(vkGetQueryPoolResults(mDevice, mPool, firstQuery(first), count, count * sizeof(uint64_t),
+                             mResults.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS){
+        return;
+    }
+
+    for(GpuTiming& timing : mTimings){
+        timing.count    = 0;
+        timing.last     = 0.0;
+    }
+
+    mScopeTime = 0.0;
+
+    for(uint32_t i = 0; i < queries.count; i++){
+        uint64_t ticks = (mResults[3 + i * 2] - mResults[2 + i * 2]) & mValidMask;
+
+        GpuTiming& timing = find(queries.names[i]);
+        timing.count++;
+        timing.last += ticks * mPeriod;
+        mScopeTime  += ticks * mPeriod;
+    }
+
+    for(GpuTiming& timing : mTimings){
+        timing.average = smooth(timing.average, timing.last);
+    }
+
+    mFrameTime      = ((mResults[1] - mResults[0]) & mValidMask) * mPeriod;
+    mAverageFrame   = smooth(mAverageFrame, mFrameTime);
+}
+
+GpuTiming& GpuProfiler::find(const char* name){
+    for(GpuTiming& timing : mTimings){
+        if(timing.name == name || strcmp(timing.name, name) == 0){
+            return timing;
+        }
+    }
+
+    // Only the first time a name shows up
+    GpuTiming timing;
+    timing.name = name;
+    mTimings.push_back(timing);
+    return mTimings.back();
+}
+
+void GpuProfiler::setBudget(const char* name, double milliseconds){
+    find(name).budget = milliseconds;
+}
+
+double GpuProfiler::frameTime() const{
+    return mFrameTime;
+}
+
+double GpuProfiler::averageFrameTime() const{
+    return mAverageFrame;
+}
+
+double GpuProfiler::scopeTime() const{
+    return mScopeTime;
+}
+
+const GpuTiming* GpuProfiler::timing(const char* name) const{
+    for(const GpuTiming& timing : mTimings){
+        if(timing.name == name || strcmp(timing.name, name) == 0){
+            return &timing;
+        }
+    }
+    return nullptr;
+}
+
+const std::vector<GpuTiming>& GpuProfiler::timings() const{
+    return mTimings;
+}
+
+void GpuProfiler::print(FILE* f) const{
+    if(!supported()) return;
+
+    fprintf(f, "gpu frame %.3f ms (%.3f ms average)\n", mFrameTime, mAverageFrame);
+    for(const GpuTiming& timing : mTimings){
+        fprintf(f, "  %-24s %8.3f ms average, %8.3f ms last, %4u scopes", timing.name, timing.average, timing.last, timing.count);
+        if(timing.budget > 0.0){
+            fprintf(f, ", budget %.3f ms%s", timing.budget, timing.average > timing.budget ? " OVER" : "");
+        }
+        fprintf(f, "\n");
+    }
+}
+
+GpuScope::GpuScope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const char* name)
+    : mProfiler(profiler),
+      mCommandBuffer(commandBuffer),
+      mScope(profiler ? profiler->begin(commandBuffer, name) : UINT32_MAX){}
+
+GpuScope::~GpuScope(){
+    if(mProfiler){
+        mProfiler->end(mCommandBuffer, mScope);
+    }
+}
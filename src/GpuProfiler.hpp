@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// GPU time of everything recorded under one name in a frame
+struct GpuTiming{
+    const char* name    = nullptr;     // static string, scopes are grouped by it
+    uint32_t    count   = 0;           // scopes in the last measured frame
+    double      last    = 0.0;         // milliseconds, summed over the scopes
+    double      average = 0.0;         // moving average of `last`
+    double      budget  = 0.0;         // 0 = none
+};
+
+/**
+ * GPU side frame profiler on timestamp queries. Each frame in flight has its
+ * own range of queries; beginFrame() reads back what the slot's previous
+ * frame measured, which has completed by the time the slot is reused, so
+ * nothing ever waits on the GPU. Times are a frame in flight old.
+ *
+ * A scope's time runs from when everything recorded before it finished to
+ * when it finished itself, so passes that overlap don't count twice and
+ * barriers count toward the pass after them.
+ *
+ * Names can carry a budget; print() flags names whose average goes over.
+ * Without timestamp support on the queue every call does nothing.
+**/
+
+class GpuProfiler{
+    public:
+        void init(VkDevice, VkPhysicalDevice, uint32_t queueFamily, uint32_t framesInFlight, uint32_t maxScopes = 64);
+        void cleanup();
+
+        bool supported() const;
+
+        // First and last thing in a frame's command buffer. The frame slot's
+        // last submission has to be complete.
+        void beginFrame(VkCommandBuffer, uint32_t frame);
+        void endFrame(VkCommandBuffer);
+
+        // UINT32_MAX once the frame is out of scopes
+        uint32_t begin(VkCommandBuffer, const char* name);
+        void end(VkCommandBuffer, uint32_t scope);
+
+        void setBudget(const char* name, double milliseconds);
+
+        // Of the last measured frame, first timestamp to last
+        double frameTime() const;
+        double averageFrameTime() const;
+
+        // Of the last measured frame, all scopes together: the frame time
+        // without what lies outside of them, like waiting on the swapchain
+        // before the first
+        double scopeTime() const;
+
+        const GpuTiming* timing(const char* name) const;
+        const std::vector<GpuTiming>& timings() const;
+        void print(FILE*) const;
+
+    private:
+        struct FrameQueries{
+            std::vector<const char*>    names;          // of each scope, maxScopes long
+            uint32_t                    count       = 0;
+            bool                        recorded    = false;
+        };
+
+        GpuTiming& find(const char* name);
+        void collect(FrameQueries&);
+        uint32_t firstQuery(uint32_t frame) const;
+
+        VkDevice                    mDevice         = VK_NULL_HANDLE;
+        VkQueryPool                 mPool           = VK_NULL_HANDLE;
+        double                      mPeriod         = 0.0;      // milliseconds per tick
+        uint64_t                    mValidMask      = 0;
+        uint32_t                    mMaxScopes      = 0;
+
+        std::vector<FrameQueries>   mFrames;
+        uint32_t                    mFrame          = 0;
+        std::vector<uint64_t>       mResults;
+
+        std::vector<GpuTiming>      mTimings;
+        double                      mFrameTime      = 0.0;
+        double                      mAverageFrame   = 0.0;
+        double                      mScopeTime      = 0.0;
+};
+
+// Times the commands recorded in the enclosing scope. `profiler` may be null.
+class GpuScope{
+    public:
+        GpuScope(GpuProfiler* profiler, VkCommandBuffer, const char* name);
+        ~GpuScope();
+
+        GpuScope(const GpuScope&) = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+
+    private:
+        GpuProfiler*        mProfiler;
+        VkCommandBuffer     mCommandBuffer;
+        uint32_t            mScope;
+};
@@ -0,0 +1,162 @@
+#include "Input.hpp"
+
+#include <GLFW/glfw3.h>
+
+// GLFW callbacks, all on the main thread
+// .............................................................................
+
+static void pushEvent(GLFWwindow* window, InputEvent event){
+    InputQueue* queue = static_cast<InputQueue*>(glfwGetWindowUserPointer(window));
+    if(queue == nullptr) return;
+
+    event.time = ProfileClock::now();
+    queue->push(event);
+}
+
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods){
+    InputEvent event;
+    event.type      = InputEventType::Key;
+    event.code      = key;
+    event.action    = action;
+    event.mods      = mods;
+    pushEvent(window, event);
+}
+
+static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods){
+    InputEvent event;
+    event.type      = InputEventType::MouseButton;
+    event.code      = button;
+    event.action    = action;
+    event.mods      = mods;
+    pushEvent(window, event);
+}
+
+static void cursorPositionCallback(GLFWwindow* window, double x, double y){
+    InputEvent event;
+    event.type      = InputEventType::CursorPosition;
+    event.x         = x;
+    event.y         = y;
+    pushEvent(window, event);
+}
+
+static void scrollCallback(GLFWwindow* window, double x, double y){
+    InputEvent event;
+    event.type      = InputEventType::Scroll;
+    event.x         = x;
+    event.y         = y;
+    pushEvent(window, event);
+}
+
+static void framebufferSizeCallback(GLFWwindow* window, int width, int height){
+    InputEvent event;
+    event.type      = InputEventType::FramebufferSize;
+    event.x         = width;
+    event.y         = height;
+    pushEvent(window, event);
+}
+
+static void closeCallback(GLFWwindow* window){
+    InputQueue* queue = static_cast<InputQueue*>(glfwGetWindowUserPointer(window));
+    if(queue == nullptr) return;
+
+    queue->requestClose();
+}
+
+// Input queue
+// .............................................................................
+
+void InputQueue::attach(GLFWwindow* window){
+    glfwSetWindowUserPointer(window, this);
+
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetCursorPosCallback(window, cursorPositionCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwSetWindowCloseCallback(window, closeCallback);
+}
+
+void InputQueue::push(const InputEvent& event){
+    if(!mEvents.push(event)){
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool InputQueue::pop(InputEvent& event){
+    return mEvents.pop(event);
+}
+
+uint64_t InputQueue::dropped() const{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+void InputQueue::requestClose(){
+    mCloseRequested.store(true, std::memory_order_relaxed);
+}
+
+bool InputQueue::closeRequested() const{
+    return mCloseRequested.load(std::memory_order_relaxed);
+}
+
+// Input state
+// .............................................................................
+
+void InputState::beginSample(){
+    cursorDeltaX    = 0.0;
+    cursorDeltaY    = 0.0;
+    scrollX         = 0.0;
+    scrollY         = 0.0;
+    eventCount      = 0;
+}
+
+void InputState::apply(const InputEvent& event){
+    if(eventCount == 0){
+        oldestEvent = event.time;
+    }
+    newestEvent = event.time;
+    eventCount++;
+
+    switch(event.type){
+        case InputEventType::Key:
+            // GLFW_KEY_UNKNOWN is -1, repeats don't change anything
+            if(event.code >= 0 && event.code < INPUT_MAX_KEYS && event.action != GLFW_REPEAT){
+                mKeys[event.code] = event.action == GLFW_PRESS;
+            }
+            break;
+
+        case InputEventType::MouseButton:
+            if(event.code >= 0 && event.code < INPUT_MAX_BUTTONS){
+                mButtons[event.code] = event.action == GLFW_PRESS;
+            }
+            break;
+
+        case InputEventType::CursorPosition:
+            // The first position isn't a movement
+            if(mHaveCursor){
+                cursorDeltaX += event.x - cursorX;
+                cursorDeltaY += event.y - cursorY;
+            }
+            cursorX     = event.x;
+            cursorY     = event.y;
+            mHaveCursor = true;
+            break;
+
+        case InputEventType::Scroll:
+            scrollX += event.x;
+            scrollY += event.y;
+            break;
+
+        case InputEventType::FramebufferSize:
+            width   = static_cast<int>(event.x);
+            height  = static_cast<int>(event.y);
+            break;
+    }
+}
+
+bool InputState::keyDown(int key) const{
+    return key >= 0 && key < INPUT_MAX_KEYS && mKeys[key];
+}
+
+bool InputState::buttonDown(int button) const{
+    return button >= 0 && button < INPUT_MAX_BUTTONS && mButtons[button];
+}
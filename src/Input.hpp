@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Profiler.hpp"
+
+struct GLFWwindow;
+
+const int INPUT_MAX_KEYS    = 512;     // above GLFW_KEY_LAST
+const int INPUT_MAX_BUTTONS = 8;       // GLFW_MOUSE_BUTTON_LAST + 1
+
+enum class InputEventType : uint8_t{
+    Key,
+    MouseButton,
+    CursorPosition,
+    Scroll,
+    FramebufferSize
+};
+
+// One GLFW callback, stamped when the main thread received it
+struct InputEvent{
+    InputEventType              type    = InputEventType::Key;
+    int32_t                     code    = 0;       // key or mouse button
+    int32_t                     action  = 0;       // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int32_t                     mods    = 0;
+    double                      x       = 0.0;     // cursor position, scroll offset or framebuffer size
+    double                      y       = 0.0;
+    ProfileClock::time_point    time;
+};
+
+/**
+ * Bounded lock free queue for exactly one producer and one consumer thread.
+ * Each side owns one index and only reads the other's, so a push or pop is
+ * a couple of atomic loads and one release store. Capacity has to be a
+ * power of two; one slot is kept free to tell full from empty.
+**/
+
+template<typename T, size_t Capacity>
+class SpscQueue{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity has to be a power of two");
+
+    public:
+        // Producer only, false when full
+        bool push(const T& value){
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            size_t next = (tail + 1) & (Capacity - 1);
+            if(next == mHead.load(std::memory_order_acquire)){
+                return false;
+            }
+
+            mItems[tail] = value;
+            mTail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only, false when empty
+        bool pop(T& value){
+            size_t head = mHead.load(std::memory_order_relaxed);
+            if(head == mTail.load(std::memory_order_acquire)){
+                return false;
+            }
+
+            value = mItems[head];
+            mHead.store((head + 1) & (Capacity - 1), std::memory_order_release);
+            return true;
+        }
+
+    private:
+        // Indices on their own cache lines so the two threads don't share one
+        alignas(64) std::atomic<size_t> mHead{0};
+        alignas(64) std::atomic<size_t> mTail{0};
+        std::array<T, Capacity>         mItems;
+};
+
+/**
+ * Events from the GLFW callbacks on the main thread to the render thread.
+ * Nothing blocks the main thread: when the render thread falls a full queue
+ * behind, new events are dropped and counted. Closing the window isn't an
+ * event but a flag that stays set, so a stalled render thread flooded with
+ * cursor movement still sees it.
+**/
+
+class InputQueue{
+    public:
+        // Routes the window's key, mouse, scroll, size and close callbacks here
+        void attach(GLFWwindow*);
+
+        void push(const InputEvent&);
+        bool pop(InputEvent&);
+
+        uint64_t dropped() const;
+
+        void requestClose();
+        bool closeRequested() const;
+
+    private:
+        SpscQueue<InputEvent, 1024>     mEvents;
+        std::atomic<uint64_t>           mDropped{0};
+        std::atomic<bool>               mCloseRequested{false};
+};
+
+/**
+ * Input as the render thread sees it, built by replaying events in order.
+ * A sample is everything drained at once; deltas cover only the last sample
+ * and the event times say how stale the oldest input in it is.
+**/
+
+class InputState{
+    public:
+        // Clears the per sample deltas
+        void beginSample();
+        void apply(const InputEvent&);
+
+        bool keyDown(int key) const;
+        bool buttonDown(int button) const;
+
+        bool                        closeRequested  = false;   // from InputQueue, once set stays
+
+        double                      cursorX         = 0.0;
+        double                      cursorY         = 0.0;
+        int                         width           = 0;       // framebuffer size
+        int                         height          = 0;
+
+        // This sample only
+        double                      cursorDeltaX    = 0.0;
+        double                      cursorDeltaY    = 0.0;
+        double                      scrollX         = 0.0;
+        double                      scrollY         = 0.0;
+        uint32_t                    eventCount      = 0;
+        ProfileClock::time_point    oldestEvent;
+        ProfileClock::time_point    newestEvent;
+
+    private:
+        std::array<bool, INPUT_MAX_KEYS>    mKeys{};
+        std::array<bool, INPUT_MAX_BUTTONS> mButtons{};
+        bool                                mHaveCursor = false;
+};
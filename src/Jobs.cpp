@@ -0,0 +1,255 @@
+#include "Jobs.hpp"
+
+#include <algorithm>
+
+static thread_local uint32_t tThreadIndex = 0;
+
+JobSystem::JobSystem(unsigned workers, CpuProfiler* profiler) :
+    mProfiler(profiler)
+{
+    if(workers == 0){
+        workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    for(unsigned i = 0; i < workers + 1; i++){
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+
+    for(unsigned i = 0; i < workers; i++){
+        mThreads.emplace_back(&JobSystem::workerLoop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem(){
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mRunning = false;
+    }
+    mWake.notify_all();
+
+    for(std::thread& thread : mThreads){
+        thread.join();
+    }
+}
+
+void JobSystem::run(const char* name, JobFunction function, JobCounter* counter){
+    if(counter != nullptr){
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t index = std::min<uint32_t>(threadIndex(), static_cast<uint32_t>(mQueues.size() - 1));
+
+    {
+        std::lock_guard<std::mutex> lock(mQueues[index]->mutex);
+        mQueues[index]->pushBack(Job{std::move(function), name, counter});
+    }
+
+    // Taking the sleep mutex orders this against a worker checking the
+    // predicate and going to sleep, so the wake up can't get lost
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mQueued.fetch_add(1, std::memory_order_release);
+    }
+    mWake.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter){
+    uint32_t index = std::min<uint32_t>(threadIndex(), static_cast<uint32_t>(mQueues.size() - 1));
+
+    while(counter.value.load(std::memory_order_acquire) != 0){
+        if(!tryRunOne(index)){
+            // What's left is running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+unsigned JobSystem::threadCount() const{
+    return static_cast<unsigned>(mQueues.size());
+}
+
+uint32_t JobSystem::threadIndex(){
+    return tThreadIndex;
+}
+
+CpuProfiler* JobSystem::profiler() const{
+    return mProfiler;
+}
+
+void JobSystem::workerLoop(uint32_t index){
+    tThreadIndex = index;
+
+    while(true){
+        if(tryRunOne(index)){
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWake.wait(lock, [this](){
+            return !mRunning || mQueued.load(std::memory_order_acquire) != 0;
+        });
+
+        if(!mRunning){
+            return;
+        }
+    }
+}
+
+bool JobSystem::pop(uint32_t index, Job& job){
+    // Own queue from the back
+    {
+        Queue& queue = *mQueues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.popBack(job)){
+            return true;
+        }
+    }
+
+    // Steal from the front, starting at the neighbour so thieves spread out
+    for(size_t i = 1; i < mQueues.size(); i++){
+        Queue& queue = *mQueues[(index + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.popFront(job)){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobSystem::tryRunOne(uint32_t index){
+    if(mQueued.load(std::memory_order_acquire) == 0){
+        return false;
+    }
+
+    Job job;
+    if(!pop(index, job)){
+        return false;
+    }
+
+    mQueued.fetch_sub(1, std::memory_order_acq_rel);
+    execute(job, index);
+    return true;
+}
+
+void JobSystem::execute(Job& job, uint32_t index){
+    ProfileClock::time_point start = ProfileClock::now();
+
+    job.function();
+
+    if(mProfiler != nullptr){
+        mProfiler->record(job.name, index, start, ProfileClock::now());
+    }
+
+    // Last, the waiter may destroy the counter as soon as it sees zero
+    if(job.counter != nullptr){
+        job.counter->value.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::Queue::pushBack(Job&& job){
+    if(count == jobs.size()){
+        // Unrolled so the ring starts at 0 again
+        std::vector<Job> grown(jobs.size() * 2);
+        for(size_t i = 0; i < count; i++){
+            grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+        }
+        jobs.swap(grown);
+        head = 0;
+    }
+
+    jobs[(head + count) % jobs.size()] = std::move(job);
+    count++;
+}
+
+bool JobSystem::Queue::popBack(Job& job){
+    if(count == 0){
+        return false;
+    }
+
+    count--;
+    job = std::move(jobs[(head + count) % jobs.size()]);
+    return true;
+}
+
+bool JobSystem::Queue::popFront(Job& job){
+    if(count == 0){
+        return false;
+    }
+
+    job = std::move(jobs[head]);
+    head = (head + 1) % jobs.size();
+    count--;
+    return true;
+}
+
+// Task graph
+// .............................................................................
+
+TaskGraph::TaskId TaskGraph::add(const char* name, JobFunction function){
+    Task task;
+    task.name       = name;
+    task.function   = std::move(function);
+    mTasks.push_back(std::move(task));
+
+    return static_cast<TaskId>(mTasks.size() - 1);
+}
+
+void TaskGraph::depend(TaskId task, TaskId dependency){
+    mTasks[dependency].successors.push_back(task);
+    mTasks[task].dependencies++;
+}
+
+void TaskGraph::run(JobSystem& jobs){
+    if(mTasks.empty()){
+        return;
+    }
+
+    if(mRemainingSize != mTasks.size()){
+        mRemaining      = std::make_unique<std::atomic<uint32_t>[]>(mTasks.size());
+        mRemainingSize  = mTasks.size();
+    }
+
+    for(size_t i = 0; i < mTasks.size(); i++){
+        mRemaining[i].store(mTasks[i].dependencies, std::memory_order_relaxed);
+    }
+
+    JobCounter counter;
+    mJobs       = &jobs;
+    mCounter    = &counter;
+
+    for(TaskId id = 0; id < mTasks.size(); id++){
+        if(mTasks[id].dependencies == 0){
+            schedule(id);
+        }
+    }
+
+    jobs.wait(counter);
+
+    mJobs       = nullptr;
+    mCounter    = nullptr;
+}
+
+void TaskGraph::schedule(TaskId id){
+    mJobs->run(mTasks[id].name, [this, id](){
+        mTasks[id].function();
+
+        // Successors are queued before this job's count drops, so the
+        // counter can't touch zero while the graph still has work
+        for(TaskId successor : mTasks[id].successors){
+            if(mRemaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1){
+                schedule(successor);
+            }
+        }
+    }, mCounter);
+}
+
+void TaskGraph::clear(){
+    mTasks.clear();
+    mRemaining.reset();
+    mRemainingSize = 0;
+}
+
+size_t TaskGraph::size() const{
+    return mTasks.size();
+}
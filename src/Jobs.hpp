@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Profiler.hpp"
+
+using JobFunction = std::function<void()>;
+
+// Outstanding jobs of a batch. Waiting on it runs other jobs instead of
+// blocking, so jobs can wait on jobs they spawned without deadlocking.
+struct JobCounter{
+    std::atomic<uint32_t> value{0};
+};
+
+/**
+ * Work stealing scheduler. Every thread (workers plus the thread that made
+ * the system, index 0) owns a deque: it pushes and pops its own jobs at the
+ * back, most recent first while their data is still in cache, and steals
+ * from the front of the others when it runs dry. Idle workers sleep on a
+ * condition variable until something is queued.
+ *
+ * Jobs are timed and reported to the profiler under their name. Queues keep
+ * their storage and the jobs made here are small enough for std::function to
+ * hold inline, so a warmed up frame schedules without touching the heap.
+**/
+
+class JobSystem{
+    public:
+        // 0 workers = one per core besides the calling thread
+        explicit JobSystem(unsigned workers = 0, CpuProfiler* = nullptr);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // `name` has to outlive the frame, it is kept by the profiler
+        void run(const char* name, JobFunction, JobCounter* = nullptr);
+
+        // Helps with queued jobs until the counter reaches zero
+        void wait(JobCounter&);
+
+        // Calls `body(begin, end)` over [0, count) in chunks of at least
+        // `grain`, on every thread including the caller, and returns when done
+        template<typename Body>
+        void parallelFor(const char* name, size_t count, size_t grain, Body&& body);
+
+        // Workers plus the owning thread
+        unsigned threadCount() const;
+
+        // Index of the calling thread, 0 for the owning thread and any thread
+        // the system doesn't know
+        static uint32_t threadIndex();
+
+        CpuProfiler* profiler() const;
+
+    private:
+        struct Job{
+            JobFunction     function;
+            const char*     name    = nullptr;
+            JobCounter*     counter = nullptr;
+        };
+
+        // Ring that doubles when full. A deque allocates and frees blocks as
+        // its ends move through them, which here would be every frame.
+        struct Queue{
+            std::mutex          mutex;
+            std::vector<Job>    jobs    = std::vector<Job>(64);
+            size_t              head    = 0;
+            size_t              count   = 0;
+
+            void pushBack(Job&&);
+            bool popBack(Job&);
+            bool popFront(Job&);
+        };
+
+        void workerLoop(uint32_t);
+        bool pop(uint32_t, Job&);
+        bool tryRunOne(uint32_t);
+        void execute(Job&, uint32_t);
+
+        std::vector<std::unique_ptr<Queue>> mQueues;
+        std::vector<std::thread>            mThreads;
+        CpuProfiler*                        mProfiler   = nullptr;
+
+        std::atomic<bool>                   mRunning{true};
+        std::atomic<uint32_t>               mQueued{0};
+        std::mutex                          mSleepMutex;
+        std::condition_variable             mWake;
+};
+
+template<typename Body>
+void JobSystem::parallelFor(const char* name, size_t count, size_t grain, Body&& body){
+    if(count == 0){
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+
+    // A few chunks per thread so stealing can even out uneven chunks
+    size_t chunks = std::min<size_t>((count + grain - 1) / grain, size_t(threadCount()) * 4);
+    size_t chunkSize = (count + chunks - 1) / chunks;
+
+    // Jobs get a pointer to this and their chunk index, nothing that would
+    // make std::function allocate
+    struct Range{
+        std::remove_reference_t<Body>*  body;
+        size_t                          count;
+        size_t                          chunkSize;
+    } range{&body, count, chunkSize};
+
+    JobCounter counter;
+    for(size_t c = 1; c < chunks; c++){
+        if(c * chunkSize >= count) break;
+
+        run(name, [&range, c](){
+            size_t begin = c * range.chunkSize;
+            (*range.body)(begin, std::min(range.count, begin + range.chunkSize));
+        }, &counter);
+    }
+
+    {
+        ProfileScope scope(mProfiler, name, threadIndex());
+        body(0, std::min(count, chunkSize));
+    }
+
+    wait(counter);
+}
+
+/**
+ * Static dependency graph run on a JobSystem. A task becomes a job once every
+ * task it depends on has finished; the last predecessor to finish schedules
+ * it as a continuation on its own thread, so nothing ever blocks on a task.
+ * A graph can be run again once run() has returned.
+**/
+
+class TaskGraph{
+    public:
+        using TaskId = uint32_t;
+
+        TaskId add(const char* name, JobFunction);
+
+        // `task` starts after `dependency` is done
+        void depend(TaskId task, TaskId dependency);
+
+        // Returns once every task has run, the caller helps in the meantime
+        void run(JobSystem&);
+
+        void clear();
+        size_t size() const;
+
+    private:
+        struct Task{
+            const char*             name = nullptr;
+            JobFunction             function;
+            std::vector<TaskId>     successors;
+            uint32_t                dependencies = 0;
+        };
+
+        void schedule(TaskId);
+
+        std::vector<Task>                           mTasks;
+
+        // While running. Scheduled jobs reach these through the graph so
+        // they stay small enough not to allocate.
+        std::unique_ptr<std::atomic<uint32_t>[]>    mRemaining;     // per task
+        size_t                                      mRemainingSize  = 0;
+        JobSystem*                                  mJobs           = nullptr;
+        JobCounter*                                 mCounter        = nullptr;
+};
@@ -0,0 +1,257 @@
+#include "Lighting.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+// Local size of shader/light_cull.comp, one cluster per invocation
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+Light pointLight(const glm::vec3& position, float range, const glm::vec3& color){
+    Light light;
+    light.position  = position;
+    light.range     = range;
+    light.color     = color;
+    return light;
+}
+
+Light spotLight(const glm::vec3& position, const glm::vec3& direction, float range, const glm::vec3& color,
+                float innerAngle, float outerAngle){
+    // Light culling's cone test takes cones no wider than a half space
+    float cosOuter = std::cos(std::min(outerAngle, 1.57f));
+    float cosInner = std::max(std::cos(innerAngle), cosOuter + 1e-4f);
+
+    // saturate(cos * scale + offset) is 0 at the outer angle and 1 at the inner
+    Light light;
+    light.position      = position;
+    light.range         = range;
+    light.color         = color;
+    light.direction     = glm::normalize(direction);
+    light.spotScale     = 1.0f / (cosInner - cosOuter);
+    light.spotOffset    = -cosOuter * light.spotScale;
+    return light;
+}
+
+void ClusteredLighting::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, uint32_t maxLights){
+    mDevice     = device;
+    mMaxLights  = maxLights;
+
+    // Descriptors
+    // .........................................................................
+
+    // 0 params, 1 lights, 2 cluster light counts, 3 cluster light indices
+    VkDescriptorSetLayoutBinding bindings[4]{};
+    for(uint32_t i = 0; i < 4; i++){
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create light descriptor set layout");
+    }
+    mSignature = setLayoutSignature(layoutInfo);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount    = 4 * framesInFlight;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = framesInFlight;
+    poolInfo.poolSizeCount  = 1;
+    poolInfo.pPoolSizes     = &poolSize;
+
+    if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create light descriptor pool");
+    }
+
+    // Buffers
+    // .........................................................................
+
+    mFrames.resize(framesInFlight);
+    for(Frame& frame : mFrames){
+        createBuffer(mDevice, physicalDevice, sizeof(ClusterParams),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     frame.params, frame.paramsMemory);
+
+        vkMapMemory(mDevice, frame.paramsMemory, 0, sizeof(ClusterParams), 0, reinterpret_cast<void**>(&frame.mappedParams));
+
+        // At least one, empty storage buffers aren't allowed
+        VkDeviceSize lightBytes = VkDeviceSize(std::max(mMaxLights, 1u)) * sizeof(Light);
+
+        createBuffer(mDevice, physicalDevice, lightBytes,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     frame.lights, frame.lightsMemory);
+
+        vkMapMemory(mDevice, frame.lightsMemory, 0, lightBytes, 0, reinterpret_cast<void**>(&frame.mappedLights));
+
+        createBuffer(mDevice, physicalDevice, VkDeviceSize(CLUSTER_COUNT) * sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     frame.clusters, frame.clustersMemory);
+
+        createBuffer(mDevice, physicalDevice, VkDeviceSize(CLUSTER_COUNT) * MAX_CLUSTER_LIGHTS * sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     frame.indices, frame.indicesMemory);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool        = mPool;
+        allocInfo.descriptorSetCount    = 1;
+        allocInfo.pSetLayouts           = &mSetLayout;
+
+        if(vkAllocateDescriptorSets(mDevice, &allocInfo, &frame.set) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate light descriptor set");
+        }
+
+        VkBuffer buffers[4] = {frame.params, frame.lights, frame.clusters, frame.indices};
+
+        VkDescriptorBufferInfo bufferInfos[4]{};
+        VkWriteDescriptorSet writes[4]{};
+        for(uint32_t i = 0; i < 4; i++){
+            bufferInfos[i].buffer   = buffers[i];
+            bufferInfos[i].offset   = 0;
+            bufferInfos[i].range    = VK_WHOLE_SIZE;
+
+            writes[i].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet            = frame.set;
+            writes[i].dstBinding        = i;
+            writes[i].descriptorCount   = 1;
+            writes[i].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo       = &bufferInfos[i];
+        }
+
+        vkUpdateDescriptorSets(mDevice, 4, writes, 0, nullptr);
+    }
+
+    // Pipeline
+    // .........................................................................
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType            = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount   = 1;
+    pipelineLayoutInfo.pSetLayouts      = &mSetLayout;
+
+    if(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mCullLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create light cull pipeline layout");
+    }
+
+    VkShaderModule cullShaderModule = createShaderModule(mDevice, compileShader("/shader/light_cull.comp", shaderc_compute_shader));
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module   = cullShaderModule;
+    pipelineInfo.stage.pName    = "main";
+    pipelineInfo.layout         = mCullLayout;
+
+    if(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mCullPipeline) != VK_SUCCESS){
+        throw std::runtime_error("failed to create light cull pipeline");
+    }
+
+    vkDestroyShaderModule(mDevice, cullShaderModule, nullptr);
+}
+
+void ClusteredLighting::cleanup(){
+    vkDestroyPipeline(mDevice, mCullPipeline, nullptr);
+    vkDestroyPipelineLayout(mDevice, mCullLayout, nullptr);
+
+    for(Frame& frame : mFrames){
+        vkUnmapMemory(mDevice, frame.paramsMemory);
+        vkDestroyBuffer(mDevice, frame.params, nullptr);
+        vkFreeMemory(mDevice, frame.paramsMemory, nullptr);
+        vkUnmapMemory(mDevice, frame.lightsMemory);
+        vkDestroyBuffer(mDevice, frame.lights, nullptr);
+        vkFreeMemory(mDevice, frame.lightsMemory, nullptr);
+        vkDestroyBuffer(mDevice, frame.clusters, nullptr);
+        vkFreeMemory(mDevice, frame.clustersMemory, nullptr);
+        vkDestroyBuffer(mDevice, frame.indices, nullptr);
+        vkFreeMemory(mDevice, frame.indicesMemory, nullptr);
+    }
+    mFrames.clear();
+
+    vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+}
+
+void ClusteredLighting::prepare(uint32_t frame,
+                                const Light* lights,
+                                size_t count,
+                                const glm::mat4& view,
+                                const glm::mat4& projection,
+                                VkExtent2D renderExtent){
+    mFrame      = frame;
+    mLightCount = static_cast<uint32_t>(std::min<size_t>(count, mMaxLights));
+
+    Frame& current = mFrames[frame];
+    memcpy(current.mappedLights, lights, mLightCount * sizeof(Light));
+
+    // Clip z = [2][2] * z + [3][2] and clip w = -z, so view depth at ndc 0 and 1
+    float nearPlane = projection[3][2] / projection[2][2];
+    float farPlane  = projection[3][2] / (projection[2][2] + 1.0f);
+    float logRatio  = std::log(farPlane / nearPlane);
+
+    ClusterParams params{};
+    params.view         = view;
+    params.eye          = glm::inverse(view)[3];
+    params.projection   = glm::vec4(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+    params.tileScale    = glm::vec2(float(CLUSTERS_X) / std::max(renderExtent.width, 1u),
+                                    float(CLUSTERS_Y) / std::max(renderExtent.height, 1u));
+    params.sliceScale   = CLUSTERS_Z / logRatio;
+    params.sliceBias    = -CLUSTERS_Z * std::log(nearPlane) / logRatio;
+    params.nearPlane    = nearPlane;
+    params.farPlane     = farPlane;
+    params.lightCount   = mLightCount;
+
+    *current.mappedParams = params;
+}
+
+void ClusteredLighting::recordCull(VkCommandBuffer commandBuffer) const{
+    const Frame& current = mFrames[mFrame];
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullLayout, 0, 1, &current.set, 0, nullptr);
+    vkCmdDispatch(commandBuffer, (CLUSTER_COUNT + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void ClusteredLighting::bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t set) const{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1, &mFrames[mFrame].set, 0, nullptr);
+}
+
+VkDescriptorSetLayout ClusteredLighting::layout() const{
+    return mSetLayout;
+}
+
+uint64_t ClusteredLighting::layoutSignature() const{
+    return mSignature;
+}
+
+VkBuffer ClusteredLighting::clusterBuffer() const{
+    return mFrames[mFrame].clusters;
+}
+
+VkBuffer ClusteredLighting::indexBuffer() const{
+    return mFrames[mFrame].indices;
+}
+
+uint32_t ClusteredLighting::maxLights() const{
+    return mMaxLights;
+}
+
+uint32_t ClusteredLighting::lightCount() const{
+    return mLightCount;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+// A point or spot light in world space. std430, must match `Light` in
+// shader/lighting_common.glsl
+struct Light{
+    glm::vec3   position    = glm::vec3(0.0f);
+    float       range       = 1.0f;                         // nothing past it
+    glm::vec3   color       = glm::vec3(1.0f);              // times intensity
+    float       spotScale   = 0.0f;                         // cone falloff, 0 for point lights
+    glm::vec3   direction   = glm::vec3(0.0f, 0.0f, -1.0f);
+    float       spotOffset  = 1.0f;
+};
+
+Light pointLight(const glm::vec3& position, float range, const glm::vec3& color);
+
+// Full intensity inside `innerAngle` of `direction`, none past `outerAngle`,
+// radians and at most 90 degrees
+Light spotLight(const glm::vec3& position, const glm::vec3& direction, float range, const glm::vec3& color,
+                float innerAngle, float outerAngle);
+
+// What the light culling pass and the fragment shader agree on, the first
+// binding. std430, must match `ClusterParams` in shader/lighting_common.glsl
+struct ClusterParams{
+    glm::mat4   view;
+    glm::vec4   eye;
+    glm::vec4   projection;     // x and y scale, then the depth terms: view depth = w / (ndc z + z)
+    glm::vec2   tileScale;      // clusters per pixel of the render area
+    float       sliceScale;     // slice = log(view depth) * scale + bias
+    float       sliceBias;
+    float       nearPlane;
+    float       farPlane;
+    uint32_t    lightCount;
+    uint32_t    _pad;
+};
+
+/**
+ * Clustered forward lighting. The view frustum is cut into a grid of froxels,
+ * 16x9 tiles over the render area and 24 depth slices spaced exponentially
+ * between the near and far plane, so they stay roughly cube shaped. Each frame
+ * shader/light_cull.comp tests every light against every cluster's view
+ * space box (and the cone of spot lights against its bounding sphere) and
+ * writes the indices of the ones that touch it; lights are loaded a workgroup
+ * at a time through shared memory. The fragment shader finds its cluster from
+ * its pixel and depth and only loops over that list, so shading cost follows
+ * the lights around a pixel, not how many the scene has.
+ *
+ * Every cluster has a fixed run of MAX_CLUSTER_LIGHTS slots, so no counters
+ * or compaction; lights past that are dropped from the cluster. Each frame in
+ * flight has its own lights, grid and descriptor set, so the culling pass of
+ * one frame never waits on the shading of the one before.
+ *
+ * The near and far plane come from the projection, which has to be a
+ * symmetric perspective one with depth in [0, 1].
+**/
+
+class ClusteredLighting{
+    public:
+        static constexpr uint32_t CLUSTERS_X            = 16;
+        static constexpr uint32_t CLUSTERS_Y            = 9;
+        static constexpr uint32_t CLUSTERS_Z            = 24;
+        static constexpr uint32_t CLUSTER_COUNT         = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+        static constexpr uint32_t MAX_CLUSTER_LIGHTS    = 128;
+
+        void init(VkDevice, VkPhysicalDevice, uint32_t framesInFlight, uint32_t maxLights);
+        void cleanup();
+
+        // Lights and camera of the frame in flight `frame`, whose previous
+        // submission the caller has already waited for. At most maxLights()
+        // are taken.
+        void prepare(uint32_t frame, const Light*, size_t count,
+                     const glm::mat4& view, const glm::mat4& projection, VkExtent2D renderExtent);
+
+        // Outside rendering. Writes clusterBuffer() and indexBuffer() of the
+        // prepared frame, which the fragment shader reads.
+        void recordCull(VkCommandBuffer) const;
+
+        // Binds the prepared frame's set for the fragment shader, `set` of `layout`
+        void bind(VkCommandBuffer, VkPipelineLayout, uint32_t set) const;
+
+        VkDescriptorSetLayout layout() const;
+        uint64_t layoutSignature() const;      // setLayoutSignature() of layout()
+        VkBuffer clusterBuffer() const;
+        VkBuffer indexBuffer() const;
+        uint32_t maxLights() const;
+        uint32_t lightCount() const;
+
+    private:
+        struct Frame{
+            VkBuffer            params          = VK_NULL_HANDLE;
+            VkDeviceMemory      paramsMemory    = VK_NULL_HANDLE;
+            ClusterParams*      mappedParams    = nullptr;
+            VkBuffer            lights          = VK_NULL_HANDLE;
+            VkDeviceMemory      lightsMemory    = VK_NULL_HANDLE;
+            Light*              mappedLights    = nullptr;
+            VkBuffer            clusters        = VK_NULL_HANDLE;   // light count of each cluster
+            VkDeviceMemory      clustersMemory  = VK_NULL_HANDLE;
+            VkBuffer            indices         = VK_NULL_HANDLE;   // MAX_CLUSTER_LIGHTS per cluster
+            VkDeviceMemory      indicesMemory   = VK_NULL_HANDLE;
+            VkDescriptorSet     set             = VK_NULL_HANDLE;
+        };
+
+        VkDevice                mDevice         = VK_NULL_HANDLE;
+        VkDescriptorSetLayout   mSetLayout      = VK_NULL_HANDLE;
+        uint64_t                mSignature      = 0;
+        VkDescriptorPool        mPool           = VK_NULL_HANDLE;
+        VkPipelineLayout        mCullLayout     = VK_NULL_HANDLE;
+        VkPipeline              mCullPipeline   = VK_NULL_HANDLE;
+
+        std::vector<Frame>      mFrames;
+        uint32_t                mFrame          = 0;
+        uint32_t                mMaxLights      = 0;
+        uint32_t                mLightCount     = 0;
+};
@@ -0,0 +1,286 @@
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Cooked file
+// .............................................................................
+
+// File layout: header, MeshLod[lodCount], Vertex or PackedVertex[vertexCount], uint32_t[indexCount],
+// Meshlet[meshletCount], uint32_t[meshletVertexCount], uint8_t[meshletTriangleBytes]
+struct CookedMeshHeader{
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    vertexFormat;
+    uint32_t    vertexCount;
+    uint32_t    indexCount;
+    uint32_t    lodCount;
+    float       bounds[4];
+    uint32_t    meshletCount;
+    uint32_t    meshletVertexCount;
+    uint32_t    meshletTriangleBytes;
+};
+
+static const char     COOKED_MESH_MAGIC[4]  = {'V', 'K', 'M', 'S'};
+static const uint32_t COOKED_MESH_VERSION   = 3;
+
+size_t CookedMesh::vertexCount() const{
+    return vertexFormat == VertexFormat::Packed ? packedVertices.size() : vertices.size();
+}
+
+bool writeCookedMesh(const char* path, const CookedMesh& mesh){
+    FILE *f = fopen(path, "wb");
+    if(f == nullptr){
+        return false;
+    }
+
+    CookedMeshHeader header{};
+    memcpy(header.magic, COOKED_MESH_MAGIC, 4);
+    header.version      = COOKED_MESH_VERSION;
+    header.vertexFormat = static_cast<uint32_t>(mesh.vertexFormat);
+    header.vertexCount  = static_cast<uint32_t>(mesh.vertexCount());
+    header.indexCount   = static_cast<uint32_t>(mesh.indices.size());
+    header.lodCount     = static_cast<uint32_t>(mesh.lods.size());
+    memcpy(header.bounds, &mesh.bounds, sizeof(header.bounds));
+    header.meshletCount         = static_cast<uint32_t>(mesh.meshlets.size());
+    header.meshletVertexCount   = static_cast<uint32_t>(mesh.meshletVertices.size());
+    header.meshletTriangleBytes = static_cast<uint32_t>(mesh.meshletTriangles.size());
+
+    bool packed = mesh.vertexFormat == VertexFormat::Packed;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(mesh.lods.data(), sizeof(MeshLod), mesh.lods.size(), f) == mesh.lods.size() &&
+              (packed ?
+                  fwrite(mesh.packedVertices.data(), sizeof(PackedVertex), mesh.packedVertices.size(), f) == mesh.packedVertices.size() :
+                  fwrite(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), f) == mesh.vertices.size()) &&
+              fwrite(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), f) == mesh.indices.size() &&
+              fwrite(mesh.meshlets.data(), sizeof(Meshlet), mesh.meshlets.size(), f) == mesh.meshlets.size() &&
+              fwrite(mesh.meshletVertices.data(), sizeof(uint32_t), mesh.meshletVertices.size(), f) == mesh.meshletVertices.size() &&
+              fwrite(mesh.meshletTriangles.data(), 1, mesh.meshletTriangles.size(), f) == mesh.meshletTriangles.size();
+
+    fclose(f);
+
+    return ok;
+}
+
+bool readCookedMesh(const char* path, CookedMesh& mesh){
+    FILE *f = fopen(path, "rb");
+    if(f == nullptr){
+        return false;
+    }
+
+    CookedMeshHeader header;
+    if(fread(&header, sizeof(header), 1, f) != 1 ||
+       memcmp(header.magic, COOKED_MESH_MAGIC, 4) != 0 ||
+       header.version != COOKED_MESH_VERSION ||
+       header.vertexFormat > static_cast<uint32_t>(VertexFormat::Packed)){
+        fclose(f);
+        return false;
+    }
+
+    mesh.vertexFormat = static_cast<VertexFormat>(header.vertexFormat);
+    bool packed = mesh.vertexFormat == VertexFormat::Packed;
+
+    mesh.lods.resize(header.lodCount);
+    mesh.vertices.resize(packed ? 0 : header.vertexCount);
+    mesh.packedVertices.resize(packed ? header.vertexCount : 0);
+    mesh.indices.resize(header.indexCount);
+    memcpy(&mesh.bounds, header.bounds, sizeof(header.bounds));
+    mesh.meshlets.resize(header.meshletCount);
+    mesh.meshletVertices.resize(header.meshletVertexCount);
+    mesh.meshletTriangles.resize(header.meshletTriangleBytes);
+
+    bool ok = fread(mesh.lods.data(), sizeof(MeshLod), mesh.lods.size(), f) == mesh.lods.size() &&
+              (packed ?
+                  fread(mesh.packedVertices.data(), sizeof(PackedVertex), mesh.packedVertices.size(), f) == mesh.packedVertices.size() :
+                  fread(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), f) == mesh.vertices.size()) &&
+              fread(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), f) == mesh.indices.size() &&
+              fread(mesh.meshlets.data(), sizeof(Meshlet), mesh.meshlets.size(), f) == mesh.meshlets.size() &&
+              fread(mesh.meshletVertices.data(), sizeof(uint32_t), mesh.meshletVertices.size(), f) == mesh.meshletVertices.size() &&
+              fread(mesh.meshletTriangles.data(), 1, mesh.meshletTriangles.size(), f) == mesh.meshletTriangles.size();
+
+    fclose(f);
+
+    return ok;
+}
+
+// Vertex packing
+// .............................................................................
+
+uint16_t floatToHalf(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign       = (bits >> 16) & 0x8000;
+    uint32_t exponent   = (bits >> 23) & 0xff;
+    uint32_t mantissa   = bits & 0x7fffff;
+
+    // Inf and NaN (keeping NaN a NaN)
+    if(exponent == 0xff){
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+
+    if(halfExponent >= 31){
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    // Round to nearest even, a carry out of the mantissa correctly bumps the exponent
+    if(halfExponent <= 0){
+        if(halfExponent < -10){
+            return static_cast<uint16_t>(sign);
+        }
+
+        mantissa |= 0x800000;
+        uint32_t shift      = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half       = mantissa >> shift;
+        uint32_t remainder  = mantissa & ((1u << shift) - 1);
+        uint32_t halfway    = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half       = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder  = mantissa & 0x1fff;
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half){
+    uint32_t sign       = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent   = (half >> 10) & 0x1f;
+    uint32_t mantissa   = half & 0x3ff;
+
+    uint32_t bits;
+    if(exponent == 0x1f){
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if(exponent != 0){
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if(mantissa != 0){
+        // Subnormal, normalise it
+        exponent = 127 - 15 + 1;
+        while(!(mantissa & 0x400)){
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int16_t toSnorm16(float value){
+    return static_cast<int16_t>(std::round(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f));
+}
+
+PackedVertex packVertex(const Vertex& vertex){
+    PackedVertex packed{};
+
+    for(int i = 0; i < 3; i++){
+        packed.position[i] = floatToHalf(vertex.position[i]);
+    }
+    packed.position[3] = floatToHalf(1.0f);
+
+    // Octahedral: project onto |x| + |y| + |z| = 1, fold the lower half over the diagonals
+    glm::vec3 n = vertex.normal;
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    glm::vec2 oct = l1 > 0.0f ? glm::vec2(n.x, n.y) / l1 : glm::vec2(0.0f);
+    if(l1 > 0.0f && n.z < 0.0f){
+        oct = glm::vec2((1.0f - std::fabs(oct.y)) * (oct.x >= 0.0f ? 1.0f : -1.0f),
+                        (1.0f - std::fabs(oct.x)) * (oct.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    packed.normal[0] = toSnorm16(oct.x);
+    packed.normal[1] = toSnorm16(oct.y);
+
+    packed.uv[0] = floatToHalf(vertex.uv.x);
+    packed.uv[1] = floatToHalf(vertex.uv.y);
+
+    return packed;
+}
+
+Vertex unpackVertex(const PackedVertex& packed){
+    Vertex vertex{};
+
+    vertex.position = glm::vec3(halfToFloat(packed.position[0]),
+                                halfToFloat(packed.position[1]),
+                                halfToFloat(packed.position[2]));
+
+    // Same decode as shader/mesh.vs.vert
+    glm::vec3 n(std::max(packed.normal[0] / 32767.0f, -1.0f), std::max(packed.normal[1] / 32767.0f, -1.0f), 0.0f);
+    n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    vertex.normal = glm::length(n) > 0.0f ? glm::normalize(n) : n;
+
+    vertex.uv = glm::vec2(halfToFloat(packed.uv[0]), halfToFloat(packed.uv[1]));
+
+    return vertex;
+}
+
+void convertVertexFormat(CookedMesh& mesh, VertexFormat format){
+    if(mesh.vertexFormat == format){
+        return;
+    }
+
+    if(format == VertexFormat::Packed){
+        mesh.packedVertices.resize(mesh.vertices.size());
+        for(size_t i = 0; i < mesh.vertices.size(); i++){
+            mesh.packedVertices[i] = packVertex(mesh.vertices[i]);
+        }
+        mesh.vertices.clear();
+        mesh.vertices.shrink_to_fit();
+    } else {
+        mesh.vertices.resize(mesh.packedVertices.size());
+        for(size_t i = 0; i < mesh.packedVertices.size(); i++){
+            mesh.vertices[i] = unpackVertex(mesh.packedVertices[i]);
+        }
+        mesh.packedVertices.clear();
+        mesh.packedVertices.shrink_to_fit();
+    }
+
+    mesh.vertexFormat = format;
+}
+
+// LOD selection
+// .............................................................................
+
+uint32_t selectLod(const std::vector<MeshLod>& lods,
+                   float distance,
+                   float projectionScale,
+                   uint32_t currentLod,
+                   float pixelThreshold,
+                   float hysteresis){
+    if(lods.empty()){
+        return 0;
+    }
+
+    // Inside the bounding sphere everything is full detail
+    float pixelsPerUnit = projectionScale / std::max(distance, 1e-4f);
+
+    uint32_t target = 0;
+    for(uint32_t i = 1; i < lods.size(); i++){
+        if(lods[i].error * pixelsPerUnit > pixelThreshold) break;
+        target = i;
+    }
+
+    if(target <= currentLod){
+        // Finer (or same) detail is taken immediately
+        return target;
+    }
+
+    // Coarser only once that level is comfortably below the threshold
+    while(target > currentLod &&
+          lods[target].error * pixelsPerUnit > pixelThreshold * (1.0f - hysteresis)){
+        target--;
+    }
+
+    return target;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Vertex{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+// 16 bytes instead of 32: half float position (w unused), octahedral normal
+// in two snorm16 and half float UVs so tiling coordinates past 1 still work
+struct PackedVertex{
+    uint16_t    position[4];
+    int16_t     normal[2];
+    uint16_t    uv[2];
+};
+
+enum class VertexFormat : uint32_t{
+    Float   = 0,    // Vertex
+    Packed  = 1     // PackedVertex
+};
+
+// One level of detail: a range of the shared index buffer. `error` is the
+// object space distance the simplified surface may deviate from the original.
+struct MeshLod{
+    uint32_t    indexOffset = 0;
+    uint32_t    indexCount  = 0;
+    float       error       = 0.0f;
+};
+
+/**
+ * Cluster of up to MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES
+ * triangles of LOD 0, the unit the GPU culls. `bounds` is an object space
+ * sphere; the normal cone is stored as its axis and the sine of the widest
+ * angle between the axis and a triangle normal, so the whole cluster faces
+ * away from a viewer at `eye` when
+ *
+ *     dot(center - eye, axis) >= cone.w * length(center - eye) + radius
+ *
+ * cone.w = 1 means the normals spread too far and it never gets cone culled.
+ * std430 layout, must match `Meshlet` in shader/meshlet_common.glsl.
+**/
+
+struct Meshlet{
+    glm::vec4   bounds          = glm::vec4(0.0f);
+    glm::vec4   cone            = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    uint32_t    vertexOffset    = 0;    // into meshletVertices
+    uint32_t    triangleOffset  = 0;    // into meshletTriangles, 4 byte aligned
+    uint32_t    vertexCount     = 0;
+    uint32_t    triangleCount   = 0;
+};
+
+// Mesh shader output limits, 64/124 fits every vendor's sweet spot. The
+// compute path packs the local vertex into 6 bits, keep vertices at 64.
+const uint32_t MESHLET_MAX_VERTICES     = 64;
+const uint32_t MESHLET_MAX_TRIANGLES    = 124;
+
+/**
+ * Output of the mesh cooker. All LODs index the same vertex array, LOD 0 is
+ * the full resolution mesh and every following level is coarser.
+**/
+
+struct CookedMesh{
+    VertexFormat                vertexFormat = VertexFormat::Float;
+    std::vector<Vertex>         vertices;           // VertexFormat::Float
+    std::vector<PackedVertex>   packedVertices;     // VertexFormat::Packed
+    std::vector<uint32_t>       indices;
+    std::vector<MeshLod>        lods;
+    glm::vec4                   bounds = glm::vec4(0.0f);   // object space sphere, w = radius
+
+    // LOD 0 split into meshlets, empty when not cooked with them. Triangles
+    // are three local vertex indices (bytes) into the meshlet's vertex range,
+    // which in turn indexes `vertices`.
+    std::vector<Meshlet>        meshlets;
+    std::vector<uint32_t>       meshletVertices;
+    std::vector<uint8_t>        meshletTriangles;
+
+    size_t vertexCount() const;
+};
+
+bool writeCookedMesh(const char*, const CookedMesh&);
+bool readCookedMesh(const char*, CookedMesh&);
+
+// Converts the vertex data in place, no-op when already in that format
+void convertVertexFormat(CookedMesh&, VertexFormat);
+
+PackedVertex packVertex(const Vertex&);
+Vertex unpackVertex(const PackedVertex&);
+
+uint16_t floatToHalf(float);
+float halfToFloat(uint16_t);
+
+/**
+ * Picks the LOD for one instance. The error of each level is projected to
+ * pixels at the instance's distance; the coarsest level under `pixelThreshold`
+ * wins. Going coarser additionally requires the error to be `hysteresis`
+ * (fraction) below the threshold, so instances near the boundary don't flicker
+ * between levels every frame.
+ *
+ * `projectionScale` is the pixels per unit at distance 1,
+ * i.e. projection[1][1] * viewportHeight / 2.
+**/
+
+uint32_t selectLod(const std::vector<MeshLod>&,
+                   float distance,
+                   float projectionScale,
+                   uint32_t currentLod,
+                   float pixelThreshold = 1.0f,
+                   float hysteresis = 0.25f);
@@ -0,0 +1,849 @@
+#include "MeshCooker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+// Import
+// .............................................................................
+
+bool importMesh(const char* path, CookedMesh& mesh){
+    Assimp::Importer importer;
+
+    // Node transforms baked in, Vulkan's top left UV origin
+    const aiScene* scene = importer.ReadFile(path,
+                                             aiProcess_Triangulate |
+                                             aiProcess_JoinIdenticalVertices |
+                                             aiProcess_GenSmoothNormals |
+                                             aiProcess_PreTransformVertices |
+                                             aiProcess_FlipUVs);
+
+    if(scene == nullptr || scene->mNumMeshes == 0){
+        return false;
+    }
+
+    mesh = CookedMesh{};
+
+    for(unsigned m = 0; m < scene->mNumMeshes; m++){
+        const aiMesh* source = scene->mMeshes[m];
+        uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+
+        for(unsigned v = 0; v < source->mNumVertices; v++){
+            Vertex vertex{};
+            vertex.position = glm::vec3(source->mVertices[v].x, source->mVertices[v].y, source->mVertices[v].z);
+
+            if(source->HasNormals()){
+                vertex.normal = glm::vec3(source->mNormals[v].x, source->mNormals[v].y, source->mNormals[v].z);
+            }
+            if(source->HasTextureCoords(0)){
+                vertex.uv = glm::vec2(source->mTextureCoords[0][v].x, source->mTextureCoords[0][v].y);
+            }
+
+            mesh.vertices.push_back(vertex);
+        }
+
+        for(unsigned f = 0; f < source->mNumFaces; f++){
+            const aiFace& face = source->mFaces[f];
+            // Points and lines survive triangulation, skip them
+            if(face.mNumIndices != 3) continue;
+
+            for(unsigned i = 0; i < 3; i++){
+                mesh.indices.push_back(base + face.mIndices[i]);
+            }
+        }
+    }
+
+    if(mesh.indices.empty()){
+        return false;
+    }
+
+    mesh.bounds = computeBounds(mesh.vertices);
+    mesh.lods.push_back(MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+
+    return true;
+}
+
+glm::vec4 computeBounds(const std::vector<Vertex>& vertices){
+    if(vertices.empty()){
+        return glm::vec4(0.0f);
+    }
+
+    // Box center, not the tightest sphere but close enough for culling and LOD
+    glm::vec3 lo = vertices[0].position;
+    glm::vec3 hi = vertices[0].position;
+    for(const Vertex& vertex : vertices){
+        lo = glm::min(lo, vertex.position);
+        hi = glm::max(hi, vertex.position);
+    }
+
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for(const Vertex& vertex : vertices){
+        radius = std::max(radius, glm::length(vertex.position - center));
+    }
+
+    return glm::vec4(center, radius);
+}
+
+// Simplification
+// .............................................................................
+
+// Symmetric 4x4 matrix, sum of squared distances to a set of planes
+struct Quadric{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void addPlane(double a, double b, double c, double d){
+        a00 += a * a; a01 += a * b; a02 += a * c; a03 += a * d;
+        a11 += b * b; a12 += b * c; a13 += b * d;
+        a22 += c * c; a23 += c * d;
+        a33 += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& o){
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+        a11 += o.a11; a12 += o.a12; a13 += o.a13;
+        a22 += o.a22; a23 += o.a23;
+        a33 += o.a33;
+        return *this;
+    }
+
+    double evaluate(const glm::vec3& p) const{
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                     + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                     + a22 * z * z + 2.0 * a23 * z
+                     + a33;
+        return std::max(error, 0.0);
+    }
+};
+
+struct Collapse{
+    uint32_t    from;
+    uint32_t    to;
+    double      cost;
+};
+
+struct PositionHash{
+    size_t operator()(const glm::vec3& p) const{
+        // + 0.0f folds -0 into 0 so equal positions hash equally
+        glm::vec3 q = p + glm::vec3(0.0f);
+        uint32_t h[3];
+        memcpy(h, &q, sizeof(h));
+        return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+    }
+};
+
+// Id of the first vertex sharing each vertex's position
+static std::vector<uint32_t> weldPositions(const std::vector<Vertex>& vertices){
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> first;
+    first.reserve(vertices.size());
+
+    std::vector<uint32_t> position(vertices.size());
+    for(uint32_t v = 0; v < vertices.size(); v++){
+        position[v] = first.emplace(vertices[v].position, v).first->second;
+    }
+
+    return position;
+}
+
+// Would moving `from` onto `to` turn any surviving triangle around `from` over
+static bool collapseFlips(const std::vector<Vertex>& vertices,
+                          const std::vector<uint32_t>& position,
+                          const std::vector<uint32_t>& indices,
+                          const uint32_t* triangles, uint32_t triangleCount,
+                          uint32_t from, uint32_t to){
+    for(uint32_t k = 0; k < triangleCount; k++){
+        const uint32_t* tri = &indices[triangles[k] * 3];
+
+        // Triangles on the collapsed edge disappear
+        if(position[tri[0]] == position[to] || position[tri[1]] == position[to] || position[tri[2]] == position[to]){
+            continue;
+        }
+
+        glm::vec3 before[3], after[3];
+        for(int i = 0; i < 3; i++){
+            before[i]   = vertices[tri[i]].position;
+            after[i]    = tri[i] == from ? vertices[to].position : before[i];
+        }
+
+        glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+        // Also rejects turning more than ~75 degrees, those become slivers
+        if(glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1)){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices,
+                                   const std::vector<uint32_t>& sourceIndices,
+                                   size_t targetIndexCount,
+                                   float maxError,
+                                   float* resultError){
+    std::vector<uint32_t> indices = sourceIndices;
+    const size_t vertexCount = vertices.size();
+
+    // Topology is tracked per position so UV/normal seams don't look like borders
+    std::vector<uint32_t> position = weldPositions(vertices);
+
+    // Indexed by position id from here on
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::vector<Quadric> quadrics(vertexCount);
+
+    std::vector<uint32_t> wedges(vertexCount, 0);
+    for(uint32_t v = 0; v < vertexCount; v++){
+        wedges[position[v]]++;
+    }
+    for(uint32_t v = 0; v < vertexCount; v++){
+        if(wedges[v] > 1) locked[v] = 1;
+    }
+
+    // Edges not shared by exactly two triangles are open or non-manifold
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    for(size_t i = 0; i < indices.size(); i += 3){
+        for(int e = 0; e < 3; e++){
+            uint64_t a = position[indices[i + e]];
+            uint64_t b = position[indices[i + (e + 1) % 3]];
+            edgeUse[std::min(a, b) << 32 | std::max(a, b)]++;
+        }
+
+        glm::vec3 p0 = vertices[indices[i + 0]].position;
+        glm::vec3 p1 = vertices[indices[i + 1]].position;
+        glm::vec3 p2 = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if(area == 0.0f) continue;
+        normal /= area;
+
+        Quadric plane;
+        plane.addPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+        for(int c = 0; c < 3; c++){
+            quadrics[position[indices[i + c]]] += plane;
+        }
+    }
+
+    for(const auto& edge : edgeUse){
+        if(edge.second != 2){
+            locked[edge.first >> 32]            = 1;
+            locked[edge.first & 0xffffffffu]    = 1;
+        }
+    }
+
+    const double maxCost = double(maxError) * double(maxError);
+    double reachedCost = 0.0;
+
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t>  touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacencyFill(vertexCount);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+
+    // Each pass collapses a set of independent edges, cheapest first
+    while(indices.size() > targetIndexCount){
+        const size_t triangleCount = indices.size() / 3;
+
+        // Triangles around each vertex, CSR
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for(uint32_t index : indices){
+            adjacencyOffsets[index + 1]++;
+        }
+        for(size_t v = 0; v < vertexCount; v++){
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        std::copy(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1, adjacencyFill.begin());
+        adjacency.resize(indices.size());
+        for(size_t i = 0; i < indices.size(); i++){
+            adjacency[adjacencyFill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for(size_t i = 0; i < indices.size(); i += 3){
+            for(int e = 0; e < 3; e++){
+                uint32_t a = indices[i + e];
+                uint32_t b = indices[i + (e + 1) % 3];
+
+                // Both directions, whichever end is free to move
+                uint32_t ends[2][2] = {{a, b}, {b, a}};
+                for(auto& end : ends){
+                    if(locked[position[end[0]]]) continue;
+
+                    Quadric q = quadrics[position[end[0]]];
+                    q += quadrics[position[end[1]]];
+                    collapses.push_back({end[0], end[1], q.evaluate(vertices[end[1]].position)});
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& l, const Collapse& r){ return l.cost < r.cost; });
+
+        for(uint32_t v = 0; v < vertexCount; v++){
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t remaining = triangleCount;
+        size_t applied = 0;
+
+        for(const Collapse& collapse : collapses){
+            if(remaining * 3 <= targetIndexCount || collapse.cost > maxCost) break;
+
+            uint32_t fromPosition   = position[collapse.from];
+            uint32_t toPosition     = position[collapse.to];
+
+            // One collapse per neighbourhood per pass keeps the checks valid
+            if(touched[fromPosition] || touched[toPosition]) continue;
+
+            const uint32_t* triangles = adjacency.data() + adjacencyOffsets[collapse.from];
+            uint32_t fanSize = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+
+            if(collapseFlips(vertices, position, indices, triangles, fanSize, collapse.from, collapse.to)){
+                continue;
+            }
+
+            for(uint32_t k = 0; k < fanSize; k++){
+                const uint32_t* tri = &indices[triangles[k] * 3];
+                bool onEdge = false;
+                for(int c = 0; c < 3; c++){
+                    touched[position[tri[c]]] = 1;
+                    onEdge |= position[tri[c]] == toPosition;
+                }
+                remaining -= onEdge;
+            }
+
+            // `from` is not on a seam, so it is the only vertex at its position
+            remap[collapse.from] = collapse.to;
+            quadrics[toPosition] += quadrics[fromPosition];
+            reachedCost = std::max(reachedCost, collapse.cost);
+            applied++;
+        }
+
+        if(applied == 0){
+            break;
+        }
+
+        size_t write = 0;
+        for(size_t i = 0; i < indices.size(); i += 3){
+            uint32_t a = remap[indices[i + 0]];
+            uint32_t b = remap[indices[i + 1]];
+            uint32_t c = remap[indices[i + 2]];
+
+            if(position[a] == position[b] || position[b] == position[c] || position[a] == position[c]){
+                continue;
+            }
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    if(resultError){
+        *resultError = static_cast<float>(std::sqrt(reachedCost));
+    }
+
+    return indices;
+}
+
+void generateLods(CookedMesh& mesh, const LodSettings& settings){
+    if(mesh.vertexFormat != VertexFormat::Float){
+        return;
+    }
+
+    if(mesh.bounds.w == 0.0f){
+        mesh.bounds = computeBounds(mesh.vertices);
+    }
+
+    // Rebuilt from LOD 0 if the mesh already has a chain
+    size_t baseCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+
+    std::vector<std::vector<uint32_t>> levels;
+    levels.emplace_back(mesh.indices.begin(), mesh.indices.begin() + baseCount);
+    std::vector<float> errors = {0.0f};
+
+    const float maxError = settings.maxError * mesh.bounds.w;
+
+    while(levels.size() < settings.maxLods){
+        const std::vector<uint32_t>& previous = levels.back();
+
+        size_t target = static_cast<size_t>(previous.size() / 3 * settings.reduction) * 3;
+        if(target < settings.minTriangles * 3) break;
+
+        // Each level simplifies the previous one, so errors add up along the chain
+        float error = 0.0f;
+        std::vector<uint32_t> next = simplifyMesh(mesh.vertices, previous, target, maxError - errors.back(), &error);
+
+        // Stuck on locked vertices or the error budget, not worth another level
+        if(next.size() > previous.size() * 9 / 10) break;
+
+        errors.push_back(errors.back() + error);
+        levels.push_back(std::move(next));
+    }
+
+    mesh.indices.clear();
+    mesh.lods.clear();
+
+    for(size_t i = 0; i < levels.size(); i++){
+        MeshLod lod;
+        lod.indexOffset = static_cast<uint32_t>(mesh.indices.size());
+        lod.indexCount  = static_cast<uint32_t>(levels[i].size());
+        lod.error       = errors[i];
+
+        mesh.lods.push_back(lod);
+        mesh.indices.insert(mesh.indices.end(), levels[i].begin(), levels[i].end());
+    }
+}
+
+// Vertex cache
+// .............................................................................
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize){
+    VertexCacheStats stats;
+    if(indexCount < 3){
+        return stats;
+    }
+
+    // Time stamp of each vertex' entry into the FIFO, in the cache while younger than cacheSize
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    std::vector<uint8_t> seen(vertexCount, 0);
+
+    uint32_t clock = cacheSize + 1;
+    size_t misses = 0;
+    size_t unique = 0;
+
+    for(size_t i = 0; i < indexCount; i++){
+        uint32_t v = indices[i];
+
+        if(!seen[v]){
+            seen[v] = 1;
+            unique++;
+        }
+
+        if(clock - cachedAt[v] > cacheSize){
+            cachedAt[v] = clock++;
+            misses++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+
+    return stats;
+}
+
+static const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+static float forsythVertexScore(int32_t cachePosition, uint32_t remainingTriangles){
+    if(remainingTriangles == 0){
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cachePosition >= 0){
+        if(cachePosition < 3){
+            // Used by the last triangle, fixed so the next one isn't forced to share all three
+            score = 0.75f;
+        } else {
+            score = std::pow(1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+
+    // Finish off vertices with few triangles left so they leave the cache for good
+    return score + 2.0f / std::sqrt(float(remainingTriangles));
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount){
+    const size_t triangleCount = indexCount / 3;
+    if(triangleCount == 0){
+        return;
+    }
+
+    // Triangles around each vertex; the first `remaining[v]` entries are the not yet emitted ones
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for(size_t i = 0; i < indexCount; i++){
+        offsets[indices[i] + 1]++;
+    }
+    for(size_t v = 0; v < vertexCount; v++){
+        offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    std::vector<uint32_t> vertexTriangles(indexCount);
+    for(size_t i = 0; i < indexCount; i++){
+        uint32_t v = indices[i];
+        vertexTriangles[offsets[v] + remaining[v]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++){
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+
+    size_t bestTriangle = 0;
+    for(size_t t = 0; t < triangleCount; t++){
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if(triangleScore[t] > triangleScore[bestTriangle]) bestTriangle = t;
+    }
+
+    std::vector<uint32_t> result(triangleCount * 3);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+    size_t cacheSize = 0;
+    size_t nextUnemitted = 0;
+
+    for(size_t out = 0; out < triangleCount; out++){
+        if(bestTriangle == SIZE_MAX){
+            // Nothing in the cache has triangles left, continue with the next one in input order
+            while(emitted[nextUnemitted]) nextUnemitted++;
+            bestTriangle = nextUnemitted;
+        }
+
+        const uint32_t* tri = &indices[bestTriangle * 3];
+        result[out * 3 + 0] = tri[0];
+        result[out * 3 + 1] = tri[1];
+        result[out * 3 + 2] = tri[2];
+        emitted[bestTriangle] = 1;
+
+        for(int c = 0; c < 3; c++){
+            uint32_t v = tri[c];
+            uint32_t* list = &vertexTriangles[offsets[v]];
+            for(uint32_t k = 0; k < remaining[v]; k++){
+                if(list[k] == bestTriangle){
+                    std::swap(list[k], list[remaining[v] - 1]);
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        // LRU: this triangle's vertices move to the front
+        size_t newCacheSize = 0;
+        for(int c = 0; c < 3; c++){
+            newCache[newCacheSize++] = tri[c];
+        }
+        for(size_t i = 0; i < cacheSize; i++){
+            uint32_t v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2]){
+                newCache[newCacheSize++] = v;
+            }
+        }
+
+        // Rescore everything that moved, including what just fell out
+        for(size_t i = 0; i < newCacheSize; i++){
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+
+            float score = forsythVertexScore(cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for(uint32_t k = 0; k < remaining[v]; k++){
+                triangleScore[vertexTriangles[offsets[v] + k]] += delta;
+            }
+        }
+
+        cacheSize = std::min<size_t>(newCacheSize, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheSize, cache);
+
+        // Next triangle is the best one touching the cache
+        bestTriangle = SIZE_MAX;
+        float bestScore = -1.0f;
+        for(size_t i = 0; i < cacheSize; i++){
+            uint32_t v = cache[i];
+            for(uint32_t k = 0; k < remaining[v]; k++){
+                uint32_t t = vertexTriangles[offsets[v] + k];
+                if(triangleScore[t] > bestScore){
+                    bestScore       = triangleScore[t];
+                    bestTriangle    = t;
+                }
+            }
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+// Overdraw
+// .............................................................................
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, float threshold){
+    const size_t triangleCount = indexCount / 3;
+    if(triangleCount < 2){
+        return;
+    }
+
+    // Clusters start where the cache sorted order jumps to a new region (all
+    // three vertices miss), long runs are split as well so sorting has
+    // something to work with
+    const uint32_t  cacheSize           = 16;
+    const size_t    maxClusterTriangles = 128;
+
+    std::vector<uint32_t> cachedAt(vertices.size(), 0);
+    uint32_t clock = cacheSize + 1;
+
+    std::vector<size_t> clusterStarts;
+    for(size_t t = 0; t < triangleCount; t++){
+        int misses = 0;
+        for(int c = 0; c < 3; c++){
+            uint32_t v = indices[t * 3 + c];
+            if(clock - cachedAt[v] > cacheSize){
+                cachedAt[v] = clock++;
+                misses++;
+            }
+        }
+
+        if(t == 0 || misses == 3 || t - clusterStarts.back() >= maxClusterTriangles){
+            clusterStarts.push_back(t);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    if(clusterCount < 2){
+        return;
+    }
+
+    // Area weighted centroid and normal of every cluster and of the whole mesh
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for(size_t c = 0; c < clusterCount; c++){
+        float clusterArea = 0.0f;
+
+        for(size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++){
+            glm::vec3 p0 = vertices[indices[t * 3 + 0]].position;
+            glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+            glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            centroids[c]    += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c]      += normal;
+            clusterArea     += area;
+        }
+
+        meshCentroid    += centroids[c];
+        meshArea        += clusterArea;
+
+        if(clusterArea > 0.0f) centroids[c] /= clusterArea;
+
+        float length = glm::length(normals[c]);
+        if(length > 0.0f) normals[c] /= length;
+    }
+
+    if(meshArea > 0.0f) meshCentroid /= meshArea;
+
+    std::vector<float> keys(clusterCount);
+    std::vector<uint32_t> order(clusterCount);
+    for(size_t c = 0; c < clusterCount; c++){
+        keys[c]     = glm::dot(centroids[c] - meshCentroid, normals[c]);
+        order[c]    = static_cast<uint32_t>(c);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r){ return keys[l] > keys[r]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(triangleCount * 3);
+    for(uint32_t c : order){
+        sorted.insert(sorted.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    }
+
+    float before    = analyzeVertexCache(indices, triangleCount * 3, vertices.size()).acmr;
+    float after     = analyzeVertexCache(sorted.data(), sorted.size(), vertices.size()).acmr;
+
+    if(after <= before * threshold){
+        std::copy(sorted.begin(), sorted.end(), indices);
+    }
+}
+
+// Vertex fetch
+// .............................................................................
+
+void optimizeVertexFetch(CookedMesh& mesh){
+    if(mesh.vertexFormat != VertexFormat::Float){
+        return;
+    }
+
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    // LOD 0 comes first in the index buffer, so it gets the best locality
+    for(uint32_t& index : mesh.indices){
+        if(remap[index] == UINT32_MAX){
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    for(uint32_t& vertex : mesh.meshletVertices){
+        vertex = remap[vertex];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(CookedMesh& mesh, float overdrawThreshold){
+    if(mesh.vertexFormat != VertexFormat::Float){
+        return;
+    }
+
+    if(mesh.lods.empty()){
+        mesh.lods.push_back(MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    }
+
+    for(const MeshLod& lod : mesh.lods){
+        uint32_t* indices = mesh.indices.data() + lod.indexOffset;
+        optimizeVertexCache(indices, lod.indexCount, mesh.vertices.size());
+        optimizeOverdraw(indices, lod.indexCount, mesh.vertices, overdrawThreshold);
+    }
+
+    optimizeVertexFetch(mesh);
+}
+
+// Meshlets
+// .............................................................................
+
+static void finishMeshlet(CookedMesh& mesh, Meshlet& meshlet, const std::vector<glm::vec3>& normals){
+    const uint32_t* local = mesh.meshletVertices.data() + meshlet.vertexOffset;
+
+    glm::vec3 lo = mesh.vertices[local[0]].position;
+    glm::vec3 hi = lo;
+    for(uint32_t i = 1; i < meshlet.vertexCount; i++){
+        lo = glm::min(lo, mesh.vertices[local[i]].position);
+        hi = glm::max(hi, mesh.vertices[local[i]].position);
+    }
+
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for(uint32_t i = 0; i < meshlet.vertexCount; i++){
+        radius = std::max(radius, glm::length(mesh.vertices[local[i]].position - center));
+    }
+    meshlet.bounds = glm::vec4(center, radius);
+
+    glm::vec3 axis(0.0f);
+    for(const glm::vec3& normal : normals){
+        axis += normal;
+    }
+
+    // No cone (w = 1) when the normals cancel out or spread past ~84 degrees,
+    // such a cluster is visible from almost everywhere anyway
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    float length = glm::length(axis);
+    if(length < 1e-6f){
+        return;
+    }
+    axis /= length;
+
+    float minDot = 1.0f;
+    for(const glm::vec3& normal : normals){
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+
+    if(minDot > 0.1f){
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+}
+
+void buildMeshlets(CookedMesh& mesh, uint32_t maxVertices, uint32_t maxTriangles){
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+
+    if(mesh.vertexFormat != VertexFormat::Float || mesh.indices.empty()){
+        return;
+    }
+
+    maxVertices  = std::min(std::max(maxVertices, 3u), MESHLET_MAX_VERTICES);
+    maxTriangles = std::min(std::max(maxTriangles, 1u), MESHLET_MAX_TRIANGLES);
+
+    uint32_t indexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+    const uint32_t* indices = mesh.indices.data() + (mesh.lods.empty() ? 0 : mesh.lods[0].indexOffset);
+
+    // Slot of each vertex in the open meshlet, valid while its stamp matches
+    std::vector<uint8_t>  slot(mesh.vertices.size(), 0);
+    std::vector<uint32_t> stamp(mesh.vertices.size(), UINT32_MAX);
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(maxTriangles);
+
+    Meshlet meshlet;
+
+    auto flush = [&](){
+        if(meshlet.triangleCount == 0) return;
+
+        finishMeshlet(mesh, meshlet, normals);
+        mesh.meshlets.push_back(meshlet);
+
+        // Keep every triangle range 4 byte aligned for the shaders' uint reads
+        while(mesh.meshletTriangles.size() % 4 != 0){
+            mesh.meshletTriangles.push_back(0);
+        }
+
+        meshlet = Meshlet{};
+        meshlet.vertexOffset    = static_cast<uint32_t>(mesh.meshletVertices.size());
+        meshlet.triangleOffset  = static_cast<uint32_t>(mesh.meshletTriangles.size());
+        normals.clear();
+    };
+
+    // Greedy scan in index order. The index buffer is already cache optimised,
+    // so consecutive triangles are neighbours and the clusters come out compact.
+    for(uint32_t i = 0; i + 2 < indexCount; i += 3){
+        const uint32_t* triangle = indices + i;
+        uint32_t id = static_cast<uint32_t>(mesh.meshlets.size());
+
+        uint32_t newVertices = 0;
+        for(int k = 0; k < 3; k++){
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if(stamp[triangle[k]] != id && !repeated) newVertices++;
+        }
+
+        if(meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount + 1 > maxTriangles){
+            flush();
+            id = static_cast<uint32_t>(mesh.meshlets.size());
+        }
+
+        for(int k = 0; k < 3; k++){
+            uint32_t vertex = triangle[k];
+            if(stamp[vertex] != id){
+                stamp[vertex] = id;
+                slot[vertex]  = static_cast<uint8_t>(meshlet.vertexCount++);
+                mesh.meshletVertices.push_back(vertex);
+            }
+            mesh.meshletTriangles.push_back(slot[vertex]);
+        }
+        meshlet.triangleCount++;
+
+        glm::vec3 p0 = mesh.vertices[triangle[0]].position;
+        glm::vec3 normal = glm::cross(mesh.vertices[triangle[1]].position - p0, mesh.vertices[triangle[2]].position - p0);
+        float area = glm::length(normal);
+        if(area > 0.0f){
+            normals.push_back(normal / area);
+        }
+    }
+
+    flush();
+}
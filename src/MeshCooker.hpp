@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.hpp"
+
+// Offline half of the mesh pipeline: import with Assimp, process, write the
+// cooked format the runtime loads without any further work.
+
+struct LodSettings{
+    uint32_t    maxLods         = 6;
+    float       reduction       = 0.5f;     // index count of each level relative to the previous one
+    float       maxError        = 0.05f;    // relative to the bounding radius, ends the chain once exceeded
+    uint32_t    minTriangles    = 32;       // no level below this
+};
+
+// Merges every mesh of the file into one, LOD 0 only
+bool importMesh(const char*, CookedMesh&);
+
+glm::vec4 computeBounds(const std::vector<Vertex>&);
+
+/**
+ * Quadric error edge collapse. Vertices on open borders and attribute seams
+ * (several vertices sharing a position) never move, so the silhouette and UV
+ * layout survive; collapses that would flip a triangle are skipped.
+ *
+ * Stops at `targetIndexCount` or when the next collapse would move the surface
+ * further than `maxError`. The error actually reached goes to `resultError`.
+**/
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>&,
+                                   const std::vector<uint32_t>& indices,
+                                   size_t targetIndexCount,
+                                   float maxError,
+                                   float* resultError = nullptr);
+
+// Replaces mesh.lods with a chain built from mesh.indices (taken as LOD 0).
+// Float vertices only, LODs have to be built before packing.
+void generateLods(CookedMesh&, const LodSettings& = LodSettings{});
+
+// Post-transform vertex cache behaviour of an index buffer, simulated as a FIFO
+struct VertexCacheStats{
+    float acmr = 0.0f;      // vertex shader runs per triangle, 0.5 at best and 3 at worst
+    float atvr = 0.0f;      // vertex shader runs per unique vertex, 1 at best
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Forsyth's linear speed triangle reordering for the post-transform cache, in place
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/**
+ * Splits a cache optimised index buffer into clusters and draws the ones
+ * facing outwards from the mesh center first, so they occlude the rest and
+ * fewer fragments get shaded. Keeps the original order when that would make
+ * ACMR worse than `threshold` times what it was.
+**/
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<Vertex>&, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so vertex fetch walks memory
+// forward; vertices no LOD references are dropped
+void optimizeVertexFetch(CookedMesh&);
+
+// Cache and overdraw optimisation of every LOD, then vertex fetch. Float vertices only.
+void optimizeMesh(CookedMesh&, float overdrawThreshold = 1.05f);
+
+/**
+ * Splits LOD 0 into meshlets with bounding spheres and normal cones for GPU
+ * cluster culling. Vertex indices have to be final, so run it after
+ * optimizeMesh(); float vertices only.
+**/
+
+void buildMeshlets(CookedMesh&,
+                   uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                   uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,265 @@
+#include "MeshManager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "vkutil.hpp"
+
+void MeshManager::init(VkDevice device,
+                       VkPhysicalDevice physicalDevice,
+                       VkQueue queue,
+                       uint32_t queueFamilyIndex,
+                       VertexFormat vertexFormat,
+                       uint32_t maxVertices,
+                       uint32_t maxIndices){
+    mDevice         = device;
+    mPhysicalDevice = physicalDevice;
+    mQueue          = queue;
+    mVertexFormat   = vertexFormat;
+    mMaxVertices    = maxVertices;
+    mMaxIndices     = maxIndices;
+
+    createBuffer(mDevice, mPhysicalDevice, VkDeviceSize(maxVertices) * vertexStride(),
+                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mVertexBuffer, mVertexMemory);
+
+    createBuffer(mDevice, mPhysicalDevice, VkDeviceSize(maxIndices) * sizeof(uint32_t),
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mIndexBuffer, mIndexMemory);
+
+    // Sized for LOD 0 of every mesh at an average of 32 triangles a meshlet,
+    // each triangle range padded by at most 3 bytes
+    mMaxMeshlets                = std::max(maxIndices / 96, 1u);
+    mMaxMeshletVertices         = mMaxMeshlets * MESHLET_MAX_VERTICES;
+    mMaxMeshletTriangleBytes    = maxIndices + mMaxMeshlets * 3;
+
+    createBuffer(mDevice, mPhysicalDevice, VkDeviceSize(mMaxMeshlets) * sizeof(Meshlet),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mMeshletBuffer, mMeshletMemory);
+
+    createBuffer(mDevice, mPhysicalDevice, VkDeviceSize(mMaxMeshletVertices) * sizeof(uint32_t),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mMeshletVertexBuffer, mMeshletVertexMemory);
+
+    createBuffer(mDevice, mPhysicalDevice, VkDeviceSize(mMaxMeshletTriangleBytes),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mMeshletTriangleBuffer, mMeshletTriangleMemory);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex   = queueFamilyIndex;
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create mesh upload command pool");
+    }
+}
+
+void MeshManager::cleanup(){
+    vkDestroyBuffer(mDevice, mMeshletTriangleBuffer, nullptr);
+    vkFreeMemory(mDevice, mMeshletTriangleMemory, nullptr);
+    vkDestroyBuffer(mDevice, mMeshletVertexBuffer, nullptr);
+    vkFreeMemory(mDevice, mMeshletVertexMemory, nullptr);
+    vkDestroyBuffer(mDevice, mMeshletBuffer, nullptr);
+    vkFreeMemory(mDevice, mMeshletMemory, nullptr);
+    vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
+    vkFreeMemory(mDevice, mIndexMemory, nullptr);
+    vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
+    vkFreeMemory(mDevice, mVertexMemory, nullptr);
+
+    vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+
+    mMeshes.clear();
+}
+
+uint32_t MeshManager::upload(const CookedMesh& cookedMesh){
+    CookedMesh converted;
+    if(cookedMesh.vertexFormat != mVertexFormat){
+        converted = cookedMesh;
+        convertVertexFormat(converted, mVertexFormat);
+    }
+    const CookedMesh& mesh = cookedMesh.vertexFormat != mVertexFormat ? converted : cookedMesh;
+
+    const size_t vertexCount = mesh.vertexCount();
+
+    if(mVertexCount + vertexCount > mMaxVertices || mIndexCount + mesh.indices.size() > mMaxIndices){
+        throw std::runtime_error("mesh buffers are full");
+    }
+
+    if(mMeshletCount + mesh.meshlets.size() > mMaxMeshlets ||
+       mMeshletVertexCount + mesh.meshletVertices.size() > mMaxMeshletVertices ||
+       mMeshletTriangleBytes + mesh.meshletTriangles.size() > mMaxMeshletTriangleBytes){
+        throw std::runtime_error("meshlet buffers are full");
+    }
+
+    // Rebase onto the shared buffers, triangle bytes stay local to their meshlet
+    std::vector<Meshlet> meshlets = mesh.meshlets;
+    for(Meshlet& meshlet : meshlets){
+        meshlet.vertexOffset    += mMeshletVertexCount;
+        meshlet.triangleOffset  += mMeshletTriangleBytes;
+    }
+
+    std::vector<uint32_t> meshletVertices = mesh.meshletVertices;
+    for(uint32_t& vertex : meshletVertices){
+        vertex += mVertexCount;
+    }
+
+    const void* vertexData = mVertexFormat == VertexFormat::Packed ?
+                             static_cast<const void*>(mesh.packedVertices.data()) :
+                             static_cast<const void*>(mesh.vertices.data());
+
+    VkDeviceSize vertexBytes = vertexCount * vertexStride();
+    VkDeviceSize indexBytes  = mesh.indices.size() * sizeof(uint32_t);
+
+    VkDeviceSize meshletBytes           = meshlets.size() * sizeof(Meshlet);
+    VkDeviceSize meshletVertexBytes     = meshletVertices.size() * sizeof(uint32_t);
+    VkDeviceSize meshletTriangleBytes   = mesh.meshletTriangles.size();
+
+    // Staging layout: vertices, indices, meshlets, meshlet vertices, meshlet triangles
+    VkDeviceSize offsets[5];
+    offsets[0] = 0;
+    offsets[1] = offsets[0] + vertexBytes;
+    offsets[2] = offsets[1] + indexBytes;
+    offsets[3] = offsets[2] + meshletBytes;
+    offsets[4] = offsets[3] + meshletVertexBytes;
+    VkDeviceSize stagingBytes = offsets[4] + meshletTriangleBytes;
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    createBuffer(mDevice, mPhysicalDevice, stagingBytes,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 stagingBuffer, stagingMemory);
+
+    void* mapped;
+    vkMapMemory(mDevice, stagingMemory, 0, stagingBytes, 0, &mapped);
+    uint8_t* staging = static_cast<uint8_t*>(mapped);
+    memcpy(staging + offsets[0], vertexData, vertexBytes);
+    memcpy(staging + offsets[1], mesh.indices.data(), indexBytes);
+    memcpy(staging + offsets[2], meshlets.data(), meshletBytes);
+    memcpy(staging + offsets[3], meshletVertices.data(), meshletVertexBytes);
+    memcpy(staging + offsets[4], mesh.meshletTriangles.data(), meshletTriangleBytes);
+    vkUnmapMemory(mDevice, stagingMemory);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(mDevice, mCommandPool);
+
+    VkBufferCopy vertexCopy{};
+    vertexCopy.srcOffset    = 0;
+    vertexCopy.dstOffset    = VkDeviceSize(mVertexCount) * vertexStride();
+    vertexCopy.size         = vertexBytes;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, mVertexBuffer, 1, &vertexCopy);
+
+    VkBufferCopy indexCopy{};
+    indexCopy.srcOffset     = vertexBytes;
+    indexCopy.dstOffset     = VkDeviceSize(mIndexCount) * sizeof(uint32_t);
+    indexCopy.size          = indexBytes;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, mIndexBuffer, 1, &indexCopy);
+
+    if(!meshlets.empty()){
+        VkBufferCopy meshletCopies[3]{};
+        meshletCopies[0] = {offsets[2], VkDeviceSize(mMeshletCount) * sizeof(Meshlet), meshletBytes};
+        meshletCopies[1] = {offsets[3], VkDeviceSize(mMeshletVertexCount) * sizeof(uint32_t), meshletVertexBytes};
+        meshletCopies[2] = {offsets[4], VkDeviceSize(mMeshletTriangleBytes), meshletTriangleBytes};
+
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, mMeshletBuffer, 1, &meshletCopies[0]);
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, mMeshletVertexBuffer, 1, &meshletCopies[1]);
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, mMeshletTriangleBuffer, 1, &meshletCopies[2]);
+    }
+
+    // Meshlet data and pulled vertices are read as storage buffers by the
+    // cluster culling compute pass and the vertex/task/mesh stages
+    VkMemoryBarrier barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    endSingleTimeCommands(mDevice, mCommandPool, mQueue, commandBuffer);
+
+    vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
+    vkFreeMemory(mDevice, stagingMemory, nullptr);
+
+    GpuMesh gpuMesh;
+    gpuMesh.vertexOffset    = static_cast<int32_t>(mVertexCount);
+    gpuMesh.firstIndex      = mIndexCount;
+    gpuMesh.lods            = mesh.lods;
+    gpuMesh.bounds          = mesh.bounds;
+    gpuMesh.meshletOffset   = mMeshletCount;
+    gpuMesh.meshletCount    = static_cast<uint32_t>(meshlets.size());
+
+    // Meshes cooked without a chain are their own LOD 0
+    if(gpuMesh.lods.empty()){
+        gpuMesh.lods.push_back(MeshLod{0, static_cast<uint32_t>(mesh.indices.size()), 0.0f});
+    }
+
+    mVertexCount    += static_cast<uint32_t>(vertexCount);
+    mIndexCount     += static_cast<uint32_t>(mesh.indices.size());
+
+    mMeshletCount           += static_cast<uint32_t>(meshlets.size());
+    mMeshletVertexCount     += static_cast<uint32_t>(meshletVertices.size());
+    mMeshletTriangleBytes   += static_cast<uint32_t>(meshletTriangleBytes);
+
+    mMeshes.push_back(gpuMesh);
+
+    return static_cast<uint32_t>(mMeshes.size() - 1);
+}
+
+uint32_t MeshManager::load(const char* path){
+    std::string _path = logl_root;
+    _path += path;
+
+    CookedMesh mesh;
+    if(!readCookedMesh(_path.c_str(), mesh)){
+        return UINT32_MAX;
+    }
+
+    return upload(mesh);
+}
+
+void MeshManager::bind(VkCommandBuffer commandBuffer) const{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mVertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+const GpuMesh& MeshManager::get(uint32_t index) const{
+    return mMeshes[index];
+}
+
+uint32_t MeshManager::count() const{
+    return static_cast<uint32_t>(mMeshes.size());
+}
+
+VertexFormat MeshManager::vertexFormat() const{
+    return mVertexFormat;
+}
+
+uint32_t MeshManager::vertexStride() const{
+    return mVertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+VkBuffer MeshManager::vertexBuffer() const{
+    return mVertexBuffer;
+}
+
+VkBuffer MeshManager::meshletBuffer() const{
+    return mMeshletBuffer;
+}
+
+VkBuffer MeshManager::meshletVertexBuffer() const{
+    return mMeshletVertexBuffer;
+}
+
+VkBuffer MeshManager::meshletTriangleBuffer() const{
+    return mMeshletTriangleBuffer;
+}
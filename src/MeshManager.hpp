@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "Mesh.hpp"
+
+// Where a cooked mesh landed in the shared buffers. LOD index offsets are
+// relative to `firstIndex`; meshlets are fully rebased on upload, their vertex
+// indices address the shared vertex buffer directly.
+struct GpuMesh{
+    int32_t                 vertexOffset    = 0;
+    uint32_t                firstIndex      = 0;
+    uint32_t                meshletOffset   = 0;
+    uint32_t                meshletCount    = 0;
+    std::vector<MeshLod>    lods;
+    glm::vec4               bounds          = glm::vec4(0.0f);
+};
+
+// Pushed per mesh draw, must match shader/mesh.vs.vert
+struct MeshPushConstants{
+    glm::mat4   transform;              // clip from object
+    glm::vec4   world[3];               // rows of world from object, for lighting
+    uint32_t    materialIndex   = 0;
+    uint32_t    instanceIndex   = 0;
+};
+
+/**
+ * All meshes share one device local vertex buffer and one index buffer, so
+ * they are bound once per command buffer and every draw only changes offsets.
+ * Capacity is fixed at init; uploads go through a staging buffer. Meshes
+ * cooked in another vertex format are converted on upload.
+ *
+ * Meshlets live in three more shared storage buffers (meshlets, their vertex
+ * lists and packed triangle bytes). The vertex buffer is a storage buffer as
+ * well so meshlet shaders can fetch vertices themselves.
+**/
+
+class MeshManager{
+    public:
+        void init(VkDevice, VkPhysicalDevice, VkQueue, uint32_t, VertexFormat, uint32_t maxVertices, uint32_t maxIndices);
+        void cleanup();
+
+        uint32_t upload(const CookedMesh&);
+
+        // Path relative to the project root, UINT32_MAX when the file is
+        // missing or not a cooked mesh
+        uint32_t load(const char*);
+
+        void bind(VkCommandBuffer) const;
+
+        const GpuMesh& get(uint32_t) const;
+        uint32_t count() const;
+
+        VertexFormat vertexFormat() const;
+        uint32_t vertexStride() const;
+
+        VkBuffer vertexBuffer() const;
+        VkBuffer meshletBuffer() const;
+        VkBuffer meshletVertexBuffer() const;
+        VkBuffer meshletTriangleBuffer() const;
+
+    private:
+        VkDevice            mDevice         = VK_NULL_HANDLE;
+        VkPhysicalDevice    mPhysicalDevice = VK_NULL_HANDLE;
+        VkQueue             mQueue          = VK_NULL_HANDLE;
+        VkCommandPool       mCommandPool    = VK_NULL_HANDLE;
+        VertexFormat        mVertexFormat   = VertexFormat::Float;
+
+        VkBuffer            mVertexBuffer   = VK_NULL_HANDLE;
+        VkDeviceMemory      mVertexMemory   = VK_NULL_HANDLE;
+        VkBuffer            mIndexBuffer    = VK_NULL_HANDLE;
+        VkDeviceMemory      mIndexMemory    = VK_NULL_HANDLE;
+
+        VkBuffer            mMeshletBuffer          = VK_NULL_HANDLE;
+        VkDeviceMemory      mMeshletMemory          = VK_NULL_HANDLE;
+        VkBuffer            mMeshletVertexBuffer    = VK_NULL_HANDLE;
+        VkDeviceMemory      mMeshletVertexMemory    = VK_NULL_HANDLE;
+        VkBuffer            mMeshletTriangleBuffer  = VK_NULL_HANDLE;
+        VkDeviceMemory      mMeshletTriangleMemory  = VK_NULL_HANDLE;
+
+        uint32_t            mMaxVertices    = 0;
+        uint32_t            mMaxIndices     = 0;
+        uint32_t            mVertexCount    = 0;
+        uint32_t            mIndexCount     = 0;
+
+        uint32_t            mMaxMeshlets                = 0;
+        uint32_t            mMaxMeshletVertices         = 0;
+        uint32_t            mMaxMeshletTriangleBytes    = 0;
+        uint32_t            mMeshletCount               = 0;
+        uint32_t            mMeshletVertexCount         = 0;
+        uint32_t            mMeshletTriangleBytes       = 0;
+
+        std::vector<GpuMesh> mMeshes;
+};
@@ -0,0 +1,516 @@
+#include "Meshlets.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "vkutil.hpp"
+
+// Indirect command followed by the survivor counter, must match
+// `DrawCommand` in shader/meshlet_cull.comp. One per phase.
+struct MeshletDrawCommand{
+    VkDrawIndexedIndirectCommand    command;
+    uint32_t                        survivorCount;
+};
+
+// Task workgroup size in shader/meshlet.task, local size in shader/meshlet_cull.comp
+static const uint32_t TASK_GROUP_SIZE = 32;
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+void MeshletCuller::init(VkDevice device,
+                         VkPhysicalDevice physicalDevice,
+                         const MeshManager& meshes,
+                         VkDescriptorSetLayout materialLayout,
+                         VkDescriptorSetLayout lightLayout,
+                         VkDescriptorSetLayout shadowLayout,
+                         bool meshShaders,
+                         bool occlusionCulling,
+                         uint32_t framesInFlight,
+                         uint32_t maxInstances,
+                         uint32_t maxSurvivors,
+                         uint32_t maxIndices){
+    mDevice             = device;
+    mMeshShaders        = meshShaders;
+    mOcclusionCulling   = occlusionCulling && !meshShaders;
+
+    // Instances go on the y axis of the dispatch, 65535 is the guaranteed limit
+    mMaxInstances   = std::min(maxInstances, 65535u);
+
+    // Survivor slots are shifted left by 6 in the compacted indices and
+    // without fullDrawIndexUint32 indices stop at 2^24 - 1
+    maxSurvivors    = std::min(maxSurvivors, (1u << 18) - 1);
+
+    // Whole triangles, the cull clamps the draw's index count to it
+    maxIndices      = std::max(maxIndices / 3 * 3, 3u);
+
+    // The task shader never writes survivors or indices
+    if(mMeshShaders){
+        maxSurvivors    = 1;
+        maxIndices      = 3;
+    }
+
+    mDrawStages = mMeshShaders ?
+                  VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT :
+                  VK_SHADER_STAGE_VERTEX_BIT;
+
+    // Descriptors
+    // .........................................................................
+
+    // 0 vertices, 1 meshlets, 2 meshlet vertices, 3 meshlet triangles,
+    // 4 instances, 5 survivors, 6 compacted indices, 7 draw commands, and
+    // for occlusion culling 8 visibility bits and 9 the depth pyramid
+    uint32_t bindingCount = mOcclusionCulling ? 10 : 8;
+
+    VkDescriptorSetLayoutBinding bindings[10]{};
+    for(uint32_t i = 0; i < bindingCount; i++){
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = i < 9 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = i < 8 ? VK_SHADER_STAGE_COMPUTE_BIT | mDrawStages : VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindingCount;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create meshlet descriptor set layout");
+    }
+    mSignature = setLayoutSignature(layoutInfo);
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount    = 9;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount    = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = 1;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+
+    if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create meshlet descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool        = mPool;
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &mSetLayout;
+
+    if(vkAllocateDescriptorSets(mDevice, &allocInfo, &mSet) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate meshlet descriptor set");
+    }
+
+    // Buffers
+    // .........................................................................
+
+    VkDeviceSize instanceBytes = VkDeviceSize(mMaxInstances) * framesInFlight * sizeof(MeshletInstance);
+
+    createBuffer(mDevice, physicalDevice, instanceBytes,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 mInstanceBuffer, mInstanceMemory);
+
+    vkMapMemory(mDevice, mInstanceMemory, 0, instanceBytes, 0, reinterpret_cast<void**>(&mInstances));
+
+    createBuffer(mDevice, physicalDevice, VkDeviceSize(maxSurvivors) * 2 * sizeof(uint32_t),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mSurvivorBuffer, mSurvivorMemory);
+
+    createBuffer(mDevice, physicalDevice, VkDeviceSize(maxIndices) * sizeof(uint32_t),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mIndexBuffer, mIndexMemory);
+
+    createBuffer(mDevice, physicalDevice, 2 * sizeof(MeshletDrawCommand),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 mDrawBuffer, mDrawMemory);
+
+    if(mOcclusionCulling){
+        createBuffer(mDevice, physicalDevice, MAX_VISIBILITY / 8,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     mVisibilityBuffer, mVisibilityMemory);
+    }
+
+    VkBuffer buffers[9] = {
+        meshes.vertexBuffer(),
+        meshes.meshletBuffer(),
+        meshes.meshletVertexBuffer(),
+        meshes.meshletTriangleBuffer(),
+        mInstanceBuffer,
+        mSurvivorBuffer,
+        mIndexBuffer,
+        mDrawBuffer,
+        mVisibilityBuffer
+    };
+
+    // The pyramid comes later, from setDepthPyramid()
+    uint32_t bufferCount = mOcclusionCulling ? 9 : 8;
+
+    VkDescriptorBufferInfo bufferInfos[9]{};
+    VkWriteDescriptorSet writes[9]{};
+    for(uint32_t i = 0; i < bufferCount; i++){
+        bufferInfos[i].buffer   = buffers[i];
+        bufferInfos[i].offset   = 0;
+        bufferInfos[i].range    = VK_WHOLE_SIZE;
+
+        writes[i].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet            = mSet;
+        writes[i].dstBinding        = i;
+        writes[i].descriptorCount   = 1;
+        writes[i].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo       = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(mDevice, bufferCount, writes, 0, nullptr);
+
+    // Pipelines
+    // .........................................................................
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(MeshletPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &mSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    if(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mCullLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create meshlet cull pipeline layout");
+    }
+
+    // Graphics side: geometry in set 0, then the bindless table, the lights
+    // and the shadows, whichever there are
+    VkDescriptorSetLayout drawSetLayouts[4] = {mSetLayout};
+    uint32_t drawSetCount = 1;
+    if(materialLayout != VK_NULL_HANDLE){
+        drawSetLayouts[drawSetCount++] = materialLayout;
+    }
+    if(lightLayout != VK_NULL_HANDLE){
+        drawSetLayouts[drawSetCount++] = lightLayout;
+    }
+    if(shadowLayout != VK_NULL_HANDLE){
+        drawSetLayouts[drawSetCount++] = shadowLayout;
+    }
+
+    pushConstantRange.stageFlags            = mDrawStages;
+    mDrawPushConstants                      = pushConstantRange;
+    pipelineLayoutInfo.setLayoutCount       = drawSetCount;
+    pipelineLayoutInfo.pSetLayouts          = drawSetLayouts;
+
+    if(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mDrawLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create meshlet draw pipeline layout");
+    }
+
+    if(!mMeshShaders){
+        // The first phase only differs with occlusion culling, the second
+        // only exists with it; the clamp runs after either
+        std::vector<std::pair<const char*, VkPipeline*>> variants = {
+            {mOcclusionCulling ? "OCCLUSION_EARLY" : nullptr, &mCullPipeline},
+            {"CLAMP_DRAW", &mClampPipeline}
+        };
+        if(mOcclusionCulling){
+            variants.push_back({"OCCLUSION_LATE", &mLateCullPipeline});
+        }
+
+        for(const auto& [define, pipeline] : variants){
+            std::vector<std::string> defines;
+            if(define){
+                defines.push_back(define);
+            }
+
+            VkShaderModule cullShaderModule = createShaderModule(mDevice, compileShader("/shader/meshlet_cull.comp", shaderc_compute_shader, defines));
+
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module   = cullShaderModule;
+            pipelineInfo.stage.pName    = "main";
+            pipelineInfo.layout         = mCullLayout;
+
+            if(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, pipeline) != VK_SUCCESS){
+                throw std::runtime_error("failed to create meshlet cull pipeline");
+            }
+
+            vkDestroyShaderModule(mDevice, cullShaderModule, nullptr);
+        }
+    } else {
+        // Extension command, not exported by the loader
+        mDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(mDevice, "vkCmdDrawMeshTasksEXT"));
+        if(mDrawMeshTasks == nullptr){
+            throw std::runtime_error("failed to load vkCmdDrawMeshTasksEXT");
+        }
+
+        VkPhysicalDeviceMeshShaderPropertiesEXT meshProperties{};
+        meshProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &meshProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        // Whole subgroups, and no more threads than a meshlet has triangles
+        uint32_t preferred = meshProperties.maxPreferredMeshWorkGroupInvocations;
+        mMeshGroupSize = std::min(std::max(preferred / 32 * 32, 32u), 128u);
+    }
+
+    mConstants.survivorCapacity = maxSurvivors;
+    mConstants.indexCapacity    = maxIndices;
+}
+
+void MeshletCuller::cleanup(){
+    vkDestroyPipeline(mDevice, mCullPipeline, nullptr);
+    vkDestroyPipeline(mDevice, mLateCullPipeline, nullptr);
+    vkDestroyPipeline(mDevice, mClampPipeline, nullptr);
+    vkDestroyPipelineLayout(mDevice, mCullLayout, nullptr);
+    vkDestroyPipelineLayout(mDevice, mDrawLayout, nullptr);
+
+    vkUnmapMemory(mDevice, mInstanceMemory);
+    vkDestroyBuffer(mDevice, mInstanceBuffer, nullptr);
+    vkFreeMemory(mDevice, mInstanceMemory, nullptr);
+    vkDestroyBuffer(mDevice, mSurvivorBuffer, nullptr);
+    vkFreeMemory(mDevice, mSurvivorMemory, nullptr);
+    vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
+    vkFreeMemory(mDevice, mIndexMemory, nullptr);
+    vkDestroyBuffer(mDevice, mDrawBuffer, nullptr);
+    vkFreeMemory(mDevice, mDrawMemory, nullptr);
+    vkDestroyBuffer(mDevice, mVisibilityBuffer, nullptr);
+    vkFreeMemory(mDevice, mVisibilityMemory, nullptr);
+
+    vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+}
+
+void MeshletCuller::prepare(uint32_t frame,
+                            const MeshletInstance* instances,
+                            size_t instanceCount,
+                            const Frustum& frustum,
+                            const glm::vec3& eye){
+    uint32_t count = static_cast<uint32_t>(std::min<size_t>(instanceCount, mMaxInstances));
+
+    mConstants.instanceBase     = frame * mMaxInstances;
+    mConstants.instanceCount    = count;
+    mConstants.cameraPosition   = glm::vec4(eye, 1.0f);
+    for(int i = 0; i < 6; i++){
+        mConstants.frustum[i] = frustum.planes[i];
+    }
+
+    memcpy(mInstances + mConstants.instanceBase, instances, count * sizeof(MeshletInstance));
+
+    mMaxMeshletCount = 0;
+    for(uint32_t i = 0; i < count; i++){
+        mMaxMeshletCount = std::max(mMaxMeshletCount, instances[i].meshletCount);
+    }
+
+    // Ranges are never freed, so out of bits means starting over: the next
+    // frame's instances get new ones, and this frame's cull begins from
+    // cleared bits so nothing old carries over. Between frames, so no two
+    // instances of one frame ever share bits.
+    if(mVisibilityFull){
+        std::fill(mVisibilityRanges.begin(), mVisibilityRanges.end(), VisibilityRange());
+        mVisibilityEnd      = 0;
+        mVisibilityFull     = false;
+        mVisibilityCleared  = false;
+    }
+}
+
+void MeshletCuller::recordCull(VkCommandBuffer commandBuffer){
+    if(mMeshShaders || mConstants.instanceCount == 0){
+        return;
+    }
+
+    // The previous frame's draw may still be reading the outputs, and its
+    // late cull wrote the visibility bits this cull reads
+    VkMemoryBarrier barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    MeshletDrawCommand reset[2]{};
+    reset[0].command.instanceCount = 1;
+    reset[1].command.instanceCount = 1;
+    vkCmdUpdateBuffer(commandBuffer, mDrawBuffer, 0, sizeof(reset), reset);
+
+    // Nothing counts as visible the first frame or after the ranges started
+    // over, the late cull tests it all
+    if(mOcclusionCulling && !mVisibilityCleared){
+        vkCmdFillBuffer(commandBuffer, mVisibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+        mVisibilityCleared = true;
+    }
+
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    recordDispatch(commandBuffer, mCullPipeline);
+}
+
+void MeshletCuller::recordDraw(VkCommandBuffer commandBuffer) const{
+    if(mConstants.instanceCount == 0){
+        return;
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mDrawLayout, 0, 1, &mSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, mDrawLayout, mDrawStages, 0, sizeof(MeshletPushConstants), &mConstants);
+
+    if(mMeshShaders){
+        mDrawMeshTasks(commandBuffer, (mMaxMeshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, mConstants.instanceCount, 1);
+    } else {
+        vkCmdBindIndexBuffer(commandBuffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(commandBuffer, mDrawBuffer, 0, 1, sizeof(MeshletDrawCommand));
+    }
+}
+
+void MeshletCuller::recordLateCull(VkCommandBuffer commandBuffer) const{
+    if(!mOcclusionCulling || mConstants.instanceCount == 0){
+        return;
+    }
+
+    // Carries on from the first phase's counts and flips its visibility bits
+    VkMemoryBarrier barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    recordDispatch(commandBuffer, mLateCullPipeline);
+}
+
+void MeshletCuller::recordLateDraw(VkCommandBuffer commandBuffer) const{
+    if(!mOcclusionCulling || mConstants.instanceCount == 0){
+        return;
+    }
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mDrawLayout, 0, 1, &mSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, mDrawLayout, mDrawStages, 0, sizeof(MeshletPushConstants), &mConstants);
+
+    // Its indices follow the first phase's in the same buffer
+    vkCmdBindIndexBuffer(commandBuffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(commandBuffer, mDrawBuffer, sizeof(MeshletDrawCommand), 1, sizeof(MeshletDrawCommand));
+}
+
+void MeshletCuller::recordDispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline) const{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullLayout, 0, 1, &mSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, mCullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletPushConstants), &mConstants);
+
+    vkCmdDispatch(commandBuffer, (mMaxMeshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, mConstants.instanceCount, 1);
+
+    // Brings the index count back within what was written, same layout so
+    // the set and push constants stay bound
+    VkMemoryBarrier barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mClampPipeline);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletCuller::setDepthPyramid(VkImageView view, VkSampler sampler){
+    if(!mOcclusionCulling){
+        return;
+    }
+
+    VkDescriptorImageInfo imageInfo{sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    VkWriteDescriptorSet write{};
+    write.sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet            = mSet;
+    write.dstBinding        = 9;
+    write.descriptorCount   = 1;
+    write.descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo        = &imageInfo;
+
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+}
+
+uint32_t MeshletCuller::visibilityOffset(uint32_t key, uint32_t meshletCount){
+    if(key >= mVisibilityRanges.size()){
+        mVisibilityRanges.resize(key + 1);
+    }
+
+    // A new key, or one whose mesh has grown, gets a new range. When the
+    // bits run out the instance goes without occlusion culling this frame;
+    // starting over now would have it share bits with instances that already
+    // got theirs, and in the late cull one's update can land before the
+    // other's read. prepare() starts over once the frame's offsets are out.
+    VisibilityRange& range = mVisibilityRanges[key];
+    if(range.count < meshletCount){
+        if(mVisibilityEnd + meshletCount > MAX_VISIBILITY){
+            mVisibilityFull = true;
+            return NO_VISIBILITY;
+        }
+
+        range.offset    = mVisibilityEnd;
+        range.count     = meshletCount;
+        mVisibilityEnd += meshletCount;
+    }
+
+    return range.offset;
+}
+
+VkPipelineLayout MeshletCuller::drawLayout() const{
+    return mDrawLayout;
+}
+
+uint64_t MeshletCuller::layoutSignature() const{
+    return mSignature;
+}
+
+VkPushConstantRange MeshletCuller::drawPushConstants() const{
+    return mDrawPushConstants;
+}
+
+bool MeshletCuller::meshShaders() const{
+    return mMeshShaders;
+}
+
+bool MeshletCuller::occlusionCulling() const{
+    return mOcclusionCulling;
+}
+
+uint32_t MeshletCuller::meshGroupSize() const{
+    return mMeshGroupSize;
+}
+
+uint32_t MeshletCuller::maxInstances() const{
+    return mMaxInstances;
+}
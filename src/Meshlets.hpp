@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+#include "Culling.hpp"
+#include "MeshManager.hpp"
+
+// One mesh instance drawn through its meshlets. std430, must match
+// `Instance` in shader/meshlet_common.glsl
+struct MeshletInstance{
+    glm::mat4   world               = glm::mat4(1.0f);
+    glm::mat4   clipFromObject      = glm::mat4(1.0f);
+    uint32_t    meshletOffset       = 0;
+    uint32_t    meshletCount        = 0;
+    uint32_t    materialIndex       = 0;
+    float       scale               = 1.0f;     // world radius over object radius, for the meshlet bounds
+    uint32_t    visibilityOffset    = 0;        // from MeshletCuller::visibilityOffset(), with occlusion culling
+    uint32_t    _pad[3]             = {0, 0, 0};
+};
+
+// Shared by the culling and draw pipelines, must match shader/meshlet_common.glsl
+struct MeshletPushConstants{
+    glm::vec4   frustum[6];
+    glm::vec4   cameraPosition;
+    uint32_t    instanceBase        = 0;    // first instance of this frame in flight
+    uint32_t    instanceCount       = 0;
+    uint32_t    survivorCapacity    = 0;
+    uint32_t    indexCapacity       = 0;
+};
+
+/**
+ * GPU cluster culling for meshes cooked with meshlets. Every meshlet of every
+ * instance is tested against the frustum and its normal cone, so only the
+ * clusters that can actually be seen reach the rasterizer.
+ *
+ * Without mesh shaders shader/meshlet_cull.comp runs before rendering and
+ * appends the surviving triangles to a compacted index buffer, counted in a
+ * VkDrawIndexedIndirectCommand; a single indirect draw then pulls the vertices
+ * in shader/meshlet.vs.vert. With VK_EXT_mesh_shader the task shader does the
+ * same test and launches one mesh workgroup per surviving meshlet, no pre-pass
+ * and no round trip through memory.
+ *
+ * With occlusion culling, on the compute path only, culling and drawing go
+ * in two phases around a depth pyramid of the first:
+ *
+ *  - recordCull() keeps only the meshlets that were visible last frame and
+ *    recordDraw() draws them, a good occluder set at no cost,
+ *  - the caller builds a DepthPyramid from that depth,
+ *  - recordLateCull() tests every meshlet against the pyramid, remembers the
+ *    outcome for next frame and keeps only those the first phase missed;
+ *    recordLateDraw() draws them on top.
+ *
+ * Visibility is a bit per meshlet per instance, kept across frames at the
+ * instance's visibilityOffset. A wrong bit costs a meshlet drawn early for
+ * nothing, or tested late, never a missing one. Instances of one frame never
+ * share bits: when they run out, the instances left get none and are drawn
+ * early whenever in the frustum, and all ranges start over the next frame.
+ *
+ * Instances are written per frame in flight into a persistently mapped
+ * buffer; the culling outputs are single buffers, ordered against the
+ * previous frame's draw by a barrier.
+**/
+
+class MeshletCuller{
+    public:
+        // Visibility bits kept for all instances together, 512 KB
+        static constexpr uint32_t MAX_VISIBILITY = 1u << 22;
+        static constexpr uint32_t NO_VISIBILITY = UINT32_MAX;
+
+        void init(VkDevice,
+                  VkPhysicalDevice,
+                  const MeshManager&,
+                  VkDescriptorSetLayout materialLayout,     // bound as set 1 when not VK_NULL_HANDLE
+                  VkDescriptorSetLayout lightLayout,        // next set when not VK_NULL_HANDLE
+                  VkDescriptorSetLayout shadowLayout,       // and the one after
+                  bool meshShaders,
+                  bool occlusionCulling,                    // ignored with mesh shaders
+                  uint32_t framesInFlight,
+                  uint32_t maxInstances,
+                  uint32_t maxSurvivors,
+                  uint32_t maxIndices);
+        void cleanup();
+
+        // Instances of the frame in flight `frame`, whose previous submission
+        // the caller has already waited for. At most maxInstances() are taken.
+        void prepare(uint32_t frame, const MeshletInstance*, size_t count, const Frustum&, const glm::vec3& eye);
+
+        // Compute path culling, outside of rendering. No-op with mesh shaders.
+        void recordCull(VkCommandBuffer);
+
+        // Inside rendering with a pipeline made from drawLayout() bound
+        void recordDraw(VkCommandBuffer) const;
+
+        // The second phase with occlusion culling, after the first phase's
+        // depth went into the pyramid set with setDepthPyramid(). The pyramid
+        // must be in SHADER_READ_ONLY_OPTIMAL, readable by compute.
+        void recordLateCull(VkCommandBuffer) const;
+        void recordLateDraw(VkCommandBuffer) const;
+
+        // Points the late cull at a DepthPyramid, while no frame uses the set
+        void setDepthPyramid(VkImageView, VkSampler);
+
+        // Where the meshlets of the instance drawn for `key`, a scene node,
+        // keep their visibility bits from frame to frame. NO_VISIBILITY once
+        // the bits have run out, for the rest of the frame; the instance is
+        // then drawn without occlusion culling.
+        uint32_t visibilityOffset(uint32_t key, uint32_t meshletCount);
+
+        VkPipelineLayout drawLayout() const;
+
+        // What drawLayout() is made of besides the sets passed to init():
+        // setLayoutSignature() of set 0 and the push constants
+        uint64_t layoutSignature() const;
+        VkPushConstantRange drawPushConstants() const;
+        bool meshShaders() const;
+        bool occlusionCulling() const;
+        uint32_t maxInstances() const;
+
+        // Mesh shader workgroup size the device prefers, within 32 to 128
+        uint32_t meshGroupSize() const;
+
+    private:
+        struct VisibilityRange{
+            uint32_t    offset  = 0;
+            uint32_t    count   = 0;    // 0 for none yet
+        };
+
+        void recordDispatch(VkCommandBuffer, VkPipeline) const;
+
+        VkDevice                mDevice             = VK_NULL_HANDLE;
+        bool                    mMeshShaders        = false;
+        uint32_t                mMeshGroupSize      = 32;
+
+        VkDescriptorSetLayout   mSetLayout          = VK_NULL_HANDLE;
+        uint64_t                mSignature          = 0;
+        VkDescriptorPool        mPool               = VK_NULL_HANDLE;
+        VkDescriptorSet         mSet                = VK_NULL_HANDLE;
+        VkPipelineLayout        mCullLayout         = VK_NULL_HANDLE;
+        VkPipeline              mCullPipeline       = VK_NULL_HANDLE;
+        VkPipeline              mLateCullPipeline   = VK_NULL_HANDLE;
+        VkPipeline              mClampPipeline      = VK_NULL_HANDLE;
+        VkPipelineLayout        mDrawLayout         = VK_NULL_HANDLE;
+        VkShaderStageFlags      mDrawStages         = 0;
+        VkPushConstantRange     mDrawPushConstants  = {};
+
+        VkBuffer                mInstanceBuffer     = VK_NULL_HANDLE;
+        VkDeviceMemory          mInstanceMemory     = VK_NULL_HANDLE;
+        MeshletInstance*        mInstances          = nullptr;     // persistently mapped
+        VkBuffer                mSurvivorBuffer     = VK_NULL_HANDLE;
+        VkDeviceMemory          mSurvivorMemory     = VK_NULL_HANDLE;
+        VkBuffer                mIndexBuffer        = VK_NULL_HANDLE;
+        VkDeviceMemory          mIndexMemory        = VK_NULL_HANDLE;
+        VkBuffer                mDrawBuffer         = VK_NULL_HANDLE;     // one command per phase
+        VkDeviceMemory          mDrawMemory         = VK_NULL_HANDLE;
+
+        // Occlusion culling: a bit per meshlet, zeroed by the first cull
+        bool                    mOcclusionCulling   = false;
+        bool                    mVisibilityCleared  = false;
+        VkBuffer                mVisibilityBuffer   = VK_NULL_HANDLE;
+        VkDeviceMemory          mVisibilityMemory   = VK_NULL_HANDLE;
+        std::vector<VisibilityRange> mVisibilityRanges;    // per key
+        uint32_t                mVisibilityEnd      = 0;
+        bool                    mVisibilityFull     = false;    // start over after this frame
+
+        PFN_vkCmdDrawMeshTasksEXT mDrawMeshTasks    = nullptr;
+
+        uint32_t                mMaxInstances       = 0;
+        uint32_t                mMaxMeshletCount    = 0;   // most meshlets of any instance this frame
+        MeshletPushConstants    mConstants{};
+};
@@ -5,7 +5,8 @@ class MyApp : public App {
         MyApp(int, int, const char* title);
         void initDraw();
         void draw();
+        void processInput(const InputState&);
     private:
-        void processInput();
-        void processMouse();
+        void drawTimeline();
+        void processMouse(const InputState&);
 };
\ No newline at end of file
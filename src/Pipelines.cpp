@@ -0,0 +1,758 @@
+#include "Pipelines.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+static uint64_t hashKey(const std::string& key){
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(char c : key){
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static shaderc_shader_kind shaderKind(VkShaderStageFlagBits stage){
+    switch(stage){
+        case VK_SHADER_STAGE_VERTEX_BIT:    return shaderc_vertex_shader;
+        case VK_SHADER_STAGE_GEOMETRY_BIT:  return shaderc_geometry_shader;
+        case VK_SHADER_STAGE_FRAGMENT_BIT:  return shaderc_fragment_shader;
+        case VK_SHADER_STAGE_COMPUTE_BIT:   return shaderc_compute_shader;
+        case VK_SHADER_STAGE_TASK_BIT_EXT:  return shaderc_task_shader;
+        case VK_SHADER_STAGE_MESH_BIT_EXT:  return shaderc_mesh_shader;
+        default:
+            throw std::runtime_error("unsupported pipeline shader stage");
+    }
+}
+
+static bool endsWith(const std::string& text, const char* suffix){
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// Description
+// .............................................................................
+
+uint32_t shaderFloat(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+std::string GraphicsPipelineDesc::key(uint64_t layoutSignature) const{
+    std::string key = "layout=" + layout + ":" + std::to_string(layoutSignature);
+
+    for(const PipelineShader& shader : shaders){
+        key += " stage=" + std::to_string(shader.stage) + ":" + shader.path + ":";
+        for(size_t i = 0; i < shader.defines.size(); i++){
+            key += (i > 0 ? "," : "") + shader.defines[i];
+        }
+
+        // Belong to the stage before them, by id so the order they were
+        // given in doesn't matter
+        std::vector<ShaderConstant> constants = shader.constants;
+        std::sort(constants.begin(), constants.end(), [](const ShaderConstant& a, const ShaderConstant& b){
+            return a.id < b.id;
+        });
+        for(const ShaderConstant& constant : constants){
+            key += " constant=" + std::to_string(constant.id) + ":" + std::to_string(constant.value);
+        }
+    }
+
+    for(const VkVertexInputBindingDescription& binding : bindings){
+        key += " binding=" + std::to_string(binding.binding) + ":" +
+               std::to_string(binding.stride) + ":" +
+               std::to_string(binding.inputRate);
+    }
+
+    for(const VkVertexInputAttributeDescription& attribute : attributes){
+        key += " attribute=" + std::to_string(attribute.location) + ":" +
+               std::to_string(attribute.binding) + ":" +
+               std::to_string(attribute.format) + ":" +
+               std::to_string(attribute.offset);
+    }
+
+    key += " raster=" + std::to_string(cullMode) + ":" + std::to_string(frontFace);
+    if(depthBias != 0.0f || depthBiasSlope != 0.0f){
+        key += " bias=" + std::to_string(shaderFloat(depthBias)) + ":" + std::to_string(shaderFloat(depthBiasSlope));
+    }
+    key += " depth=" + std::to_string(depthTest) + ":" + std::to_string(depthWrite) + ":" + std::to_string(depthCompare);
+    key += " color=" + std::to_string(colorWriteMask);
+    key += " samples=" + std::to_string(samples);
+    key += " formats=" + std::to_string(colorFormat) + ":" + std::to_string(depthFormat);
+
+    return key;
+}
+
+static std::vector<std::string> split(const std::string& text, char separator){
+    std::vector<std::string> parts;
+
+    size_t start = 0;
+    while(true){
+        size_t end = text.find(separator, start);
+        parts.push_back(text.substr(start, end - start));
+        if(end == std::string::npos) break;
+        start = end + 1;
+    }
+
+    return parts;
+}
+
+// The numbers in a "a:b:c" value, false if there aren't exactly `count`
+static bool parseFields(const std::string& value, uint32_t* fields, size_t count){
+    std::vector<std::string> parts = split(value, ':');
+    if(parts.size() != count){
+        return false;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        char* end = nullptr;
+        fields[i] = static_cast<uint32_t>(strtoul(parts[i].c_str(), &end, 10));
+        if(parts[i].empty() || *end != '\0'){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool GraphicsPipelineDesc::parse(const std::string& key, GraphicsPipelineDesc& desc, uint64_t& layoutSignature){
+    desc = GraphicsPipelineDesc();
+    layoutSignature = 0;
+
+    std::istringstream tokens(key);
+    std::string token;
+    while(tokens >> token){
+        size_t equals = token.find('=');
+        if(equals == std::string::npos){
+            return false;
+        }
+
+        std::string name    = token.substr(0, equals);
+        std::string value   = token.substr(equals + 1);
+        uint32_t fields[4];
+
+        if(name == "layout"){
+            // Name, then the signature
+            size_t colon = value.rfind(':');
+            if(colon == std::string::npos){
+                return false;
+            }
+            desc.layout     = value.substr(0, colon);
+            layoutSignature = strtoull(value.c_str() + colon + 1, nullptr, 10);
+        } else if(name == "stage"){
+            // Path and defines are text, split off the stage and the defines
+            size_t first = value.find(':');
+            size_t last  = value.rfind(':');
+            if(first == std::string::npos || first == last){
+                return false;
+            }
+
+            PipelineShader shader;
+            shader.stage = static_cast<VkShaderStageFlagBits>(strtoul(value.substr(0, first).c_str(), nullptr, 10));
+            shader.path  = value.substr(first + 1, last - first - 1);
+            if(last + 1 < value.size()){
+                shader.defines = split(value.substr(last + 1), ',');
+            }
+            desc.shaders.push_back(shader);
+        } else if(name == "constant" && !desc.shaders.empty() && parseFields(value, fields, 2)){
+            desc.shaders.back().constants.push_back({fields[0], fields[1]});
+        } else if(name == "binding" && parseFields(value, fields, 3)){
+            desc.bindings.push_back({fields[0], fields[1], static_cast<VkVertexInputRate>(fields[2])});
+        } else if(name == "attribute" && parseFields(value, fields, 4)){
+            desc.attributes.push_back({fields[0], fields[1], static_cast<VkFormat>(fields[2]), fields[3]});
+        } else if(name == "raster" && parseFields(value, fields, 2)){
+            desc.cullMode   = fields[0];
+            desc.frontFace  = static_cast<VkFrontFace>(fields[1]);
+        } else if(name == "bias" && parseFields(value, fields, 2)){
+            memcpy(&desc.depthBias, &fields[0], sizeof(float));
+            memcpy(&desc.depthBiasSlope, &fields[1], sizeof(float));
+        } else if(name == "depth" && parseFields(value, fields, 3)){
+            desc.depthTest      = fields[0] != 0;
+            desc.depthWrite     = fields[1] != 0;
+            desc.depthCompare   = static_cast<VkCompareOp>(fields[2]);
+        } else if(name == "color" && parseFields(value, fields, 1)){
+            desc.colorWriteMask = fields[0];
+        } else if(name == "samples" && parseFields(value, fields, 1)){
+            desc.samples = static_cast<VkSampleCountFlagBits>(fields[0]);
+        } else if(name == "formats" && parseFields(value, fields, 2)){
+            desc.colorFormat = static_cast<VkFormat>(fields[0]);
+            desc.depthFormat = static_cast<VkFormat>(fields[1]);
+        } else {
+            return false;
+        }
+    }
+
+    // Anything that doesn't come back out the same isn't a key of ours
+    return desc.key(layoutSignature) == key;
+}
+
+// Library
+// .............................................................................
+
+void PipelineLibrary::init(VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass,
+                           const char* cachePath, const char* manifestPath, unsigned threads){
+    mDevice         = device;
+    mPhysicalDevice = physicalDevice;
+    mRenderPass     = renderPass;
+    mCachePath      = cachePath;
+    mManifestPath   = manifestPath;
+
+    loadCache();
+    loadManifest();
+
+    if(threads == 0){
+        threads = std::max(1u, std::thread::hardware_concurrency() / 4);
+    }
+
+    mRunning = true;
+    for(unsigned i = 0; i < threads; i++){
+        mThreads.emplace_back(&PipelineLibrary::compilerLoop, this);
+    }
+}
+
+void PipelineLibrary::cleanup(){
+    waitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mQueueWake.notify_all();
+
+    for(std::thread& thread : mThreads){
+        thread.join();
+    }
+    mThreads.clear();
+
+    saveCache();
+    saveManifest();
+
+    for(std::unique_ptr<Entry>& entry : mEntries){
+        vkDestroyPipeline(mDevice, entry->pipeline.load(), nullptr);
+    }
+    mEntries.clear();
+    mLookup.clear();
+    mLayouts.clear();
+    mManifest.clear();
+
+    vkDestroyPipelineCache(mDevice, mCache, nullptr);
+    mCache = VK_NULL_HANDLE;
+}
+
+void PipelineLibrary::addLayout(const std::string& name, VkPipelineLayout layout, uint64_t signature){
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLayouts[name] = {layout, signature};
+}
+
+std::string PipelineLibrary::keyOf(const GraphicsPipelineDesc& desc) const{
+    uint64_t signature = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mLayouts.find(desc.layout);
+        if(it != mLayouts.end()){
+            signature = it->second.signature;
+        }
+    }
+    return desc.key(signature);
+}
+
+PipelineId PipelineLibrary::request(const GraphicsPipelineDesc& desc){
+    std::string key = keyOf(desc);
+    uint64_t hash   = hashKey(key);
+
+    PipelineId id;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        id = find(key, hash);
+        if(id != INVALID_PIPELINE){
+            return id;
+        }
+
+        id = insert(desc, std::move(key), hash);
+        mQueue.push_back(id);
+    }
+
+    mQueueWake.notify_one();
+    return id;
+}
+
+PipelineId PipelineLibrary::build(const GraphicsPipelineDesc& desc){
+    std::string key = keyOf(desc);
+    uint64_t hash   = hashKey(key);
+
+    PipelineId id;
+    Entry* target;
+    bool compileHere = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        id = find(key, hash);
+        if(id == INVALID_PIPELINE){
+            id = insert(desc, std::move(key), hash);
+            compileHere = true;
+        }
+        target = mEntries[id].get();
+    }
+
+    if(compileHere){
+        // Not queued, nobody else will pick it up
+        try{
+            compile(*target);
+        } catch(...){
+            target->state.store(State::Failed, std::memory_order_release);
+            finish();
+            throw;
+        }
+        finish();
+        return id;
+    }
+
+    // Someone else has it, queued or compiling
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleWake.wait(lock, [target](){
+        return target->state.load(std::memory_order_acquire) != State::Queued;
+    });
+
+    return id;
+}
+
+VkPipeline PipelineLibrary::get(PipelineId id) const{
+    Entry* target = entry(id);
+    if(target == nullptr){
+        return VK_NULL_HANDLE;
+    }
+    return target->pipeline.load(std::memory_order_acquire);
+}
+
+bool PipelineLibrary::ready(PipelineId id) const{
+    Entry* target = entry(id);
+    return target != nullptr && target->state.load(std::memory_order_acquire) == State::Ready;
+}
+
+void PipelineLibrary::waitIdle(){
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleWake.wait(lock, [this](){
+        return mQueue.empty() && mCompiling == 0;
+    });
+}
+
+size_t PipelineLibrary::warmUp(JobSystem& jobs){
+    std::vector<GraphicsPipelineDesc> missing;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for(auto it = mManifest.begin(); it != mManifest.end();){
+            const std::string& key = *it;
+            GraphicsPipelineDesc desc;
+            uint64_t signature;
+            if(find(key, hashKey(key)) != INVALID_PIPELINE){
+                ++it;
+                continue;
+            }
+
+            // Not a key, or one from before layouts had signatures
+            if(!GraphicsPipelineDesc::parse(key, desc, signature)){
+                it = mManifest.erase(it);
+                continue;
+            }
+
+            // Layouts this run doesn't use, e.g. meshlets turned off; left in
+            // the manifest for the runs that do
+            auto layout = mLayouts.find(desc.layout);
+            if(layout == mLayouts.end()){
+                ++it;
+                continue;
+            }
+
+            // Made for sets or push constants the layout no longer has
+            if(layout->second.signature != signature){
+                it = mManifest.erase(it);
+                continue;
+            }
+
+            missing.push_back(std::move(desc));
+            ++it;
+        }
+    }
+
+    // Compiled on the calling threads, nothing else runs while warming up
+    jobs.parallelFor("pipeline warm-up", missing.size(), 1, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; i++){
+            try{
+                build(missing[i]);
+            } catch(const std::exception& error){
+                std::cerr << "failed to warm up pipeline " << keyOf(missing[i]) << ": " << error.what() << std::endl;
+            }
+        }
+    });
+
+    // Whatever was requested in the meantime
+    waitIdle();
+
+    return missing.size();
+}
+
+size_t PipelineLibrary::size() const{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+size_t PipelineLibrary::pending() const{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mQueue.size() + mCompiling;
+}
+
+PipelineId PipelineLibrary::find(const std::string& key, uint64_t hash) const{
+    // Keys that collide share a hash, every entry under it is compared
+    auto [first, last] = mLookup.equal_range(hash);
+    for(auto it = first; it != last; ++it){
+        if(mEntries[it->second]->key == key){
+            return it->second;
+        }
+    }
+    return INVALID_PIPELINE;
+}
+
+PipelineId PipelineLibrary::insert(const GraphicsPipelineDesc& desc, std::string key, uint64_t hash){
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    entry->desc = desc;
+    entry->key  = std::move(key);
+    mEntries.push_back(std::move(entry));
+
+    PipelineId id = static_cast<PipelineId>(mEntries.size() - 1);
+    mLookup.emplace(hash, id);
+
+    return id;
+}
+
+PipelineLibrary::Entry* PipelineLibrary::entry(PipelineId id) const{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return id < mEntries.size() ? mEntries[id].get() : nullptr;
+}
+
+void PipelineLibrary::finish(){
+    // Through the mutex, so a waiter can't check its predicate in between
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mIdleWake.notify_all();
+}
+
+void PipelineLibrary::compilerLoop(){
+    while(true){
+        Entry* target;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQueueWake.wait(lock, [this](){
+                return !mRunning || !mQueue.empty();
+            });
+
+            if(mQueue.empty()){
+                return;
+            }
+
+            target = mEntries[mQueue.front()].get();
+            mQueue.pop_front();
+            mCompiling++;
+        }
+
+        try{
+            compile(*target);
+        } catch(const std::exception& error){
+            std::cerr << "failed to compile pipeline " << target->key << ": " << error.what() << std::endl;
+            target->state.store(State::Failed, std::memory_order_release);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCompiling--;
+        }
+        mIdleWake.notify_all();
+    }
+}
+
+// Runs on any thread: shader compilation, module and pipeline creation are
+// all free threaded, and the pipeline cache synchronises itself
+void PipelineLibrary::compile(Entry& target){
+    const GraphicsPipelineDesc& desc = target.desc;
+
+    VkPipelineLayout layout;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mLayouts.find(desc.layout);
+        if(it == mLayouts.end()){
+            throw std::runtime_error("unknown pipeline layout " + desc.layout);
+        }
+        layout = it->second.layout;
+    }
+
+    std::vector<VkShaderModule> modules;
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    bool meshShading = false;
+
+    // Pointed to by the stages, sized up front so nothing moves
+    std::vector<VkSpecializationInfo> specializations(desc.shaders.size());
+    std::vector<std::vector<VkSpecializationMapEntry>> specializationEntries(desc.shaders.size());
+
+    auto destroyModules = [&](){
+        for(VkShaderModule module : modules){
+            vkDestroyShaderModule(mDevice, module, nullptr);
+        }
+    };
+
+    try{
+        for(const PipelineShader& shader : desc.shaders){
+            if(endsWith(shader.path, ".spv")){
+                modules.push_back(createShaderModule(mDevice, readFile(shader.path.c_str())));
+            } else {
+                modules.push_back(createShaderModule(mDevice, compileShader(shader.path.c_str(), shaderKind(shader.stage), shader.defines)));
+            }
+
+            VkPipelineShaderStageCreateInfo stageInfo{};
+            stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stageInfo.stage = shader.stage;
+            stageInfo.module = modules.back();
+            stageInfo.pName = "main";
+
+            if(!shader.constants.empty()){
+                size_t index = stages.size();
+
+                // Entries point into the stage's own constants, which outlive the create call
+                for(size_t i = 0; i < shader.constants.size(); i++){
+                    VkSpecializationMapEntry entry{};
+                    entry.constantID = shader.constants[i].id;
+                    entry.offset = static_cast<uint32_t>(i * sizeof(ShaderConstant) + offsetof(ShaderConstant, value));
+                    entry.size = sizeof(uint32_t);
+                    specializationEntries[index].push_back(entry);
+                }
+
+                VkSpecializationInfo& specialization = specializations[index];
+                specialization.mapEntryCount = static_cast<uint32_t>(specializationEntries[index].size());
+                specialization.pMapEntries = specializationEntries[index].data();
+                specialization.dataSize = shader.constants.size() * sizeof(ShaderConstant);
+                specialization.pData = shader.constants.data();
+
+                stageInfo.pSpecializationInfo = &specialization;
+            }
+
+            stages.push_back(stageInfo);
+
+            meshShading |= shader.stage == VK_SHADER_STAGE_MESH_BIT_EXT;
+        }
+    } catch(...){
+        destroyModules();
+        throw;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Counts only, the rectangles are set while recording
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = desc.cullMode;
+    rasterizer.frontFace = desc.frontFace;
+    rasterizer.depthBiasEnable = desc.depthBias != 0.0f || desc.depthBiasSlope != 0.0f ? VK_TRUE : VK_FALSE;
+    rasterizer.depthBiasConstantFactor = desc.depthBias;
+    rasterizer.depthBiasSlopeFactor = desc.depthBiasSlope;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = desc.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depthCompare;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = desc.colorWriteMask;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = desc.colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+    pipelineInfo.pStages = stages.data();
+    pipelineInfo.pVertexInputState = meshShading ? nullptr : &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = meshShading ? nullptr : &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = mRenderPass;
+    pipelineInfo.subpass = 0;
+
+    // Without a render pass the attachment formats are given to the pipeline directly
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = desc.colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+    renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+    renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+    if(mRenderPass == VK_NULL_HANDLE){
+        pipelineInfo.pNext = &renderingInfo;
+    }
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(mDevice, mCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    destroyModules();
+
+    if(result != VK_SUCCESS){
+        throw std::runtime_error("failed to create graphics pipeline");
+    }
+
+    target.pipeline.store(pipeline, std::memory_order_release);
+    target.state.store(State::Ready, std::memory_order_release);
+}
+
+// Pipeline cache and manifest on disk
+// .............................................................................
+
+void PipelineLibrary::loadManifest(){
+    std::ifstream file(std::string(logl_root) + mManifestPath);
+
+    std::string line;
+    while(std::getline(file, line)){
+        if(line.empty() || line[0] == '#') continue;
+        mManifest.insert(line);
+    }
+}
+
+void PipelineLibrary::saveManifest() const{
+    std::set<std::string> keys = mManifest;
+
+    // This session's pipelines, and earlier ones it found broken dropped
+    for(const std::unique_ptr<Entry>& entry : mEntries){
+        if(entry->state.load(std::memory_order_acquire) == State::Failed){
+            keys.erase(entry->key);
+        } else {
+            keys.insert(entry->key);
+        }
+    }
+
+    std::filesystem::path path = std::string(logl_root) + mManifestPath;
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::ofstream file(path);
+    if(!file){
+        std::cerr << "Failed to write pipeline manifest " << path << std::endl;
+        return;
+    }
+
+    file << "# Pipeline keys seen so far, compiled up front by PipelineLibrary::warmUp\n";
+    for(const std::string& key : keys){
+        file << key << "\n";
+    }
+}
+
+void PipelineLibrary::loadCache(){
+    std::vector<char> data;
+
+    std::string path = logl_root + mCachePath;
+    FILE* f = fopen(path.c_str(), "rb");
+    if(f != nullptr){
+        fclose(f);
+        data = readFile(mCachePath.c_str());
+    }
+
+    // Drivers reject foreign caches themselves, but not all of them gracefully
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+
+    VkPipelineCacheHeaderVersionOne header{};
+    if(data.size() >= sizeof(header)){
+        memcpy(&header, data.data(), sizeof(header));
+    }
+
+    bool valid = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                 header.vendorID == properties.vendorID &&
+                 header.deviceID == properties.deviceID &&
+                 memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if(valid){
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.data();
+    }
+
+    if(vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mCache) != VK_SUCCESS){
+        throw std::runtime_error("failed to create pipeline cache");
+    }
+}
+
+void PipelineLibrary::saveCache() const{
+    size_t size = 0;
+    if(vkGetPipelineCacheData(mDevice, mCache, &size, nullptr) != VK_SUCCESS || size == 0){
+        return;
+    }
+
+    std::vector<char> data(size);
+    if(vkGetPipelineCacheData(mDevice, mCache, &size, data.data()) != VK_SUCCESS){
+        return;
+    }
+
+    std::filesystem::path path = std::string(logl_root) + mCachePath;
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    FILE* f = fopen(path.string().c_str(), "wb");
+    if(f == nullptr){
+        std::cerr << "Failed to write pipeline cache " << path << std::endl;
+        return;
+    }
+    fwrite(data.data(), 1, size, f);
+    fclose(f);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "Jobs.hpp"
+
+using PipelineId = uint32_t;
+
+const PipelineId INVALID_PIPELINE = UINT32_MAX;
+
+// Value of a `layout(constant_id = id)` constant, as its 32 bits: bools are
+// 0 or 1, floats go through shaderFloat()
+struct ShaderConstant{
+    uint32_t id     = 0;
+    uint32_t value  = 0;
+};
+
+uint32_t shaderFloat(float);
+
+// A shader stage by source: GLSL compiled with shaderc when the pipeline is
+// built, or a prebuilt blob when the path ends in .spv. Paths are relative to
+// the project root like every other asset.
+//
+// Defines make a new shader, constants only a new pipeline from the same
+// SPIR-V: the driver folds them in and strips the branches they turn off.
+// Feature toggles and loop bounds go in constants, defines are for what
+// changes the interface (inputs, bindings, extensions).
+struct PipelineShader{
+    VkShaderStageFlagBits       stage   = VK_SHADER_STAGE_VERTEX_BIT;
+    std::string                 path;
+    std::vector<std::string>    defines;
+    std::vector<ShaderConstant> constants;
+};
+
+/**
+ * Everything that tells two graphics pipelines apart. Viewport and scissor
+ * are dynamic so the target size never makes a new pipeline. Without a mesh
+ * stage an empty binding list still means vertex input, just none fetched.
+**/
+
+struct GraphicsPipelineDesc{
+    std::vector<PipelineShader>                     shaders;            // fragment, if any, last
+    std::string                                     layout;             // as given to PipelineLibrary::addLayout
+
+    std::vector<VkVertexInputBindingDescription>    bindings;
+    std::vector<VkVertexInputAttributeDescription>  attributes;
+
+    VkCullModeFlags         cullMode        = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace             frontFace       = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    // Depth bias in units of the format's smallest step, plus per unit of
+    // depth slope; off while both are 0
+    float                   depthBias       = 0.0f;
+    float                   depthBiasSlope  = 0.0f;
+
+    bool                    depthTest       = true;
+    bool                    depthWrite      = true;
+    VkCompareOp             depthCompare    = VK_COMPARE_OP_LESS;
+
+    VkColorComponentFlags   colorWriteMask  = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkSampleCountFlagBits   samples         = VK_SAMPLE_COUNT_1_BIT;
+
+    VkFormat                colorFormat     = VK_FORMAT_UNDEFINED;
+    VkFormat                depthFormat     = VK_FORMAT_UNDEFINED;
+
+    // Canonical text of all of the above and the signature of the layout
+    // it names, equal descriptions give equal keys
+    std::string key(uint64_t layoutSignature) const;
+
+    // Back from key(), false when the text isn't one
+    static bool parse(const std::string& key, GraphicsPipelineDesc&, uint64_t& layoutSignature);
+};
+
+/**
+ * Owns every graphics pipeline and hands out one per distinct description:
+ * asking again for a description it has seen returns the same pipeline.
+ *
+ * New pipelines are compiled by the library's own background threads, never
+ * on the frame's job threads where a 50 ms compile would stall a frame that
+ * helps out with jobs. Until get() returns a pipeline the caller draws with
+ * a fallback it built up front, or skips the draw.
+ *
+ * Everything goes through one VkPipelineCache, loaded from and saved to disk
+ * so later runs skip the driver's backend compile. That cache is per driver
+ * though, so the library also keeps a manifest: the key of every pipeline a
+ * session used, added to what earlier sessions recorded. warmUp() compiles
+ * all of them up front, and a fresh install or driver update takes its
+ * compile hit at startup instead of mid frame.
+**/
+
+class PipelineLibrary{
+    public:
+        // `renderPass` is VK_NULL_HANDLE with dynamic rendering. 0 threads = a
+        // quarter of the cores, at least one.
+        void init(VkDevice, VkPhysicalDevice, VkRenderPass renderPass,
+                  const char* cachePath, const char* manifestPath, unsigned threads = 0);
+
+        // Waits for compiles in flight, saves cache and manifest and destroys everything
+        void cleanup();
+
+        // Layouts are referenced by name so descriptions stay plain data.
+        // `signature`, pipelineLayoutSignature() of what the layout was made
+        // from, goes into every key: manifest pipelines of a layout that has
+        // changed since are dropped instead of built against the new one.
+        void addLayout(const std::string& name, VkPipelineLayout, uint64_t signature);
+
+        // Returns at once, compiling in the background on a miss
+        PipelineId request(const GraphicsPipelineDesc&);
+
+        // Returns once the pipeline exists, for fallbacks and the like
+        PipelineId build(const GraphicsPipelineDesc&);
+
+        // VK_NULL_HANDLE until compiled, and for pipelines that failed to compile
+        VkPipeline get(PipelineId) const;
+        bool ready(PipelineId) const;
+
+        // Blocks until nothing is queued or compiling
+        void waitIdle();
+
+        // Compiles every manifest pipeline not in the library yet, spread over
+        // all of the job system's threads, and returns how many. Only layouts
+        // added so far count, pipelines of others wait for a run that adds
+        // them. Ones that fail to compile, or whose layout has a different
+        // signature now, drop out of the manifest.
+        size_t warmUp(JobSystem&);
+
+        size_t size() const;
+        size_t pending() const;
+
+        void saveCache() const;
+        void saveManifest() const;
+
+    private:
+        enum class State : uint32_t{
+            Queued,
+            Ready,
+            Failed
+        };
+
+        struct Layout{
+            VkPipelineLayout        layout      = VK_NULL_HANDLE;
+            uint64_t                signature   = 0;
+        };
+
+        struct Entry{
+            GraphicsPipelineDesc    desc;
+            std::string             key;
+            std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+            std::atomic<State>      state{State::Queued};
+        };
+
+        // Locks the mutex for the layout's signature
+        std::string keyOf(const GraphicsPipelineDesc&) const;
+
+        // With the mutex held
+        PipelineId find(const std::string& key, uint64_t hash) const;
+        PipelineId insert(const GraphicsPipelineDesc&, std::string key, uint64_t hash);
+
+        Entry* entry(PipelineId) const;
+        void compile(Entry&);
+        void finish();
+        void compilerLoop();
+        void loadCache();
+        void loadManifest();
+
+        VkDevice                                    mDevice         = VK_NULL_HANDLE;
+        VkPhysicalDevice                            mPhysicalDevice = VK_NULL_HANDLE;
+        VkRenderPass                                mRenderPass     = VK_NULL_HANDLE;
+        VkPipelineCache                             mCache          = VK_NULL_HANDLE;
+        std::string                                 mCachePath;
+        std::string                                 mManifestPath;
+        std::set<std::string>                       mManifest;      // keys from earlier sessions
+
+        // Guards the entries, the lookup and the layouts; compiled pipelines
+        // are published through each entry's atomics
+        mutable std::mutex                          mMutex;
+        std::vector<std::unique_ptr<Entry>>         mEntries;
+        std::unordered_multimap<uint64_t, PipelineId> mLookup;      // by hash of the key
+        std::unordered_map<std::string, Layout>     mLayouts;
+
+        std::vector<std::thread>                    mThreads;
+        std::deque<PipelineId>                      mQueue;
+        std::condition_variable                     mQueueWake;
+        std::condition_variable                     mIdleWake;
+        uint32_t                                    mCompiling      = 0;
+        bool                                        mRunning        = false;
+};
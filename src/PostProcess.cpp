@@ -0,0 +1,370 @@
+#include "PostProcess.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+// Matches PostConstants in shader/post_common.glsl
+struct PostPushConstants{
+    float       params[4];
+    uint32_t    flags;
+};
+
+// Matches the POST_ flags in shader/post_common.glsl
+static const uint32_t POST_PREFILTER    = 1;    // bloom down: keep only what's over the threshold
+static const uint32_t POST_ENCODE       = 2;    // tonemap: sRGB encode the output
+static const uint32_t POST_DECODE       = 4;    // FXAA: back to linear, for an sRGB swapchain to encode
+
+// Formats between tonemapping and the swapchain. The display image is float
+// so an sRGB swapchain can do the encoding in the blit without banding.
+static const VkFormat LDR_FORMAT        = VK_FORMAT_R8G8B8A8_UNORM;
+static const VkFormat DISPLAY_FORMAT    = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+struct KernelInfo{
+    const char* path;
+    const char* define;
+    uint32_t    groupSize;      // square workgroups, local_size in the shader
+};
+
+static const KernelInfo KERNELS[] = {
+    {"/shader/post_upscale.comp",       nullptr,            8},
+    {"/shader/post_bloom_down.comp",    nullptr,            8},
+    {"/shader/post_bloom_up.comp",      nullptr,            8},
+    {"/shader/post_tonemap.comp",       nullptr,            8},
+    {"/shader/post_tonemap.comp",       "DISPLAY_TARGET",   8},
+    {"/shader/post_fxaa.comp",          nullptr,            16}
+};
+
+static bool isSrgb(VkFormat format){
+    switch(format){
+        case VK_FORMAT_R8G8B8_SRGB:
+        case VK_FORMAT_B8G8R8_SRGB:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool PostProcess::supported(VkPhysicalDevice physicalDevice, VkFormat outputFormat){
+    VkFormatProperties output;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, outputFormat, &output);
+
+    // Storage, blit source and linear filtering of RGBA16F are required
+    // everywhere, rendering to it nearly so
+    VkFormatProperties hdr;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, HDR_FORMAT, &hdr);
+
+    VkFormatFeatureFlags hdrFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                                       VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                                       VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                       VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+
+    return (output.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) &&
+           (hdr.optimalTilingFeatures & hdrFeatures) == hdrFeatures;
+}
+
+void PostProcess::init(VkDevice device, VkFormat outputFormat, uint32_t framesInFlight){
+    mDevice     = device;
+    mSrgbOutput = isSrgb(outputFormat);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType           = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter       = VK_FILTER_LINEAR;
+    samplerInfo.minFilter       = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode      = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod          = 0.0f;
+
+    if(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler) != VK_SUCCESS){
+        throw std::runtime_error("failed to create post process sampler");
+    }
+
+    // Descriptors
+    // .........................................................................
+
+    // Two sampled inputs and the storage image written
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for(uint32_t i = 0; i < 3; i++){
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create post process descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount    = MAX_DISPATCHES * 2;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount    = MAX_DISPATCHES;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = MAX_DISPATCHES;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+
+    mPools.resize(framesInFlight);
+    for(VkDescriptorPool& pool : mPools){
+        if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create post process descriptor pool");
+        }
+    }
+
+    // Pipelines
+    // .........................................................................
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(PostPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &mSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    if(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create post process pipeline layout");
+    }
+
+    for(uint32_t k = 0; k < KERNEL_COUNT; k++){
+        std::vector<std::string> defines;
+        if(KERNELS[k].define){
+            defines.push_back(KERNELS[k].define);
+        }
+
+        VkShaderModule shaderModule = createShaderModule(mDevice, compileShader(KERNELS[k].path, shaderc_compute_shader, defines));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module   = shaderModule;
+        pipelineInfo.stage.pName    = "main";
+        pipelineInfo.layout         = mLayout;
+
+        if(vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mPipelines[k]) != VK_SUCCESS){
+            throw std::runtime_error("failed to create post process pipeline");
+        }
+
+        vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    }
+}
+
+void PostProcess::cleanup(){
+    for(VkPipeline pipeline : mPipelines){
+        vkDestroyPipeline(mDevice, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(mDevice, mLayout, nullptr);
+
+    for(VkDescriptorPool pool : mPools){
+        vkDestroyDescriptorPool(mDevice, pool, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    vkDestroySampler(mDevice, mSampler, nullptr);
+}
+
+void PostProcess::addPasses(RenderGraph& graph, uint32_t frame,
+                            GraphResource hdr, VkExtent2D renderExtent,
+                            GraphResource output, VkExtent2D extent){
+    mGraph          = &graph;
+    mFrame          = frame;
+    mDispatchCount  = 0;
+
+    // The slot's last frame is done with its sets
+    vkResetDescriptorPool(mDevice, mPools[frame], 0);
+
+    // Everything after works at full resolution
+    if(settings.upscale || renderExtent.width != extent.width || renderExtent.height != extent.height){
+        GraphResource upscaled = graph.createImage("upscaled", {HDR_FORMAT, extent});
+
+        Dispatch dispatch;
+        dispatch.kernel     = Upscale;
+        dispatch.source     = hdr;
+        dispatch.target     = upscaled;
+        dispatch.extent     = extent;
+        dispatch.params[0]  = static_cast<float>(renderExtent.width);
+        dispatch.params[1]  = static_cast<float>(renderExtent.height);
+        dispatch.params[2]  = std::clamp(settings.sharpness, 0.0f, 1.0f);
+        addDispatch(graph, "upscale", dispatch);
+
+        hdr = upscaled;
+    }
+
+    // Bloom, down to the smallest level and back up to the largest
+    uint32_t levels = std::clamp(settings.bloomLevels, 1u, MAX_BLOOM_LEVELS);
+
+    GraphResource down[MAX_BLOOM_LEVELS];
+    VkExtent2D sizes[MAX_BLOOM_LEVELS];
+
+    for(uint32_t i = 0; i < levels; i++){
+        VkExtent2D above = i == 0 ? extent : sizes[i - 1];
+        sizes[i]    = {std::max(above.width / 2, 1u), std::max(above.height / 2, 1u)};
+        down[i]     = graph.createImage("bloom down", {HDR_FORMAT, sizes[i]});
+
+        Dispatch dispatch;
+        dispatch.kernel     = BloomDown;
+        dispatch.source     = i == 0 ? hdr : down[i - 1];
+        dispatch.target     = down[i];
+        dispatch.extent     = sizes[i];
+        dispatch.params[0]  = settings.bloomThreshold;
+        dispatch.params[1]  = settings.bloomKnee;
+        dispatch.flags      = i == 0 ? POST_PREFILTER : 0;
+        addDispatch(graph, "bloom down", dispatch);
+    }
+
+    GraphResource bloom = down[levels - 1];
+    for(uint32_t i = levels - 1; i-- > 0;){
+        GraphResource up = graph.createImage("bloom up", {HDR_FORMAT, sizes[i]});
+
+        Dispatch dispatch;
+        dispatch.kernel     = BloomUp;
+        dispatch.source     = down[i];
+        dispatch.second     = bloom;
+        dispatch.target     = up;
+        dispatch.extent     = sizes[i];
+        addDispatch(graph, "bloom up", dispatch);
+
+        bloom = up;
+    }
+
+    // Tonemap, then FXAA on the display encoded result
+    mDisplay = graph.createImage("display", {DISPLAY_FORMAT, extent});
+
+    Dispatch tonemap;
+    tonemap.source      = hdr;
+    tonemap.second      = bloom;
+    tonemap.extent      = extent;
+    tonemap.params[0]   = settings.exposure;
+    tonemap.params[1]   = settings.bloomIntensity;
+
+    if(settings.fxaa){
+        GraphResource ldr = graph.createImage("ldr", {LDR_FORMAT, extent});
+
+        tonemap.kernel  = Tonemap;
+        tonemap.target  = ldr;
+        tonemap.flags   = POST_ENCODE;
+        addDispatch(graph, "tonemap", tonemap);
+
+        Dispatch fxaa;
+        fxaa.kernel     = Fxaa;
+        fxaa.source     = ldr;
+        fxaa.target     = mDisplay;
+        fxaa.extent     = extent;
+        fxaa.params[0]  = settings.fxaaThreshold;
+        fxaa.params[1]  = settings.fxaaMinimum;
+        fxaa.flags      = mSrgbOutput ? POST_DECODE : 0;
+        addDispatch(graph, "fxaa", fxaa);
+    } else {
+        tonemap.kernel  = TonemapDisplay;
+        tonemap.target  = mDisplay;
+        tonemap.flags   = mSrgbOutput ? 0 : POST_ENCODE;
+        addDispatch(graph, "tonemap", tonemap);
+    }
+
+    mOutput = output;
+    mExtent = extent;
+
+    GraphPass copy = graph.addPass("post copy", [this](VkCommandBuffer commandBuffer){
+        recordCopy(commandBuffer);
+    });
+    graph.read(copy, mDisplay, GraphUsage::Transfer);
+    graph.write(copy, output, GraphUsage::Transfer);
+}
+
+void PostProcess::addDispatch(RenderGraph& graph, const char* name, const Dispatch& dispatch){
+    uint32_t index = mDispatchCount++;
+    mDispatches[index] = dispatch;
+
+    // Small enough a capture for std::function to keep inline
+    GraphPass pass = graph.addPass(name, [this, index](VkCommandBuffer commandBuffer){
+        record(commandBuffer, mDispatches[index]);
+    });
+
+    graph.read(pass, dispatch.source, GraphUsage::SampledCompute);
+    if(dispatch.second != INVALID_GRAPH_RESOURCE){
+        graph.read(pass, dispatch.second, GraphUsage::SampledCompute);
+    }
+    graph.write(pass, dispatch.target, GraphUsage::StorageCompute);
+}
+
+void PostProcess::record(VkCommandBuffer commandBuffer, const Dispatch& dispatch){
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool        = mPools[mFrame];
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &mSetLayout;
+
+    VkDescriptorSet set;
+    if(vkAllocateDescriptorSets(mDevice, &allocInfo, &set) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate post process descriptor set");
+    }
+
+    // Kernels without a second input don't declare it, so it stays unwritten
+    VkDescriptorImageInfo imageInfos[3]{};
+    imageInfos[0] = {mSampler, mGraph->view(dispatch.source), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    if(dispatch.second != INVALID_GRAPH_RESOURCE){
+        imageInfos[1] = {mSampler, mGraph->view(dispatch.second), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+    imageInfos[2] = {VK_NULL_HANDLE, mGraph->view(dispatch.target), VK_IMAGE_LAYOUT_GENERAL};
+
+    VkWriteDescriptorSet writes[3]{};
+    uint32_t writeCount = 0;
+    for(uint32_t i = 0; i < 3; i++){
+        if(imageInfos[i].imageView == VK_NULL_HANDLE) continue;
+
+        VkWriteDescriptorSet& write = writes[writeCount++];
+        write.sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet            = set;
+        write.dstBinding        = i;
+        write.descriptorCount   = 1;
+        write.descriptorType    = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo        = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(mDevice, writeCount, writes, 0, nullptr);
+
+    PostPushConstants constants{};
+    std::copy(dispatch.params, dispatch.params + 4, constants.params);
+    constants.flags = dispatch.flags;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelines[dispatch.kernel]);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mLayout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, mLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostPushConstants), &constants);
+
+    uint32_t groupSize = KERNELS[dispatch.kernel].groupSize;
+    vkCmdDispatch(commandBuffer,
+                  (dispatch.extent.width + groupSize - 1) / groupSize,
+                  (dispatch.extent.height + groupSize - 1) / groupSize,
+                  1);
+}
+
+void PostProcess::recordCopy(VkCommandBuffer commandBuffer){
+    VkImageBlit region{};
+    region.srcSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffsets[1]    = {static_cast<int32_t>(mExtent.width), static_cast<int32_t>(mExtent.height), 1};
+    region.dstSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffsets[1]    = region.srcOffsets[1];
+
+    // Same size, the blit only converts the format
+    vkCmdBlitImage(commandBuffer,
+                   mGraph->image(mDisplay), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   mGraph->image(mOutput), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &region, VK_FILTER_NEAREST);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "RenderGraph.hpp"
+
+// Tunables of the chain, read every frame
+struct PostSettings{
+    bool        upscale         = false;    // even at full resolution, so the passes don't change with the scale
+    float       sharpness       = 0.5f;     // of the upscale from a lower render resolution, 0 to 1
+    float       exposure        = 1.0f;
+    float       bloomThreshold  = 1.0f;     // brightest channel where bloom starts
+    float       bloomKnee       = 0.5f;     // width of the soft ramp up to the threshold
+    float       bloomIntensity  = 0.05f;
+    uint32_t    bloomLevels     = 5;        // halvings below full resolution, 1 to 8
+    bool        fxaa            = true;
+    float       fxaaThreshold   = 0.125f;   // local contrast that counts as an edge, relative
+    float       fxaaMinimum     = 0.0312f;  // and absolute, so dark noise isn't smoothed
+};
+
+/**
+ * Takes the HDR scene to the display in compute passes:
+ *
+ *  - with the scene rendered at a lower resolution, or `upscale` set,
+ *    upscales it first: bilinear between contrast adaptive sharpened texels
+ *    (CAS), on values squeezed into [0, 1) so bright ones don't ring. The
+ *    texels under a workgroup and their borders come through shared memory,
+ *  - bloom downsamples the scene's bright parts through half sized levels.
+ *    Each texel is a 4x4 tent over the level above; neighbours' footprints
+ *    overlap, so a workgroup fetches its 18x18 source texels into shared
+ *    memory once instead of up to four times each,
+ *  - upsamples back up, each level adding a tent filtered copy of the one
+ *    below, so the widest blur comes from the smallest image,
+ *  - tonemaps scene plus bloom (ACES fit) and encodes for display,
+ *  - FXAA, with the luma of a workgroup's pixels and their one pixel border
+ *    in shared memory for edge detection,
+ *  - blits to the swapchain image, whose formats rarely take storage writes.
+ *
+ * Every step is a render graph pass with its own name, which the GPU profiler
+ * times; the graph places the bloom levels in the memory of ones it's done
+ * with. Descriptors are written per frame, from a pool per frame in flight,
+ * so they always point at the graph's current images.
+**/
+
+class PostProcess{
+    public:
+        static constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+        static constexpr uint32_t MAX_BLOOM_LEVELS = 8;
+
+        // Whether the chain can end in `outputFormat`, which it blits into
+        static bool supported(VkPhysicalDevice, VkFormat outputFormat);
+
+        void init(VkDevice, VkFormat outputFormat, uint32_t framesInFlight);
+        void cleanup();
+
+        // Adds the passes from `hdr` to `output`, both `extent` sized, with
+        // the scene in the top left `renderExtent` of `hdr`. Between
+        // RenderGraph::begin() and compile(), once the frame's slot is free.
+        void addPasses(RenderGraph&, uint32_t frame,
+                       GraphResource hdr, VkExtent2D renderExtent,
+                       GraphResource output, VkExtent2D extent);
+
+        PostSettings settings;
+
+    private:
+        enum Kernel : uint32_t{
+            Upscale,
+            BloomDown,
+            BloomUp,
+            Tonemap,            // for FXAA: gamma encoded RGBA8 with luma in alpha
+            TonemapDisplay,     // straight to the display image
+            Fxaa,
+            KERNEL_COUNT
+        };
+
+        // One compute pass, what its record callback reads
+        struct Dispatch{
+            Kernel          kernel  = BloomDown;
+            GraphResource   source  = INVALID_GRAPH_RESOURCE;
+            GraphResource   second  = INVALID_GRAPH_RESOURCE;
+            GraphResource   target  = INVALID_GRAPH_RESOURCE;
+            VkExtent2D      extent  = {0, 0};
+            float           params[4]{};
+            uint32_t        flags   = 0;
+        };
+
+        // Upscale, bloom levels twice, tonemap, FXAA
+        static constexpr uint32_t MAX_DISPATCHES = MAX_BLOOM_LEVELS * 2 + 3;
+
+        void addDispatch(RenderGraph&, const char* name, const Dispatch&);
+        void record(VkCommandBuffer, const Dispatch&);
+        void recordCopy(VkCommandBuffer);
+
+        VkDevice                        mDevice         = VK_NULL_HANDLE;
+        bool                            mSrgbOutput     = false;
+        VkSampler                       mSampler        = VK_NULL_HANDLE;
+        VkDescriptorSetLayout           mSetLayout      = VK_NULL_HANDLE;
+        VkPipelineLayout                mLayout         = VK_NULL_HANDLE;
+        VkPipeline                      mPipelines[KERNEL_COUNT]{};
+        std::vector<VkDescriptorPool>   mPools;         // per frame in flight
+
+        // This frame's
+        RenderGraph*                    mGraph          = nullptr;
+        uint32_t                        mFrame          = 0;
+        Dispatch                        mDispatches[MAX_DISPATCHES];
+        uint32_t                        mDispatchCount  = 0;
+        GraphResource                   mDisplay        = INVALID_GRAPH_RESOURCE;
+        GraphResource                   mOutput         = INVALID_GRAPH_RESOURCE;
+        VkExtent2D                      mExtent         = {0, 0};
+};
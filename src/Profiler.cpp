@@ -0,0 +1,87 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+static double millisecondsBetween(ProfileClock::time_point from, ProfileClock::time_point to){
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void CpuProfiler::beginFrame(){
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ProfileClock::time_point now = ProfileClock::now();
+    mLastFrameTime = millisecondsBetween(mFrameStart, now);
+    mFrameStart = now;
+
+    // Keeps both allocations around, no per frame growth once warmed up
+    mLast.swap(mCurrent);
+    mCurrent.clear();
+}
+
+void CpuProfiler::record(const char* name, uint32_t thread, ProfileClock::time_point start, ProfileClock::time_point end){
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ProfileSample sample;
+    sample.name     = name;
+    sample.thread   = thread;
+    sample.start    = millisecondsBetween(mFrameStart, start);
+    sample.end      = millisecondsBetween(mFrameStart, end);
+    mCurrent.push_back(sample);
+}
+
+const std::vector<ProfileSample>& CpuProfiler::lastFrame() const{
+    return mLast;
+}
+
+double CpuProfiler::lastFrameTime() const{
+    return mLastFrameTime;
+}
+
+std::vector<ProfileSummary> CpuProfiler::summarize() const{
+    std::vector<ProfileSummary> summaries;
+
+    for(const ProfileSample& sample : mLast){
+        auto it = std::find_if(summaries.begin(), summaries.end(), [&](const ProfileSummary& summary){
+            return summary.name == sample.name;
+        });
+
+        if(it == summaries.end()){
+            summaries.push_back(ProfileSummary{sample.name, 0, 0.0, 0.0});
+            it = summaries.end() - 1;
+        }
+
+        double duration = sample.end - sample.start;
+        it->count++;
+        it->total   += duration;
+        it->longest = std::max(it->longest, duration);
+    }
+
+    std::sort(summaries.begin(), summaries.end(), [](const ProfileSummary& a, const ProfileSummary& b){
+        return a.total > b.total;
+    });
+
+    return summaries;
+}
+
+void CpuProfiler::print(FILE* f) const{
+    fprintf(f, "frame %.3f ms\n", mLastFrameTime);
+    for(const ProfileSummary& summary : summarize()){
+        fprintf(f, "  %-24s %8.3f ms total, %8.3f ms longest, %4u runs\n",
+                summary.name, summary.total, summary.longest, summary.count);
+    }
+}
+
+ProfileScope::ProfileScope(CpuProfiler* profiler, const char* name, uint32_t thread) :
+    mProfiler(profiler),
+    mName(name),
+    mThread(thread),
+    mStart(ProfileClock::now())
+{
+
+}
+
+ProfileScope::~ProfileScope(){
+    if(mProfiler != nullptr){
+        mProfiler->record(mName, mThread, mStart, ProfileClock::now());
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+using ProfileClock = std::chrono::steady_clock;
+
+// One timed scope or job, times in milliseconds since the frame began
+struct ProfileSample{
+    const char* name    = nullptr;     // static string, samples are grouped by pointer
+    uint32_t    thread  = 0;           // job system thread index, 0 = the thread driving frames
+    double      start   = 0.0;
+    double      end     = 0.0;
+};
+
+// Everything one name did in a frame
+struct ProfileSummary{
+    const char* name    = nullptr;
+    uint32_t    count   = 0;
+    double      total   = 0.0;         // summed over threads, can exceed the frame
+    double      longest = 0.0;
+};
+
+/**
+ * CPU side frame profiler. Jobs and scopes report their start and end from
+ * any thread; beginFrame() closes the frame being collected so the previous
+ * one can be read back whole while the next fills up.
+**/
+
+class CpuProfiler{
+    public:
+        void beginFrame();
+
+        // Thread safe
+        void record(const char* name, uint32_t thread, ProfileClock::time_point start, ProfileClock::time_point end);
+
+        // The last complete frame
+        const std::vector<ProfileSample>& lastFrame() const;
+        double lastFrameTime() const;
+
+        // Per name totals of the last complete frame, longest total first
+        std::vector<ProfileSummary> summarize() const;
+        void print(FILE*) const;
+
+    private:
+        std::mutex                  mMutex;
+        ProfileClock::time_point    mFrameStart     = ProfileClock::now();
+        std::vector<ProfileSample>  mCurrent;
+        std::vector<ProfileSample>  mLast;
+        double                      mLastFrameTime  = 0.0;
+};
+
+// Times the enclosing scope, for work that isn't a job. `profiler` may be null.
+class ProfileScope{
+    public:
+        ProfileScope(CpuProfiler* profiler, const char* name, uint32_t thread = 0);
+        ~ProfileScope();
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        CpuProfiler*                mProfiler;
+        const char*                 mName;
+        uint32_t                    mThread;
+        ProfileClock::time_point    mStart;
+};
@@ -0,0 +1,200 @@
+#include "Readback.hpp"
+
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+uint32_t FrameReadback::texelSize(VkFormat format){
+    switch(format){
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+bool FrameReadback::supported(VkFormat format){
+    return texelSize(format) != 0;
+}
+
+void FrameReadback::init(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format, uint32_t ringSize){
+    mDevice     = device;
+    mExtent     = extent;
+    mFormat     = format;
+    mRowPitch   = extent.width * texelSize(format);
+
+    if(mRowPitch == 0){
+        throw std::runtime_error("failed to create frame readback, unsupported format");
+    }
+
+    mSlots.resize(ringSize);
+
+    for(Slot& slot : mSlots){
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size         = VkDeviceSize(mRowPitch) * extent.height;
+        bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+        if(vkCreateBuffer(mDevice, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS){
+            throw std::runtime_error("failed to create frame readback buffer");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(mDevice, slot.buffer, &requirements);
+
+        // Uncached memory makes every CPU read a trip over the bus
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize    = requirements.size;
+        allocInfo.memoryTypeIndex   = findMemoryType(physicalDevice, requirements.memoryTypeBits,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+        if(vkAllocateMemory(mDevice, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate frame readback memory");
+        }
+
+        vkBindBufferMemory(mDevice, slot.buffer, slot.memory, 0);
+        vkMapMemory(mDevice, slot.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&slot.mapped));
+    }
+}
+
+void FrameReadback::cleanup(){
+    for(Slot& slot : mSlots){
+        vkUnmapMemory(mDevice, slot.memory);
+        vkDestroyBuffer(mDevice, slot.buffer, nullptr);
+        vkFreeMemory(mDevice, slot.memory, nullptr);
+    }
+    mSlots.clear();
+}
+
+void FrameReadback::beginFrame(uint32_t frame){
+    for(Slot& slot : mSlots){
+        if(slot.state != SlotState::Pending || slot.frame != frame) continue;
+
+        // Cached memory isn't coherent everywhere, and on coherent memory this costs nothing
+        VkMappedMemoryRange range{};
+        range.sType     = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory    = slot.memory;
+        range.offset    = 0;
+        range.size      = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(mDevice, 1, &range);
+
+        slot.state = SlotState::Ready;
+    }
+}
+
+void FrameReadback::addPass(RenderGraph& graph, uint32_t frame, GraphResource image){
+    uint64_t index = mNextIndex++;
+
+    // A free slot, or else the oldest capture still waiting for a consumer
+    Slot* target = nullptr;
+    for(Slot& slot : mSlots){
+        if(slot.state == SlotState::Free){
+            target = &slot;
+            break;
+        }
+        if(slot.state == SlotState::Ready && (target == nullptr || slot.index < target->index)){
+            target = &slot;
+        }
+    }
+
+    if(target == nullptr){
+        mStats.dropped++;
+        return;
+    }
+
+    // Counted as captured when its copy was recorded, overwritten unread now
+    if(target->state == SlotState::Ready){
+        mStats.captured--;
+        mStats.dropped++;
+    }
+
+    target->state   = SlotState::Pending;
+    target->frame   = frame;
+    target->index   = index;
+    mStats.captured++;
+
+    mGraph  = &graph;
+    mSource = image;
+
+    const Slot* slot = target;
+    GraphPass pass = graph.addPass("readback", [this, slot](VkCommandBuffer commandBuffer){
+        record(commandBuffer, *slot);
+    });
+    graph.read(pass, image, GraphUsage::Transfer);
+
+    // The copy leaves the graph for the host
+    graph.sideEffects(pass);
+}
+
+void FrameReadback::record(VkCommandBuffer commandBuffer, const Slot& slot){
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent      = {mExtent.width, mExtent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer,
+                           mGraph->image(mSource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           slot.buffer, 1, &region);
+
+    // Waiting for the frame's fence or timeline value doesn't make device
+    // writes visible to the host by itself
+    VkMemoryBarrier barrier{};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+bool FrameReadback::acquire(ReadbackFrame& frame){
+    if(mAcquired != UINT32_MAX){
+        return false;
+    }
+
+    for(uint32_t i = 0; i < mSlots.size(); i++){
+        const Slot& slot = mSlots[i];
+        if(slot.state == SlotState::Ready && (mAcquired == UINT32_MAX || slot.index < mSlots[mAcquired].index)){
+            mAcquired = i;
+        }
+    }
+
+    if(mAcquired == UINT32_MAX){
+        return false;
+    }
+
+    Slot& slot = mSlots[mAcquired];
+    slot.state = SlotState::Acquired;
+
+    frame.index     = slot.index;
+    frame.extent    = mExtent;
+    frame.format    = mFormat;
+    frame.rowPitch  = mRowPitch;
+    frame.pixels    = slot.mapped;
+    return true;
+}
+
+void FrameReadback::release(){
+    if(mAcquired == UINT32_MAX){
+        return;
+    }
+
+    mSlots[mAcquired].state = SlotState::Free;
+    mAcquired = UINT32_MAX;
+}
+
+const FrameReadback::Stats& FrameReadback::stats() const{
+    return mStats;
+}
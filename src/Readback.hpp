@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "RenderGraph.hpp"
+
+// A finished copy of a frame: the image's format and texel order, rows
+// tightly packed from the top
+struct ReadbackFrame{
+    uint64_t        index       = 0;    // frames given to addPass() before this one, dropped ones included
+    VkExtent2D      extent      = {0, 0};
+    VkFormat        format      = VK_FORMAT_UNDEFINED;
+    uint32_t        rowPitch    = 0;    // bytes
+    const uint8_t*  pixels      = nullptr;
+};
+
+/**
+ * Gets frames back from the GPU without stalling either side. Each frame a
+ * render graph pass copies the final image into the next slot of a ring of
+ * buffers in host visible memory, host cached where there is such, and
+ * mapped for good. A capture is ready once the frame slot it was recorded in
+ * comes around again, its fence or timeline value waited for by then anyway,
+ * so it reaches the CPU frames in flight later and nothing ever waits on it.
+ *
+ *      readback.beginFrame(frame);           // the slot is free
+ *      ...
+ *      readback.addPass(graph, frame, backbuffer);
+ *      ...
+ *      ReadbackFrame captured;
+ *      while(readback.acquire(captured)){
+ *          write(captured);
+ *          readback.release();
+ *      }
+ *
+ * Captures come out in order. When every slot is in flight or held, the
+ * oldest ready capture nobody took is reused, or failing that the frame isn't
+ * captured; both count as dropped. A consumer keeping up never sees either
+ * with a ring of frames in flight plus one.
+**/
+
+class FrameReadback{
+    public:
+        // Every frame given to addPass() is one or the other
+        struct Stats{
+            uint64_t    captured    = 0;    // delivered, or still on their way
+            uint64_t    dropped     = 0;    // never copied, or overwritten before acquired
+        };
+
+        // Whether frames in `format` can be read back, it needs a known texel size
+        static bool supported(VkFormat);
+
+        // Bytes per texel of a frame in `format`, 0 when it isn't supported
+        static uint32_t texelSize(VkFormat);
+
+        // Frames of `extent` in `format`, `ringSize` of them in host memory
+        void init(VkDevice, VkPhysicalDevice, VkExtent2D extent, VkFormat format, uint32_t ringSize);
+        void cleanup();
+
+        // Once the frame slot `frame`'s last submission has completed: what it
+        // captured is ready
+        void beginFrame(uint32_t frame);
+
+        // Adds the pass copying `image`, the extent and format from init(),
+        // after whatever writes it last. Between RenderGraph::begin() and
+        // compile().
+        void addPass(RenderGraph&, uint32_t frame, GraphResource image);
+
+        // The oldest ready capture, valid until release(). One at a time.
+        bool acquire(ReadbackFrame&);
+        void release();
+
+        const Stats& stats() const;
+
+    private:
+        enum class SlotState : uint8_t{
+            Free,
+            Pending,        // copy recorded in `frame`, not known to be done
+            Ready,
+            Acquired
+        };
+
+        struct Slot{
+            VkBuffer        buffer  = VK_NULL_HANDLE;
+            VkDeviceMemory  memory  = VK_NULL_HANDLE;
+            uint8_t*        mapped  = nullptr;
+            SlotState       state   = SlotState::Free;
+            uint32_t        frame   = 0;
+            uint64_t        index   = 0;
+        };
+
+        void record(VkCommandBuffer, const Slot&);
+
+        VkDevice                mDevice         = VK_NULL_HANDLE;
+        VkExtent2D              mExtent         = {0, 0};
+        VkFormat                mFormat         = VK_FORMAT_UNDEFINED;
+        uint32_t                mRowPitch       = 0;
+        std::vector<Slot>       mSlots;
+        uint32_t                mAcquired       = UINT32_MAX;
+        uint64_t                mNextIndex      = 0;
+        Stats                   mStats;
+
+        // This frame's
+        RenderGraph*            mGraph          = nullptr;
+        GraphResource           mSource         = INVALID_GRAPH_RESOURCE;
+};
@@ -0,0 +1,791 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+static const VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                           VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+static const VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+struct UsageInfo{
+    VkPipelineStageFlags2   stages      = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2          access      = VK_ACCESS_2_NONE;
+    VkImageLayout           layout      = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageUsageFlags       imageUsage  = 0;
+};
+
+static UsageInfo usageInfo(GraphUsage usage, bool read, bool write){
+    UsageInfo info;
+
+    switch(usage){
+        case GraphUsage::ColorAttachment:
+            info.stages     = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            info.access     = (read ? VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT : 0) |
+                              (write ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : 0);
+            info.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            break;
+
+        case GraphUsage::DepthAttachment:
+            // Tests read whether or not they write
+            info.stages     = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+            info.access     = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                              (write ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+            info.layout     = write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+                                      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            info.imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            break;
+
+        case GraphUsage::SampledFragment:
+            info.stages     = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+            info.access     = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            info.layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            info.imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+            break;
+
+        case GraphUsage::SampledCompute:
+            info.stages     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            info.access     = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            info.layout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            info.imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+            break;
+
+        case GraphUsage::StorageCompute:
+            info.stages     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            info.access     = (read ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT : 0) |
+                              (write ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : 0);
+            info.layout     = VK_IMAGE_LAYOUT_GENERAL;
+            info.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+            break;
+
+        case GraphUsage::StorageGraphics:
+            // Vertex, task and mesh shaders alike, whichever the device has
+            info.stages     = VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT;
+            info.access     = (read ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT : 0) |
+                              (write ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : 0);
+            info.layout     = VK_IMAGE_LAYOUT_GENERAL;
+            info.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+            break;
+
+        case GraphUsage::StorageFragment:
+            info.stages     = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+            info.access     = (read ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT : 0) |
+                              (write ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT : 0);
+            info.layout     = VK_IMAGE_LAYOUT_GENERAL;
+            info.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+            break;
+
+        case GraphUsage::Indirect:
+            info.stages     = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+            info.access     = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+            break;
+
+        case GraphUsage::Index:
+            info.stages     = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+            info.access     = VK_ACCESS_2_INDEX_READ_BIT;
+            break;
+
+        case GraphUsage::Transfer:
+            info.stages     = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+            info.access     = write ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_TRANSFER_READ_BIT;
+            info.layout     = write ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            info.imageUsage = write ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            break;
+    }
+
+    return info;
+}
+
+static VkImageAspectFlags aspectOf(VkFormat format){
+    switch(format){
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static bool samePlacement(const GraphImageDesc& a, const GraphImageDesc& b){
+    return a.format == b.format &&
+           a.extent.width == b.extent.width &&
+           a.extent.height == b.extent.height &&
+           a.mipLevels == b.mipLevels &&
+           a.samples == b.samples;
+}
+
+void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice){
+    mDevice         = device;
+    mPhysicalDevice = physicalDevice;
+}
+
+void RenderGraph::cleanup(){
+    destroyTransients();
+
+    mPasses.clear();
+    mResources.clear();
+    mPlacements.clear();
+    mPassCount      = 0;
+    mResourceCount  = 0;
+}
+
+// Describing the frame
+// .............................................................................
+
+void RenderGraph::begin(){
+    mPassCount      = 0;
+    mResourceCount  = 0;
+}
+
+GraphResource RenderGraph::createImage(const char* name, const GraphImageDesc& desc){
+    if(mResourceCount == mResources.size()){
+        mResources.emplace_back();
+    }
+
+    Resource& resource = mResources[mResourceCount];
+    resource        = Resource();
+    resource.name   = name;
+    resource.desc   = desc;
+    resource.aspect = aspectOf(desc.format);
+
+    return mResourceCount++;
+}
+
+GraphResource RenderGraph::importImage(const char* name, const GraphImportedImage& imported){
+    GraphImageDesc desc;
+    desc.format     = imported.format;
+    desc.extent     = imported.extent;
+    desc.mipLevels  = imported.mipLevels;
+
+    GraphResource id = createImage(name, desc);
+
+    Resource& resource = mResources[id];
+    resource.imported               = true;
+    resource.image                  = imported.image;
+    resource.view                   = imported.view;
+    resource.sampledView            = imported.view;
+    resource.initial.layout         = imported.initialLayout;
+    resource.initial.writeStages    = imported.initialStages;
+    resource.finalLayout            = imported.finalLayout;
+    resource.output                 = imported.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+
+    return id;
+}
+
+GraphResource RenderGraph::importBuffer(const char* name, VkBuffer buffer, VkPipelineStageFlags2 stages, VkAccessFlags2 access){
+    GraphResource id = createImage(name, GraphImageDesc());
+
+    Resource& resource = mResources[id];
+    resource.isImage                = false;
+    resource.imported               = true;
+    resource.buffer                 = buffer;
+    resource.initial.writeStages    = stages;
+    resource.initial.writeAccess    = access;
+
+    return id;
+}
+
+GraphPass RenderGraph::addRenderPass(const char* name, Record record){
+    GraphPass id = addPass(name, std::move(record));
+    mPasses[id].rendering = true;
+    return id;
+}
+
+GraphPass RenderGraph::addPass(const char* name, Record record){
+    if(mPassCount == mPasses.size()){
+        mPasses.emplace_back();
+    }
+
+    // Keeps the vectors' capacity from earlier frames
+    Pass& pass = mPasses[mPassCount];
+    pass.name           = name;
+    pass.record         = std::move(record);
+    pass.rendering      = false;
+    pass.sideEffects    = false;
+    pass.culled         = false;
+    pass.uses.clear();
+    pass.colors.clear();
+    pass.depth          = Attachment();
+    pass.area           = {0, 0};
+    pass.depthWrite     = true;
+
+    return mPassCount++;
+}
+
+void RenderGraph::color(GraphPass id, GraphResource resource, VkAttachmentLoadOp loadOp,
+                        VkClearColorValue clear, GraphResource resolve){
+    Attachment attachment;
+    attachment.resource     = resource;
+    attachment.resolve      = resolve;
+    attachment.loadOp       = loadOp;
+    attachment.clear.color  = clear;
+    pass(id).colors.push_back(attachment);
+
+    bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+    addUse(id, resource, GraphUsage::ColorAttachment, load, true, !load);
+
+    if(resolve != INVALID_GRAPH_RESOURCE){
+        addUse(id, resolve, GraphUsage::ColorAttachment, false, true, true);
+    }
+}
+
+void RenderGraph::depth(GraphPass id, GraphResource resource, VkAttachmentLoadOp loadOp, float clear, bool write){
+    Pass& target = pass(id);
+    target.depth.resource                   = resource;
+    target.depth.loadOp                     = loadOp;
+    target.depth.clear.depthStencil         = {clear, 0};
+    target.depthWrite                       = write;
+
+    bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+    addUse(id, resource, GraphUsage::DepthAttachment, load || !write, write, write && !load);
+}
+
+void RenderGraph::renderArea(GraphPass id, VkExtent2D area){
+    pass(id).area = area;
+}
+
+void RenderGraph::read(GraphPass id, GraphResource resource, GraphUsage usage){
+    addUse(id, resource, usage, true, false, false);
+}
+
+void RenderGraph::write(GraphPass id, GraphResource resource, GraphUsage usage){
+    // Storage and transfer writes may cover only part of it, what was there stays live
+    addUse(id, resource, usage, false, true, false);
+}
+
+void RenderGraph::sideEffects(GraphPass id){
+    pass(id).sideEffects = true;
+}
+
+void RenderGraph::output(GraphResource resource){
+    mResources[resource].output = true;
+}
+
+RenderGraph::Pass& RenderGraph::pass(GraphPass id){
+    if(id >= mPassCount){
+        throw std::runtime_error("unknown render graph pass");
+    }
+    return mPasses[id];
+}
+
+void RenderGraph::addUse(GraphPass id, GraphResource resource, GraphUsage usage, bool read, bool write, bool discards){
+    if(resource >= mResourceCount){
+        throw std::runtime_error("unknown render graph resource");
+    }
+    pass(id).uses.push_back({resource, usage, read, write, discards});
+}
+
+// Compiling
+// .............................................................................
+
+void RenderGraph::compile(){
+    mStats.passes       = mPassCount;
+    mStats.culledPasses = 0;
+
+    cull();
+
+    for(uint32_t p = 0; p < mPassCount; p++){
+        const Pass& pass = mPasses[p];
+        if(pass.culled) continue;
+
+        for(const Use& use : pass.uses){
+            Resource& resource = mResources[use.resource];
+            resource.usage      |= usageInfo(use.usage, use.read, use.write).imageUsage;
+            resource.firstPass  = std::min(resource.firstPass, p);
+            resource.lastPass   = std::max(resource.lastPass, p);
+
+            bool attachment = use.usage == GraphUsage::ColorAttachment || use.usage == GraphUsage::DepthAttachment;
+            if(!attachment || use.read){
+                resource.leavesPass = true;
+            }
+        }
+
+        for(const Attachment& attachment : pass.colors){
+            if(attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE){
+                mResources[attachment.resource].leavesPass = true;
+            }
+        }
+        if(pass.depth.resource != INVALID_GRAPH_RESOURCE && pass.depth.storeOp == VK_ATTACHMENT_STORE_OP_STORE){
+            mResources[pass.depth.resource].leavesPass = true;
+        }
+    }
+
+    placeTransients();
+}
+
+// Walks back from the outputs: a pass stays if it has side effects or writes
+// something a later pass still reads. What it discards is dead before it,
+// what it reads is live.
+void RenderGraph::cull(){
+    mLive.assign(mResourceCount, 0);
+
+    for(uint32_t r = 0; r < mResourceCount; r++){
+        mLive[r] = mResources[r].output;
+    }
+
+    for(uint32_t p = mPassCount; p-- > 0;){
+        Pass& pass = mPasses[p];
+
+        bool needed = pass.sideEffects;
+        for(const Use& use : pass.uses){
+            needed |= use.write && mLive[use.resource];
+        }
+
+        pass.culled = !needed;
+        if(pass.culled){
+            mStats.culledPasses++;
+            continue;
+        }
+
+        // Stored only when someone after this pass looks at it
+        for(Attachment& attachment : pass.colors){
+            attachment.storeOp = mLive[attachment.resource] ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+        if(pass.depth.resource != INVALID_GRAPH_RESOURCE){
+            pass.depth.storeOp = mLive[pass.depth.resource] ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+
+        for(const Use& use : pass.uses){
+            if(use.discards) mLive[use.resource] = 0;
+        }
+        for(const Use& use : pass.uses){
+            if(use.read) mLive[use.resource] = 1;
+        }
+    }
+}
+
+void RenderGraph::placeTransients(){
+    mTransients.clear();
+    mNewPlacements.clear();
+
+    for(uint32_t r = 0; r < mResourceCount; r++){
+        const Resource& resource = mResources[r];
+        if(resource.isImage && !resource.imported && resource.firstPass != UINT32_MAX){
+            mTransients.push_back(r);
+        }
+    }
+
+    std::stable_sort(mTransients.begin(), mTransients.end(), [&](uint32_t a, uint32_t b){
+        return mResources[a].firstPass < mResources[b].firstPass;
+    });
+
+    for(uint32_t r : mTransients){
+        const Resource& resource = mResources[r];
+
+        // Nothing goes in or out of the pass, a tiler never writes it to memory
+        bool lazy = !resource.leavesPass && (resource.usage & ~ATTACHMENT_USAGE) == 0;
+
+        Placement placement;
+        placement.desc      = resource.desc;
+        placement.usage     = resource.usage | (lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        placement.lazy      = lazy;
+        placement.firstPass = resource.firstPass;
+        placement.lastPass  = resource.lastPass;
+        mNewPlacements.push_back(placement);
+    }
+
+    bool same = mNewPlacements.size() == mPlacements.size();
+    for(size_t i = 0; same && i < mPlacements.size(); i++){
+        const Placement& a = mNewPlacements[i];
+        const Placement& b = mPlacements[i];
+        same = samePlacement(a.desc, b.desc) && a.usage == b.usage && a.lazy == b.lazy &&
+               a.firstPass == b.firstPass && a.lastPass == b.lastPass;
+    }
+
+    if(!same){
+        destroyTransients();
+        mPlacements.swap(mNewPlacements);
+        createTransients();
+    }
+
+    for(uint32_t i = 0; i < mTransients.size(); i++){
+        Resource& resource = mResources[mTransients[i]];
+        resource.physical       = i;
+        resource.image          = mPhysical[i].image;
+        resource.view           = mPhysical[i].view;
+        resource.sampledView    = mPhysical[i].sampledView;
+    }
+
+    mStats.transientImages = static_cast<uint32_t>(mPhysical.size());
+}
+
+// Images first to learn their memory needs, then first fit into slots whose
+// last image is done before this one starts, then the memory
+void RenderGraph::createTransients(){
+    mPhysical.resize(mPlacements.size());
+    mStats.unaliasedBytes = 0;
+    mStats.transientBytes = 0;
+
+    for(size_t i = 0; i < mPlacements.size(); i++){
+        const Placement& placement = mPlacements[i];
+        PhysicalImage& physical = mPhysical[i];
+        physical.desc   = placement.desc;
+        physical.usage  = placement.usage;
+        physical.lazy   = placement.lazy;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+        imageInfo.extent        = {placement.desc.extent.width, placement.desc.extent.height, 1};
+        imageInfo.mipLevels     = placement.desc.mipLevels;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.format        = placement.desc.format;
+        imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage         = placement.usage;
+        imageInfo.samples       = placement.desc.samples;
+        imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+        if(vkCreateImage(mDevice, &imageInfo, nullptr, &physical.image) != VK_SUCCESS){
+            throw std::runtime_error("failed to create render graph image");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(mDevice, physical.image, &requirements);
+        mStats.unaliasedBytes += requirements.size;
+
+        uint32_t slot = UINT32_MAX;
+        if(!placement.lazy){
+            for(uint32_t s = 0; s < mSlots.size(); s++){
+                const MemorySlot& candidate = mSlots[s];
+                if(!candidate.lazy &&
+                   candidate.lastPass < placement.firstPass &&
+                   (candidate.typeBits & requirements.memoryTypeBits) != 0){
+                    slot = s;
+                    break;
+                }
+            }
+        }
+
+        if(slot == UINT32_MAX){
+            slot = static_cast<uint32_t>(mSlots.size());
+            mSlots.emplace_back();
+            mSlots[slot].typeBits   = requirements.memoryTypeBits;
+            mSlots[slot].lazy       = placement.lazy;
+        }
+
+        // Bound at offset 0, which any allocation is aligned for
+        MemorySlot& memorySlot = mSlots[slot];
+        memorySlot.size         = std::max(memorySlot.size, requirements.size);
+        memorySlot.typeBits     &= requirements.memoryTypeBits;
+        memorySlot.lastPass     = placement.lastPass;
+        physical.slot           = slot;
+    }
+
+    for(MemorySlot& slot : mSlots){
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize    = slot.size;
+        allocInfo.memoryTypeIndex   = findMemoryType(mPhysicalDevice,
+                                                     slot.typeBits,
+                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                     slot.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+
+        if(vkAllocateMemory(mDevice, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate render graph memory");
+        }
+
+        mStats.transientBytes += slot.size;
+    }
+
+    for(PhysicalImage& physical : mPhysical){
+        vkBindImageMemory(mDevice, physical.image, mSlots[physical.slot].memory, 0);
+
+        // The attachment view matches the barriers, every aspect there is
+        VkImageAspectFlags aspect = aspectOf(physical.desc.format);
+        physical.view = createImageView(mDevice, physical.image, physical.desc.format, aspect, physical.desc.mipLevels);
+
+        // Sampling takes a single aspect, a depth/stencil image gets a
+        // second view for it
+        physical.sampledView = physical.view;
+        if((physical.usage & VK_IMAGE_USAGE_SAMPLED_BIT) && aspect == (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)){
+            physical.sampledView = createImageView(mDevice, physical.image, physical.desc.format,
+                                                   VK_IMAGE_ASPECT_DEPTH_BIT, physical.desc.mipLevels);
+        }
+    }
+}
+
+void RenderGraph::destroyTransients(){
+    if(mPhysical.empty() && mSlots.empty()){
+        return;
+    }
+
+    // Rare, only when the frame changes shape; earlier frames may still use them
+    vkDeviceWaitIdle(mDevice);
+
+    for(PhysicalImage& physical : mPhysical){
+        if(physical.sampledView != physical.view){
+            vkDestroyImageView(mDevice, physical.sampledView, nullptr);
+        }
+        vkDestroyImageView(mDevice, physical.view, nullptr);
+        vkDestroyImage(mDevice, physical.image, nullptr);
+    }
+    for(MemorySlot& slot : mSlots){
+        vkFreeMemory(mDevice, slot.memory, nullptr);
+    }
+
+    mPhysical.clear();
+    mSlots.clear();
+    mPlacements.clear();
+
+    mStats.transientImages  = 0;
+    mStats.transientBytes   = 0;
+    mStats.unaliasedBytes   = 0;
+}
+
+// Executing
+// .............................................................................
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer){
+    mStats.barriers = 0;
+
+    for(uint32_t p = 0; p < mPassCount; p++){
+        const Pass& pass = mPasses[p];
+        if(pass.culled) continue;
+
+        GpuScope scope(mProfiler, commandBuffer, pass.name);
+
+        for(const Use& use : pass.uses){
+            transition(use);
+        }
+        flushBarriers(commandBuffer);
+
+        if(pass.rendering){
+            beginRendering(commandBuffer, pass);
+            pass.record(commandBuffer);
+            vkCmdEndRendering(commandBuffer);
+        } else {
+            pass.record(commandBuffer);
+        }
+    }
+
+    // Imported images go back the way their owner wants them, e.g. to present
+    for(uint32_t r = 0; r < mResourceCount; r++){
+        Resource& resource = mResources[r];
+        if(!resource.isImage || !resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+
+        if(!resource.touched){
+            resource.state = resource.initial;
+        }
+
+        if(resource.state.layout == resource.finalLayout){
+            continue;
+        }
+
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask        = resource.state.writeStages | resource.state.readStages;
+        barrier.srcAccessMask       = resource.state.writeAccess;
+        barrier.dstStageMask        = VK_PIPELINE_STAGE_2_NONE;
+        barrier.dstAccessMask       = VK_ACCESS_2_NONE;
+        barrier.oldLayout           = resource.state.layout;
+        barrier.newLayout           = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = resource.image;
+        barrier.subresourceRange    = {resource.aspect, 0, resource.desc.mipLevels, 0, 1};
+        mImageBarriers.push_back(barrier);
+
+        resource.state.layout = resource.finalLayout;
+    }
+    flushBarriers(commandBuffer);
+}
+
+void RenderGraph::setProfiler(GpuProfiler* profiler){
+    mProfiler = profiler;
+}
+
+// Barrier, if any, between what happened to the resource so far and `use`
+void RenderGraph::transition(const Use& use){
+    Resource& resource = mResources[use.resource];
+    UsageInfo info = usageInfo(use.usage, use.read, use.write);
+    State& state = resource.state;
+
+    // Transients start from whatever last sat in their memory, with its
+    // contents thrown away
+    if(!resource.touched){
+        resource.touched = true;
+        if(resource.imported){
+            state = resource.initial;
+        } else {
+            state = mSlots[mPhysical[resource.physical].slot].state;
+            state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+    }
+
+    VkImageLayout layout    = resource.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageLayout oldLayout = state.layout;
+    bool layoutChange       = resource.isImage && oldLayout != layout;
+
+    VkPipelineStageFlags2   srcStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2          srcAccess = VK_ACCESS_2_NONE;
+    bool                    barrier   = false;
+
+    if(use.write || layoutChange){
+        // After the last write and every read since, the transition counts as a write
+        srcStages   = state.writeStages | state.readStages;
+        srcAccess   = state.writeAccess;
+        barrier     = layoutChange || srcStages != VK_PIPELINE_STAGE_2_NONE;
+
+        state.writeStages   = info.stages;
+        state.writeAccess   = use.write ? info.access & WRITE_ACCESS : VK_ACCESS_2_NONE;
+        state.readStages    = use.write ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+        state.readAccess    = use.write ? VK_ACCESS_2_NONE : info.access;
+    } else {
+        // Reads only wait for the write once per stage and access
+        bool seen = (info.stages & ~state.readStages) == 0 && (info.access & ~state.readAccess) == 0;
+        if(!seen && state.writeStages != VK_PIPELINE_STAGE_2_NONE){
+            srcStages   = state.writeStages;
+            srcAccess   = state.writeAccess;
+            barrier     = true;
+        }
+
+        state.readStages    |= info.stages;
+        state.readAccess    |= info.access;
+    }
+
+    state.layout = layout;
+
+    if(!resource.imported){
+        mSlots[mPhysical[resource.physical].slot].state = state;
+    }
+
+    if(!barrier){
+        return;
+    }
+
+    if(resource.isImage){
+        VkImageMemoryBarrier2 imageBarrier{};
+        imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        imageBarrier.srcStageMask           = srcStages;
+        imageBarrier.srcAccessMask          = srcAccess;
+        imageBarrier.dstStageMask           = info.stages;
+        imageBarrier.dstAccessMask          = info.access;
+        imageBarrier.oldLayout              = oldLayout;
+        imageBarrier.newLayout              = layout;
+        imageBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image                  = resource.image;
+        imageBarrier.subresourceRange       = {resource.aspect, 0, resource.desc.mipLevels, 0, 1};
+        mImageBarriers.push_back(imageBarrier);
+    } else {
+        // Buffers share one global barrier per pass
+        mMemoryBarrier.srcStageMask     |= srcStages;
+        mMemoryBarrier.srcAccessMask    |= srcAccess;
+        mMemoryBarrier.dstStageMask     |= info.stages;
+        mMemoryBarrier.dstAccessMask    |= info.access;
+    }
+}
+
+void RenderGraph::flushBarriers(VkCommandBuffer commandBuffer){
+    bool memory = mMemoryBarrier.srcStageMask != VK_PIPELINE_STAGE_2_NONE;
+    if(mImageBarriers.empty() && !memory){
+        return;
+    }
+
+    mMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.memoryBarrierCount       = memory ? 1 : 0;
+    dependencyInfo.pMemoryBarriers          = &mMemoryBarrier;
+    dependencyInfo.imageMemoryBarrierCount  = static_cast<uint32_t>(mImageBarriers.size());
+    dependencyInfo.pImageMemoryBarriers     = mImageBarriers.data();
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    mStats.barriers += dependencyInfo.memoryBarrierCount + dependencyInfo.imageMemoryBarrierCount;
+
+    mImageBarriers.clear();
+    mMemoryBarrier = VkMemoryBarrier2{};
+}
+
+void RenderGraph::beginRendering(VkCommandBuffer commandBuffer, const Pass& pass){
+    mColorInfos.clear();
+
+    VkExtent2D extent = {0, 0};
+
+    for(const Attachment& attachment : pass.colors){
+        const Resource& resource = mResources[attachment.resource];
+        extent = resource.desc.extent;
+
+        VkRenderingAttachmentInfo info{};
+        info.sType          = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        info.imageView      = resource.view;
+        info.imageLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        info.loadOp         = attachment.loadOp;
+        info.storeOp        = attachment.storeOp;
+        info.clearValue     = attachment.clear;
+
+        if(attachment.resolve != INVALID_GRAPH_RESOURCE){
+            info.resolveMode        = VK_RESOLVE_MODE_AVERAGE_BIT;
+            info.resolveImageView   = mResources[attachment.resolve].view;
+            info.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        mColorInfos.push_back(info);
+    }
+
+    VkRenderingAttachmentInfo depthInfo{};
+    if(pass.depth.resource != INVALID_GRAPH_RESOURCE){
+        const Resource& resource = mResources[pass.depth.resource];
+        extent = resource.desc.extent;
+
+        depthInfo.sType         = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthInfo.imageView     = resource.view;
+        depthInfo.imageLayout   = pass.depthWrite ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+                                                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        depthInfo.loadOp        = pass.depth.loadOp;
+        depthInfo.storeOp       = pass.depth.storeOp;
+        depthInfo.clearValue    = pass.depth.clear;
+    }
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType                 = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset     = {0, 0};
+    renderingInfo.renderArea.extent     = pass.area.width > 0 ? pass.area : extent;
+    renderingInfo.layerCount            = 1;
+    renderingInfo.colorAttachmentCount  = static_cast<uint32_t>(mColorInfos.size());
+    renderingInfo.pColorAttachments     = mColorInfos.data();
+    renderingInfo.pDepthAttachment      = pass.depth.resource != INVALID_GRAPH_RESOURCE ? &depthInfo : nullptr;
+
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+// Lookups
+// .............................................................................
+
+VkImage RenderGraph::image(GraphResource resource) const{
+    return mResources[resource].image;
+}
+
+VkImageView RenderGraph::view(GraphResource resource) const{
+    return mResources[resource].view;
+}
+
+VkImageView RenderGraph::sampledView(GraphResource resource) const{
+    return mResources[resource].sampledView;
+}
+
+VkBuffer RenderGraph::buffer(GraphResource resource) const{
+    return mResources[resource].buffer;
+}
+
+bool RenderGraph::culled(GraphPass id) const{
+    return mPasses[id].culled;
+}
+
+const RenderGraph::Stats& RenderGraph::stats() const{
+    return mStats;
+}
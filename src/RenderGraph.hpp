@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "GpuProfiler.hpp"
+
+using GraphResource = uint32_t;
+using GraphPass     = uint32_t;
+
+const GraphResource INVALID_GRAPH_RESOURCE = UINT32_MAX;
+
+// How a pass touches a resource. Whether it reads or writes comes from
+// RenderGraph::read() / write(), layout, stages and access follow from both.
+enum class GraphUsage : uint32_t{
+    ColorAttachment,
+    DepthAttachment,
+    SampledFragment,
+    SampledCompute,
+    StorageCompute,         // images in GENERAL, or buffers
+    StorageGraphics,        // buffers pulled from vertex, task or mesh shaders
+    StorageFragment,        // buffers read while shading
+    Indirect,               // buffers, draw and dispatch arguments
+    Index,                  // buffers
+    Transfer
+};
+
+// A transient image, created, placed in memory and destroyed by the graph
+struct GraphImageDesc{
+    VkFormat                format      = VK_FORMAT_UNDEFINED;
+    VkExtent2D              extent      = {0, 0};
+    uint32_t                mipLevels   = 1;
+    VkSampleCountFlagBits   samples     = VK_SAMPLE_COUNT_1_BIT;
+};
+
+// An image that lives outside the graph, like the swapchain image. The graph
+// starts from `initialLayout`, with the first use waiting on `initialStages`,
+// and leaves it in `finalLayout`; a final layout also makes it an output.
+struct GraphImportedImage{
+    VkImage                 image           = VK_NULL_HANDLE;
+    VkImageView             view            = VK_NULL_HANDLE;
+    VkFormat                format          = VK_FORMAT_UNDEFINED;
+    VkExtent2D              extent          = {0, 0};
+    uint32_t                mipLevels       = 1;
+    VkImageLayout           initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags2   initialStages   = VK_PIPELINE_STAGE_2_NONE;
+    VkImageLayout           finalLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+/**
+ * Frame described as passes and the resources they read and write, rebuilt
+ * every frame:
+ *
+ *      graph.begin();
+ *      GraphResource depth = graph.createImage("depth", {...});
+ *      GraphPass scene = graph.addRenderPass("scene", record);
+ *      graph.color(scene, backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+ *      graph.depth(scene, depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+ *      graph.compile();
+ *      graph.execute(commandBuffer);
+ *
+ * Passes run in the order they were added, which is a valid order by
+ * construction since a pass can only use what exists when it's added. From
+ * the declared uses the graph
+ *
+ *  - culls passes nothing reaches: neither an output nor a pass with side
+ *    effects reads what they write,
+ *  - records one batched barrier before each pass, only for real hazards
+ *    (read after write, write after anything, layout changes); reads after
+ *    reads in the same layout cost nothing,
+ *  - begins and ends dynamic rendering around render passes and picks store
+ *    ops: an attachment no later pass reads is DONT_CARE,
+ *  - places transient images whose lifetimes don't overlap in the same
+ *    memory. Attachments whose contents never leave their pass get their own
+ *    lazily allocated memory instead, which tilers keep on chip.
+ *
+ * Transient images are created on the first compile and kept while the
+ * frame keeps the same shape; a different shape waits for the device to go
+ * idle and makes new ones. They're shared by the frames in flight, the
+ * barriers order each frame's use after the last one's.
+ *
+ * With a GPU profiler set every pass that runs is timed under its name.
+ *
+ * Needs synchronization2 and dynamic rendering. Steady state frames don't
+ * touch the heap.
+**/
+
+class RenderGraph{
+    public:
+        using Record = std::function<void(VkCommandBuffer)>;
+
+        struct Stats{
+            uint32_t        passes          = 0;
+            uint32_t        culledPasses    = 0;
+            uint32_t        barriers        = 0;    // image and memory barriers of the last execute()
+            uint32_t        transientImages = 0;
+            VkDeviceSize    transientBytes  = 0;    // memory the transient images actually take
+            VkDeviceSize    unaliasedBytes  = 0;    // what they would take without aliasing
+        };
+
+        void init(VkDevice, VkPhysicalDevice);
+        void cleanup();
+
+        // Describing the frame
+        // .....................................................................
+
+        void begin();
+
+        GraphResource createImage(const char* name, const GraphImageDesc&);
+        GraphResource importImage(const char* name, const GraphImportedImage&);
+
+        // Last write before the graph was `stages` / `access`, waited for by the first use
+        GraphResource importBuffer(const char* name,
+                                   VkBuffer,
+                                   VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE,
+                                   VkAccessFlags2 access = VK_ACCESS_2_NONE);
+
+        // Recorded between begin/end rendering of the pass' attachments
+        GraphPass addRenderPass(const char* name, Record);
+
+        // Recorded outside rendering, for compute and transfers
+        GraphPass addPass(const char* name, Record);
+
+        // Attachments of a render pass, in attachment order. LOAD reads what
+        // was there, `resolve` takes the multisample resolve.
+        void color(GraphPass, GraphResource, VkAttachmentLoadOp,
+                   VkClearColorValue clear = {{0.0f, 0.0f, 0.0f, 1.0f}},
+                   GraphResource resolve = INVALID_GRAPH_RESOURCE);
+        void depth(GraphPass, GraphResource, VkAttachmentLoadOp, float clear = 1.0f, bool write = true);
+
+        // Rendering covers only the top left `area` of the attachments, all of
+        // them by default. Clears and resolves stay inside it too.
+        void renderArea(GraphPass, VkExtent2D area);
+
+        void read(GraphPass, GraphResource, GraphUsage);
+        void write(GraphPass, GraphResource, GraphUsage);
+
+        // Never culled, for passes whose work isn't visible as resources
+        void sideEffects(GraphPass);
+
+        // Kept alive to the end of the frame even though no pass reads it
+        void output(GraphResource);
+
+        // Running it
+        // .....................................................................
+
+        void compile();
+        void execute(VkCommandBuffer);
+
+        // Times each pass, barriers included. May be null.
+        void setProfiler(GpuProfiler*);
+
+        // Valid from compile() on, for descriptors and record callbacks
+        VkImage image(GraphResource) const;
+        VkImageView view(GraphResource) const;
+
+        // For sampling: depth only for depth/stencil formats, view() otherwise
+        VkImageView sampledView(GraphResource) const;
+        VkBuffer buffer(GraphResource) const;
+
+        bool culled(GraphPass) const;
+        const Stats& stats() const;
+
+    private:
+        // Where a resource's last uses left it, what the next use waits for
+        struct State{
+            VkImageLayout           layout          = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2   writeStages     = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2          writeAccess     = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2   readStages      = VK_PIPELINE_STAGE_2_NONE;   // since the last write
+            VkAccessFlags2          readAccess      = VK_ACCESS_2_NONE;
+        };
+
+        struct Resource{
+            const char*             name            = nullptr;
+            bool                    isImage         = true;
+            bool                    imported        = false;
+            bool                    output          = false;
+
+            GraphImageDesc          desc;
+            VkImageAspectFlags      aspect          = 0;
+            VkImage                 image           = VK_NULL_HANDLE;
+            VkImageView             view            = VK_NULL_HANDLE;
+            VkImageView             sampledView     = VK_NULL_HANDLE;
+            VkBuffer                buffer          = VK_NULL_HANDLE;
+
+            State                   initial;
+            VkImageLayout           finalLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            // Filled in by compile()
+            VkImageUsageFlags       usage           = 0;
+            uint32_t                firstPass       = UINT32_MAX;
+            uint32_t                lastPass        = 0;
+            bool                    leavesPass      = false;    // loaded or stored by an attachment, or not an attachment at all
+            uint32_t                physical        = UINT32_MAX;
+
+            // During execute()
+            State                   state;
+            bool                    touched         = false;
+        };
+
+        struct Use{
+            GraphResource   resource;
+            GraphUsage      usage;
+            bool            read;
+            bool            write;
+            bool            discards;   // overwrites all of it, earlier contents are dead
+        };
+
+        struct Attachment{
+            GraphResource       resource    = INVALID_GRAPH_RESOURCE;
+            GraphResource       resolve     = INVALID_GRAPH_RESOURCE;
+            VkAttachmentLoadOp  loadOp      = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            VkAttachmentStoreOp storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+            VkClearValue        clear{};
+        };
+
+        struct Pass{
+            const char*             name        = nullptr;
+            Record                  record;
+            bool                    rendering   = false;
+            bool                    sideEffects = false;
+            bool                    culled      = false;
+            std::vector<Use>        uses;
+            std::vector<Attachment> colors;
+            Attachment              depth;
+            bool                    depthWrite  = true;
+            VkExtent2D              area        = {0, 0};   // 0 = the attachments' extent
+        };
+
+        // A transient image and the memory slot it sits in
+        struct PhysicalImage{
+            GraphImageDesc          desc;
+            VkImageUsageFlags       usage       = 0;
+            bool                    lazy        = false;
+            VkImage                 image       = VK_NULL_HANDLE;
+            VkImageView             view        = VK_NULL_HANDLE;     // every aspect
+            VkImageView             sampledView = VK_NULL_HANDLE;     // depth only, or view
+            uint32_t                slot        = 0;
+        };
+
+        // Memory shared by images used one after the other. The state is the
+        // last occupant's, the next one's first barrier waits on it.
+        struct MemorySlot{
+            VkDeviceMemory          memory      = VK_NULL_HANDLE;
+            VkDeviceSize            size        = 0;
+            uint32_t                typeBits    = 0;
+            bool                    lazy        = false;
+            uint32_t                lastPass    = 0;
+            State                   state;
+        };
+
+        // What compile() decided about a transient, unchanged means the images can stay
+        struct Placement{
+            GraphImageDesc          desc;
+            VkImageUsageFlags       usage;
+            bool                    lazy;
+            uint32_t                firstPass;
+            uint32_t                lastPass;
+        };
+
+        Pass& pass(GraphPass);
+        void addUse(GraphPass, GraphResource, GraphUsage, bool read, bool write, bool discards);
+        void cull();
+        void placeTransients();
+        void createTransients();
+        void destroyTransients();
+        void transition(const Use&);
+        void flushBarriers(VkCommandBuffer);
+        void beginRendering(VkCommandBuffer, const Pass&);
+
+        VkDevice                            mDevice         = VK_NULL_HANDLE;
+        VkPhysicalDevice                    mPhysicalDevice = VK_NULL_HANDLE;
+
+        // Reused from frame to frame, only the first `count` are this frame's
+        std::vector<Pass>                   mPasses;
+        uint32_t                            mPassCount      = 0;
+        std::vector<Resource>               mResources;
+        uint32_t                            mResourceCount  = 0;
+
+        std::vector<PhysicalImage>          mPhysical;
+        std::vector<MemorySlot>             mSlots;
+        std::vector<Placement>              mPlacements;
+        std::vector<Placement>              mNewPlacements;
+        std::vector<uint32_t>               mTransients;    // resource indices, by first pass
+        std::vector<uint8_t>                mLive;
+
+        std::vector<VkImageMemoryBarrier2>  mImageBarriers;
+        VkMemoryBarrier2                    mMemoryBarrier{};
+        std::vector<VkRenderingAttachmentInfo> mColorInfos;
+
+        Stats                               mStats;
+        GpuProfiler*                        mProfiler       = nullptr;
+};
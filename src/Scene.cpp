@@ -0,0 +1,161 @@
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+NodeId Scene::createNode(NodeId parent){
+    if(parent != INVALID_NODE && parent >= parents.size()){
+        throw std::runtime_error("scene node parent does not exist");
+    }
+
+    NodeId id = static_cast<NodeId>(parents.size());
+
+    parents.push_back(parent);
+    translations.push_back(glm::vec3(0.0f));
+    rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scales.push_back(glm::vec3(1.0f));
+    worldMatrices.push_back(glm::mat4(1.0f));
+    localBounds.push_back(glm::vec4(0.0f));
+    boundsX.push_back(0.0f);
+    boundsY.push_back(0.0f);
+    boundsZ.push_back(0.0f);
+    boundsRadius.push_back(0.0f);
+    renderHandles.push_back(RenderHandle{});
+    lodLevels.push_back(0);
+    movedAt.push_back(0);
+    mDirty.push_back(0);
+    mChanged.push_back(0);
+
+    mMarkDirty(id);
+
+    return id;
+}
+
+void Scene::reserve(size_t count){
+    parents.reserve(count);
+    translations.reserve(count);
+    rotations.reserve(count);
+    scales.reserve(count);
+    worldMatrices.reserve(count);
+    localBounds.reserve(count);
+    boundsX.reserve(count);
+    boundsY.reserve(count);
+    boundsZ.reserve(count);
+    boundsRadius.reserve(count);
+    renderHandles.reserve(count);
+    lodLevels.reserve(count);
+    movedAt.reserve(count);
+    mDirty.reserve(count);
+    mChanged.reserve(count);
+}
+
+void Scene::clear(){
+    parents.clear();
+    translations.clear();
+    rotations.clear();
+    scales.clear();
+    worldMatrices.clear();
+    localBounds.clear();
+    boundsX.clear();
+    boundsY.clear();
+    boundsZ.clear();
+    boundsRadius.clear();
+    renderHandles.clear();
+    lodLevels.clear();
+    movedAt.clear();
+    mDirty.clear();
+    mChanged.clear();
+    mChangedNodes.clear();
+    mFirstDirty = SIZE_MAX;
+}
+
+void Scene::setTranslation(NodeId node, const glm::vec3& translation){
+    translations[node] = translation;
+    mMarkDirty(node);
+}
+
+void Scene::setRotation(NodeId node, const glm::quat& rotation){
+    rotations[node] = rotation;
+    mMarkDirty(node);
+}
+
+void Scene::setScale(NodeId node, const glm::vec3& scale){
+    scales[node] = scale;
+    mMarkDirty(node);
+}
+
+void Scene::setLocalBounds(NodeId node, const glm::vec3& center, float radius){
+    localBounds[node] = glm::vec4(center, radius);
+    mMarkDirty(node);
+}
+
+void Scene::setRenderHandle(NodeId node, const RenderHandle& handle){
+    renderHandles[node] = handle;
+}
+
+size_t Scene::size() const{
+    return parents.size();
+}
+
+uint32_t Scene::updates() const{
+    return mUpdates;
+}
+
+void Scene::mMarkDirty(NodeId node){
+    mDirty[node] = 1;
+    mFirstDirty = std::min(mFirstDirty, static_cast<size_t>(node));
+}
+
+void Scene::updateTransforms(){
+    mUpdates++;
+
+    if(mFirstDirty == SIZE_MAX){
+        return;
+    }
+
+    const size_t count = parents.size();
+
+    // Only what the last update touched, not every node
+    for(NodeId node : mChangedNodes){
+        mChanged[node] = 0;
+    }
+    mChangedNodes.clear();
+
+    for(size_t i = mFirstDirty; i < count; i++){
+        NodeId parent = parents[i];
+        bool parentChanged = parent != INVALID_NODE && mChanged[parent];
+
+        if(!mDirty[i] && !parentChanged){
+            continue;
+        }
+
+        // T * R * S without going through three full matrix products
+        glm::mat4 local = glm::mat4_cast(rotations[i]);
+        local[0] *= scales[i].x;
+        local[1] *= scales[i].y;
+        local[2] *= scales[i].z;
+        local[3] = glm::vec4(translations[i], 1.0f);
+
+        glm::mat4& world = worldMatrices[i];
+        world = parent == INVALID_NODE ? local : worldMatrices[parent] * local;
+
+        // Sphere radius grows with the largest axis scale of the world matrix
+        glm::vec4 center = world * glm::vec4(glm::vec3(localBounds[i]), 1.0f);
+        float maxScale = std::max({glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+                                   glm::dot(glm::vec3(world[1]), glm::vec3(world[1])),
+                                   glm::dot(glm::vec3(world[2]), glm::vec3(world[2]))});
+
+        boundsX[i]      = center.x;
+        boundsY[i]      = center.y;
+        boundsZ[i]      = center.z;
+        boundsRadius[i] = localBounds[i].w * std::sqrt(maxScale);
+
+        mDirty[i]   = 0;
+        mChanged[i] = 1;
+        movedAt[i]  = mUpdates;
+        mChangedNodes.push_back(static_cast<NodeId>(i));
+    }
+
+    mFirstDirty = SIZE_MAX;
+}
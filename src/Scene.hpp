@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using NodeId = uint32_t;
+const NodeId INVALID_NODE = UINT32_MAX;
+
+// What the renderer draws for a node, indices into the renderer's tables
+struct RenderHandle{
+    uint32_t mesh       = UINT32_MAX;   // UINT32_MAX: nothing to draw
+    uint32_t material   = 0;
+};
+
+/**
+ * Scene nodes stored as structure of arrays. A node can only be parented to a
+ * node that already exists, so parents always come before their children and
+ * a single forward pass over the arrays visits the hierarchy top down.
+ *
+ * Setters only mark the node dirty; updateTransforms() recomputes world data
+ * for dirty nodes and everything below them, starting at the first dirty index.
+**/
+
+class Scene{
+    public:
+        NodeId createNode(NodeId parent = INVALID_NODE);
+        void reserve(size_t);
+        void clear();
+
+        void setTranslation(NodeId, const glm::vec3&);
+        void setRotation(NodeId, const glm::quat&);
+        void setScale(NodeId, const glm::vec3&);
+        void setLocalBounds(NodeId, const glm::vec3& center, float radius);
+        void setRenderHandle(NodeId, const RenderHandle&);
+
+        void updateTransforms();
+
+        size_t size() const;
+
+        // How many times updateTransforms() has run, the clock of movedAt
+        uint32_t updates() const;
+
+        // Hierarchy and local transform
+        std::vector<NodeId>         parents;
+        std::vector<glm::vec3>      translations;
+        std::vector<glm::quat>      rotations;
+        std::vector<glm::vec3>      scales;
+
+        // Results of updateTransforms(), one entry per node
+        std::vector<glm::mat4>      worldMatrices;
+
+        // Local bounding sphere (xyz center, w radius)
+        std::vector<glm::vec4>      localBounds;
+
+        // World bounding spheres split per component so the culler can load
+        // 4/8 consecutive nodes straight into SIMD registers
+        std::vector<float>          boundsX;
+        std::vector<float>          boundsY;
+        std::vector<float>          boundsZ;
+        std::vector<float>          boundsRadius;
+
+        std::vector<RenderHandle>   renderHandles;
+
+        // LOD the renderer picked last frame, kept for hysteresis
+        std::vector<uint8_t>        lodLevels;
+
+        // The update whose results last changed the node's world data, so
+        // updates() - movedAt is how long it has been standing still
+        std::vector<uint32_t>       movedAt;
+
+    private:
+        std::vector<uint8_t>        mDirty;     // local data changed since last update
+        std::vector<uint8_t>        mChanged;   // world data changed in the last update
+        std::vector<NodeId>         mChangedNodes;  // where mChanged is set
+        size_t                      mFirstDirty = SIZE_MAX;
+        uint32_t                    mUpdates    = 0;
+
+        void mMarkDirty(NodeId);
+};
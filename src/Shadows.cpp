@@ -0,0 +1,552 @@
+#include "Shadows.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "vkutil.hpp"
+
+void CascadedShadows::init(VkDevice device,
+                           VkPhysicalDevice physicalDevice,
+                           const MeshManager& meshes,
+                           uint32_t framesInFlight,
+                           uint32_t cascadeSize){
+    mDevice         = device;
+    mMeshes         = &meshes;
+    mCascadeSize    = cascadeSize;
+
+    // D32 where it renders, samples and copies, D16 is guaranteed to
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                  VK_FORMAT_FEATURE_TRANSFER_SRC_BIT |
+                                  VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &properties);
+    mFormat = (properties.optimalTilingFeatures & needed) == needed ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, mFormat, &properties);
+
+    // Images
+    // .........................................................................
+
+    uint32_t atlasSize = cascadeSize * 2;
+
+    createImage(mDevice, physicalDevice, atlasSize, atlasSize, 1, VK_SAMPLE_COUNT_1_BIT, mFormat,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                mCache, mCacheMemory);
+    mCacheView = createImageView(mDevice, mCache, mFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    createImage(mDevice, physicalDevice, atlasSize, atlasSize, 1, VK_SAMPLE_COUNT_1_BIT, mFormat,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                mMap, mMapMemory);
+    mMapView = createImageView(mDevice, mMap, mFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // Depth compares in the sampler; filtered, that's 2x2 PCF in every tap
+    VkFilter filter = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ?
+                      VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType           = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter       = filter;
+    samplerInfo.minFilter       = filter;
+    samplerInfo.mipmapMode      = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareEnable   = VK_TRUE;
+    samplerInfo.compareOp       = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.maxLod          = 0.0f;
+
+    if(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler) != VK_SUCCESS){
+        throw std::runtime_error("failed to create shadow sampler");
+    }
+
+    // Descriptors
+    // .........................................................................
+
+    // 0 the shadow map, 1 params
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding         = 0;
+    bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].binding         = 1;
+    bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings    = bindings;
+
+    if(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("failed to create shadow descriptor set layout");
+    }
+    mSignature = setLayoutSignature(layoutInfo);
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount    = framesInFlight;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount    = framesInFlight;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets        = framesInFlight;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+
+    if(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create shadow descriptor pool");
+    }
+
+    mFrames.resize(framesInFlight);
+    for(Frame& frame : mFrames){
+        createBuffer(mDevice, physicalDevice, sizeof(ShadowParams),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     frame.params, frame.paramsMemory);
+
+        vkMapMemory(mDevice, frame.paramsMemory, 0, sizeof(ShadowParams), 0, reinterpret_cast<void**>(&frame.mappedParams));
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool        = mPool;
+        allocInfo.descriptorSetCount    = 1;
+        allocInfo.pSetLayouts           = &mSetLayout;
+
+        if(vkAllocateDescriptorSets(mDevice, &allocInfo, &frame.set) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate shadow descriptor set");
+        }
+
+        // The graph leaves the map ready for sampling at the end of every frame
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler       = mSampler;
+        imageInfo.imageView     = mMapView;
+        imageInfo.imageLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer   = frame.params;
+        bufferInfo.offset   = 0;
+        bufferInfo.range    = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet            = frame.set;
+        writes[0].dstBinding        = 0;
+        writes[0].descriptorCount   = 1;
+        writes[0].descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo        = &imageInfo;
+        writes[1].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet            = frame.set;
+        writes[1].dstBinding        = 1;
+        writes[1].descriptorCount   = 1;
+        writes[1].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo       = &bufferInfo;
+
+        vkUpdateDescriptorSets(mDevice, 2, writes, 0, nullptr);
+    }
+}
+
+void CascadedShadows::cleanup(){
+    for(Frame& frame : mFrames){
+        vkUnmapMemory(mDevice, frame.paramsMemory);
+        vkDestroyBuffer(mDevice, frame.params, nullptr);
+        vkFreeMemory(mDevice, frame.paramsMemory, nullptr);
+    }
+    mFrames.clear();
+
+    vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mSetLayout, nullptr);
+    vkDestroySampler(mDevice, mSampler, nullptr);
+
+    vkDestroyImageView(mDevice, mMapView, nullptr);
+    vkDestroyImage(mDevice, mMap, nullptr);
+    vkFreeMemory(mDevice, mMapMemory, nullptr);
+    vkDestroyImageView(mDevice, mCacheView, nullptr);
+    vkDestroyImage(mDevice, mCache, nullptr);
+    vkFreeMemory(mDevice, mCacheMemory, nullptr);
+}
+
+// Fitting
+// .............................................................................
+
+void CascadedShadows::prepare(uint32_t frame, const Scene& scene, const glm::mat4& view, const glm::mat4& projection){
+    mFrame  = frame;
+    mScene  = &scene;
+    mStats  = Stats();
+
+    uint32_t cascadeCount = std::clamp(settings.cascades, 1u, MAX_CASCADES);
+    glm::vec3 direction = glm::normalize(settings.direction);
+
+    if(direction != mDirection || settings.casterDistance != mCasterDistance || cascadeCount != mCascadeCount){
+        mDirection      = direction;
+        mCasterDistance = settings.casterDistance;
+        mCascadeCount   = cascadeCount;
+        for(Cascade& cascade : mCascades){
+            cascade.placed      = false;
+            cascade.mapDynamic  = false;
+        }
+    }
+
+    // Clip z = [2][2] * z + [3][2] and clip w = -z, so view depth at ndc 0 and 1
+    float nearPlane = projection[3][2] / projection[2][2];
+    float farPlane  = projection[3][2] / (projection[2][2] + 1.0f);
+    float distance  = std::min(settings.distance, farPlane);
+
+    // Squared slope of the frustum's corner rays off its axis
+    float slope = 1.0f / (projection[0][0] * projection[0][0]) + 1.0f / (projection[1][1] * projection[1][1]);
+
+    glm::mat4 cameraWorld = glm::inverse(view);
+
+    float sliceNear = nearPlane;
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        float t         = float(i + 1) / mCascadeCount;
+        float even      = nearPlane + (distance - nearPlane) * t;
+        float spread    = nearPlane * std::pow(distance / nearPlane, t);
+        float sliceFar  = even + (spread - even) * settings.splitLambda;
+
+        // Smallest sphere around the slice: on the axis, as far from the near
+        // corners as from the far ones, unless that's past the far plane
+        float depth     = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + slope), sliceFar);
+        float radius    = std::sqrt((sliceFar - depth) * (sliceFar - depth) + sliceFar * sliceFar * slope);
+        glm::vec3 center = glm::vec3(cameraWorld * glm::vec4(0.0f, 0.0f, -depth, 1.0f));
+
+        // Rounded up, so float noise as the camera turns can't change it
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        Cascade& cascade = mCascades[i];
+        float reach = radius * (1.0f + settings.margin);
+        bool inside = cascade.placed &&
+                      glm::length(center - cascade.center) + radius <= cascade.radius &&
+                      reach > cascade.radius * 0.5f;
+        if(!inside){
+            place(cascade, center, reach);
+        }
+
+        sliceNear = sliceFar;
+    }
+
+    // Casters
+    // .........................................................................
+
+    for(Cascade& cascade : mCascades){
+        cascade.staticCasters.clear();
+        cascade.dynamicCasters.clear();
+    }
+
+    // Nodes new since the last frame start out moving, they just got placed
+    size_t nodeCount = scene.size();
+    mMoving.resize(nodeCount, 1);
+    mStaticBounds.resize(nodeCount, glm::vec4(0.0f));
+
+    uint32_t now = scene.updates();
+
+    for(uint32_t node = 0; node < nodeCount; node++){
+        if(scene.renderHandles[node].mesh == UINT32_MAX) continue;
+
+        glm::vec4 bounds(scene.boundsX[node], scene.boundsY[node], scene.boundsZ[node], scene.boundsRadius[node]);
+        bool moving = now - scene.movedAt[node] < settings.settleUpdates;
+
+        // Leaves the cache where it stood, or joins it where it stopped
+        if(moving != (mMoving[node] != 0)){
+            invalidate(moving ? mStaticBounds[node] : bounds);
+            mStaticBounds[node] = bounds;
+            mMoving[node]       = moving;
+        }
+
+        if(!moving) continue;
+
+        for(uint32_t i = 0; i < mCascadeCount; i++){
+            if(overlaps(mCascades[i], bounds)){
+                mCascades[i].dynamicCasters.push_back(node);
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        Cascade& cascade = mCascades[i];
+        bool dynamic = !cascade.dynamicCasters.empty();
+
+        // Last frame's moving casters have to go too, not only this frame's
+        cascade.drawCache   = !cascade.cached;
+        cascade.copy        = cascade.drawCache || dynamic || cascade.mapDynamic;
+        cascade.mapDynamic  = dynamic;
+        cascade.cached      = true;
+
+        if(cascade.drawCache){
+            for(uint32_t node = 0; node < nodeCount; node++){
+                if(mMoving[node] || scene.renderHandles[node].mesh == UINT32_MAX) continue;
+
+                glm::vec4 bounds(scene.boundsX[node], scene.boundsY[node], scene.boundsZ[node], scene.boundsRadius[node]);
+                if(overlaps(cascade, bounds)){
+                    cascade.staticCasters.push_back(node);
+                }
+            }
+        }
+
+        mStats.cachedCascades   += cascade.drawCache ? 1 : 0;
+        mStats.copiedCascades   += cascade.copy ? 1 : 0;
+        mStats.staticCasters    += static_cast<uint32_t>(cascade.staticCasters.size());
+        mStats.dynamicCasters   += static_cast<uint32_t>(cascade.dynamicCasters.size());
+    }
+
+    // Clip xy of [-1, 1] to the cascade's [0, 1] square, Vulkan's y already points down
+    glm::mat4 toSquare(1.0f);
+    toSquare[0][0] = 0.5f;
+    toSquare[1][1] = 0.5f;
+    toSquare[3][0] = 0.5f;
+    toSquare[3][1] = 0.5f;
+
+    ShadowParams params{};
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        params.cascades[i]      = toSquare * mCascades[i].viewProjection;
+        params.normalOffsets[i] = settings.normalOffset * 2.0f * mCascades[i].radius / mCascadeSize;
+    }
+    params.direction    = mDirection;
+    params.cascadeCount = mCascadeCount;
+    params.color        = settings.color;
+    params.atlasTexel   = 1.0f / (2.0f * mCascadeSize);
+
+    *mFrames[frame].mappedParams = params;
+}
+
+// A cascade covering the sphere at `center`, with its texel grid fixed in the
+// light's view. Its cache is gone.
+void CascadedShadows::place(Cascade& cascade, const glm::vec3& center, float radius) const{
+    glm::vec3 up = std::abs(mDirection.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 light = glm::lookAt(glm::vec3(0.0f), mDirection, up);
+
+    float texel = 2.0f * radius / mCascadeSize;
+    glm::vec3 snapped = glm::vec3(light * glm::vec4(center, 1.0f));
+    snapped.x = std::floor(snapped.x / texel) * texel;
+    snapped.y = std::floor(snapped.y / texel) * texel;
+
+    cascade.placed  = true;
+    cascade.cached  = false;
+    cascade.center  = glm::vec3(glm::inverse(light) * glm::vec4(snapped, 1.0f));
+    cascade.radius  = radius;
+
+    // Depth starts casterDistance toward the light and ends behind the sphere
+    cascade.view = glm::lookAt(cascade.center - mDirection * (radius + mCasterDistance), cascade.center, up);
+    cascade.viewProjection = glm::orthoRH_ZO(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + mCasterDistance) * cascade.view;
+}
+
+// Whether a world bounding sphere can cast into the cascade
+bool CascadedShadows::overlaps(const Cascade& cascade, const glm::vec4& bounds) const{
+    glm::vec3 position = glm::vec3(cascade.view * glm::vec4(glm::vec3(bounds), 1.0f));
+    float reach = cascade.radius + bounds.w;
+    float depth = -position.z;
+
+    return std::abs(position.x) <= reach &&
+           std::abs(position.y) <= reach &&
+           depth + bounds.w >= 0.0f &&
+           depth - bounds.w <= 2.0f * cascade.radius + mCasterDistance;
+}
+
+void CascadedShadows::invalidate(const glm::vec4& bounds){
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        Cascade& cascade = mCascades[i];
+        if(cascade.placed && overlaps(cascade, bounds)){
+            cascade.cached = false;
+        }
+    }
+}
+
+// Recording
+// .............................................................................
+
+GraphResource CascadedShadows::addPasses(RenderGraph& graph, VkPipeline pipeline, VkPipelineLayout layout){
+    mPipeline       = pipeline;
+    mPipelineLayout = layout;
+
+    bool drawCache  = false;
+    bool copy       = false;
+    bool dynamic    = false;
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        drawCache   |= mCascades[i].drawCache;
+        copy        |= mCascades[i].copy;
+        dynamic     |= !mCascades[i].dynamicCasters.empty();
+    }
+
+    VkExtent2D extent = {mCascadeSize * 2, mCascadeSize * 2};
+
+    // Waits for last frame's reads before writing; a frame that only samples
+    // the map waits for nothing
+    GraphImportedImage map{};
+    map.image           = mMap;
+    map.view            = mMapView;
+    map.format          = mFormat;
+    map.extent          = extent;
+    map.initialLayout   = mMapLayout;
+    map.initialStages   = copy || dynamic ? VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_2_NONE;
+    map.finalLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    GraphResource shadowMap = graph.importImage("shadow map", map);
+    mMapLayout = map.finalLayout;
+
+    if(!copy){
+        return shadowMap;
+    }
+
+    GraphImportedImage cache{};
+    cache.image         = mCache;
+    cache.view          = mCacheView;
+    cache.format        = mFormat;
+    cache.extent        = extent;
+    cache.initialLayout = mCacheLayout;
+    cache.initialStages = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    cache.finalLayout   = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    GraphResource shadowCache = graph.importImage("shadow cache", cache);
+    mCacheLayout = cache.finalLayout;
+
+    // Clears its own cascades, the others keep what they have
+    if(drawCache){
+        GraphPass pass = graph.addRenderPass("shadow cache", [this](VkCommandBuffer commandBuffer){
+            recordCache(commandBuffer);
+        });
+        graph.depth(pass, shadowCache, VK_ATTACHMENT_LOAD_OP_LOAD);
+    }
+
+    GraphPass copyPass = graph.addPass("shadow copy", [this](VkCommandBuffer commandBuffer){
+        recordCopy(commandBuffer);
+    });
+    graph.read(copyPass, shadowCache, GraphUsage::Transfer);
+    graph.write(copyPass, shadowMap, GraphUsage::Transfer);
+
+    if(dynamic){
+        GraphPass pass = graph.addRenderPass("shadows", [this](VkCommandBuffer commandBuffer){
+            recordDynamic(commandBuffer);
+        });
+        graph.depth(pass, shadowMap, VK_ATTACHMENT_LOAD_OP_LOAD);
+    }
+
+    return shadowMap;
+}
+
+void CascadedShadows::recordCache(VkCommandBuffer commandBuffer) const{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+    mMeshes->bind(commandBuffer);
+
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        if(!mCascades[i].drawCache) continue;
+
+        setViewport(commandBuffer, i);
+
+        VkClearAttachment clear{};
+        clear.aspectMask                = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clear.clearValue.depthStencil   = {1.0f, 0};
+
+        VkClearRect rect{};
+        rect.rect.offset    = {int32_t(i % 2 * mCascadeSize), int32_t(i / 2 * mCascadeSize)};
+        rect.rect.extent    = {mCascadeSize, mCascadeSize};
+        rect.layerCount     = 1;
+
+        vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
+
+        recordCasters(commandBuffer, i, mCascades[i].staticCasters);
+    }
+}
+
+void CascadedShadows::recordCopy(VkCommandBuffer commandBuffer) const{
+    VkImageCopy regions[MAX_CASCADES]{};
+    uint32_t regionCount = 0;
+
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        if(!mCascades[i].copy) continue;
+
+        VkImageCopy& region = regions[regionCount++];
+        region.srcSubresource   = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1};
+        region.srcOffset        = {int32_t(i % 2 * mCascadeSize), int32_t(i / 2 * mCascadeSize), 0};
+        region.dstSubresource   = region.srcSubresource;
+        region.dstOffset        = region.srcOffset;
+        region.extent           = {mCascadeSize, mCascadeSize, 1};
+    }
+
+    vkCmdCopyImage(commandBuffer,
+                   mCache, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   mMap, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   regionCount, regions);
+}
+
+void CascadedShadows::recordDynamic(VkCommandBuffer commandBuffer) const{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+    mMeshes->bind(commandBuffer);
+
+    for(uint32_t i = 0; i < mCascadeCount; i++){
+        if(mCascades[i].dynamicCasters.empty()) continue;
+
+        setViewport(commandBuffer, i);
+        recordCasters(commandBuffer, i, mCascades[i].dynamicCasters);
+    }
+}
+
+// Farther cascades have bigger texels, so they take coarser LODs
+void CascadedShadows::recordCasters(VkCommandBuffer commandBuffer, uint32_t cascade, const std::vector<uint32_t>& nodes) const{
+    const glm::mat4& viewProjection = mCascades[cascade].viewProjection;
+
+    MeshPushConstants constants{};
+
+    for(uint32_t node : nodes){
+        const RenderHandle& handle = mScene->renderHandles[node];
+        const GpuMesh& mesh = mMeshes->get(handle.mesh);
+        const MeshLod& lod  = mesh.lods[std::min<size_t>(cascade, mesh.lods.size() - 1)];
+
+        const glm::mat4& world  = mScene->worldMatrices[node];
+        glm::mat4 worldRows     = glm::transpose(world);
+
+        constants.transform     = viewProjection * world;
+        constants.world[0]      = worldRows[0];
+        constants.world[1]      = worldRows[1];
+        constants.world[2]      = worldRows[2];
+        constants.materialIndex = handle.material;
+        constants.instanceIndex = node;
+
+        vkCmdPushConstants(commandBuffer, mPipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(MeshPushConstants), &constants);
+
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, mesh.firstIndex + lod.indexOffset, mesh.vertexOffset, 0);
+    }
+}
+
+void CascadedShadows::setViewport(VkCommandBuffer commandBuffer, uint32_t cascade) const{
+    VkViewport viewport{};
+    viewport.x          = float(cascade % 2 * mCascadeSize);
+    viewport.y          = float(cascade / 2 * mCascadeSize);
+    viewport.width      = float(mCascadeSize);
+    viewport.height     = float(mCascadeSize);
+    viewport.minDepth   = 0.0f;
+    viewport.maxDepth   = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset  = {int32_t(viewport.x), int32_t(viewport.y)};
+    scissor.extent  = {mCascadeSize, mCascadeSize};
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void CascadedShadows::bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t set) const{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1, &mFrames[mFrame].set, 0, nullptr);
+}
+
+VkDescriptorSetLayout CascadedShadows::layout() const{
+    return mSetLayout;
+}
+
+uint64_t CascadedShadows::layoutSignature() const{
+    return mSignature;
+}
+
+VkFormat CascadedShadows::format() const{
+    return mFormat;
+}
+
+const CascadedShadows::Stats& CascadedShadows::stats() const{
+    return mStats;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+#include "MeshManager.hpp"
+#include "RenderGraph.hpp"
+#include "Scene.hpp"
+
+// The directional light and how its shadows are laid out, read every frame.
+// Distances are world units.
+struct ShadowSettings{
+    glm::vec3   direction       = glm::vec3(-0.4f, -1.0f, -0.3f);  // the light travels along, normalized on use
+    glm::vec3   color           = glm::vec3(2.0f);                  // times intensity
+    uint32_t    cascades        = 4;        // 1 to MAX_CASCADES
+    float       distance        = 150.0f;   // view depth the last cascade reaches, at most the far plane
+    float       splitLambda     = 0.75f;    // 0 splits evenly, 1 logarithmically
+    float       margin          = 0.2f;     // cascades cover this much more than the view needs, so they seldom move
+    float       casterDistance  = 100.0f;   // how far toward the light geometry still casts into a cascade
+    uint32_t    settleUpdates   = 30;       // scene updates a node has to stand still to count as static
+    float       normalOffset    = 1.5f;     // texels the lookup moves out along the normal, against acne
+};
+
+// What the fragment shader reads, the second binding. std430, must match
+// `ShadowParams` in shader/shadow_common.glsl
+struct ShadowParams{
+    glm::mat4   cascades[4];    // world to the cascade's [0, 1] square, depth in z
+    glm::vec4   normalOffsets;  // world units, per cascade
+    glm::vec3   direction;
+    uint32_t    cascadeCount;
+    glm::vec3   color;
+    float       atlasTexel;     // 1 / atlas size
+};
+
+/**
+ * Cascaded shadow maps for one directional light. The view depth up to
+ * `distance` is split into cascades, each covered by a bounding sphere of
+ * its slice of the view frustum: a sphere doesn't change size as the camera
+ * turns, and its center is snapped to whole texels of the light's view, so
+ * a cascade's texel grid never swims.
+ *
+ * Cascades are also sticky. Each covers `margin` more than its slice needs
+ * and stays put until the slice leaves it, and while it stays put what the
+ * static geometry casts into it stays the same too. That is kept in a cache
+ * atlas, 2x2 cascades in one depth image:
+ *
+ *  - "shadow cache" re-renders the static casters of cascades that moved or
+ *    whose static geometry changed, only those,
+ *  - "shadow copy" copies the cache into the shadow map for cascades that
+ *    have something moving in them, or had last frame,
+ *  - "shadows" draws the moving casters on top.
+ *
+ * A cascade with nothing moving through it costs nothing after its cache is
+ * drawn, the map already holds what the cache does. A node counts as moving
+ * until it has stood still for `settleUpdates` scene updates; when it stops,
+ * or starts again, the cascades it was in redraw their cache.
+ *
+ * Casters are indexed mesh draws with a depth only pipeline from the caller,
+ * coarser LODs in farther cascades. Needs dynamic rendering; both atlases are
+ * shared by the frames in flight, the graph orders each frame's use after the
+ * last one's.
+**/
+
+class CascadedShadows{
+    public:
+        static constexpr uint32_t MAX_CASCADES = 4;
+
+        struct Stats{
+            uint32_t    cachedCascades  = 0;    // cache redrawn this frame
+            uint32_t    copiedCascades  = 0;    // map refreshed from the cache
+            uint32_t    staticCasters   = 0;    // draws into the cache
+            uint32_t    dynamicCasters  = 0;    // draws into the map
+        };
+
+        // `cascadeSize` squared texels per cascade
+        void init(VkDevice, VkPhysicalDevice, const MeshManager&, uint32_t framesInFlight, uint32_t cascadeSize);
+        void cleanup();
+
+        // Fits the cascades to the camera and sorts the scene's meshes into
+        // what each cascade has to draw. For the frame in flight `frame`,
+        // whose previous submission the caller has already waited for; after
+        // the scene's transforms are updated.
+        void prepare(uint32_t frame, const Scene&, const glm::mat4& view, const glm::mat4& projection);
+
+        // Adds the passes the prepared frame needs and returns the shadow
+        // map, for the scene to read as GraphUsage::SampledFragment.
+        // `pipeline` draws casters: mesh vertex input, depth only in format(),
+        // taking MeshPushConstants through `layout`.
+        GraphResource addPasses(RenderGraph&, VkPipeline pipeline, VkPipelineLayout layout);
+
+        // Binds the prepared frame's set for the fragment shader, `set` of `layout`
+        void bind(VkCommandBuffer, VkPipelineLayout, uint32_t set) const;
+
+        VkDescriptorSetLayout layout() const;
+        uint64_t layoutSignature() const;      // setLayoutSignature() of layout()
+        VkFormat format() const;
+        const Stats& stats() const;
+
+        ShadowSettings settings;
+
+    private:
+        struct Cascade{
+            bool        placed          = false;
+            bool        cached          = false;    // the cache holds this placement's static casters
+            bool        mapDynamic      = false;    // the map has moving casters drawn over the cache
+            glm::vec3   center          = glm::vec3(0.0f);
+            float       radius          = 0.0f;
+            glm::mat4   view            = glm::mat4(1.0f);
+            glm::mat4   viewProjection  = glm::mat4(1.0f);
+
+            // This frame's
+            bool        drawCache       = false;
+            bool        copy            = false;
+            std::vector<uint32_t> staticCasters;
+            std::vector<uint32_t> dynamicCasters;
+        };
+
+        struct Frame{
+            VkBuffer            params          = VK_NULL_HANDLE;
+            VkDeviceMemory      paramsMemory    = VK_NULL_HANDLE;
+            ShadowParams*       mappedParams    = nullptr;
+            VkDescriptorSet     set             = VK_NULL_HANDLE;
+        };
+
+        void place(Cascade&, const glm::vec3& center, float radius) const;
+        bool overlaps(const Cascade&, const glm::vec4& bounds) const;
+        void invalidate(const glm::vec4& bounds);
+        void recordCache(VkCommandBuffer) const;
+        void recordCopy(VkCommandBuffer) const;
+        void recordDynamic(VkCommandBuffer) const;
+        void recordCasters(VkCommandBuffer, uint32_t cascade, const std::vector<uint32_t>& nodes) const;
+        void setViewport(VkCommandBuffer, uint32_t cascade) const;
+
+        VkDevice                mDevice         = VK_NULL_HANDLE;
+        const MeshManager*      mMeshes         = nullptr;
+        VkFormat                mFormat         = VK_FORMAT_UNDEFINED;
+        uint32_t                mCascadeSize    = 0;
+
+        // Cascade i sits at (i % 2, i / 2) cascades from the top left of both
+        VkImage                 mCache          = VK_NULL_HANDLE;
+        VkDeviceMemory          mCacheMemory    = VK_NULL_HANDLE;
+        VkImageView             mCacheView      = VK_NULL_HANDLE;
+        VkImageLayout           mCacheLayout    = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImage                 mMap            = VK_NULL_HANDLE;
+        VkDeviceMemory          mMapMemory      = VK_NULL_HANDLE;
+        VkImageView             mMapView        = VK_NULL_HANDLE;
+        VkImageLayout           mMapLayout      = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkSampler               mSampler        = VK_NULL_HANDLE;
+        VkDescriptorSetLayout   mSetLayout      = VK_NULL_HANDLE;
+        uint64_t                mSignature      = 0;
+        VkDescriptorPool        mPool           = VK_NULL_HANDLE;
+        std::vector<Frame>      mFrames;
+        uint32_t                mFrame          = 0;
+
+        // What the placements were made for, a change moves every cascade
+        glm::vec3               mDirection      = glm::vec3(0.0f);
+        float                   mCasterDistance = 0.0f;
+        uint32_t                mCascadeCount   = 0;
+
+        Cascade                 mCascades[MAX_CASCADES];
+
+        // Per scene node: whether it was moving at the last prepare, and
+        // where it was when it stopped
+        std::vector<uint8_t>    mMoving;
+        std::vector<glm::vec4>  mStaticBounds;
+
+        // This frame's
+        const Scene*            mScene          = nullptr;
+        VkPipeline              mPipeline       = VK_NULL_HANDLE;
+        VkPipelineLayout        mPipelineLayout = VK_NULL_HANDLE;
+        Stats                   mStats;
+};
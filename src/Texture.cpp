@@ -0,0 +1,481 @@
+#include "Texture.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#include "vkutil.hpp"
+
+// SamplerCache
+// .............................................................................
+
+bool SamplerKey::operator==(const SamplerKey& other) const{
+    return magFilter        == other.magFilter &&
+           minFilter        == other.minFilter &&
+           mipmapMode       == other.mipmapMode &&
+           addressModeU     == other.addressModeU &&
+           addressModeV     == other.addressModeV &&
+           addressModeW     == other.addressModeW &&
+           mipLodBias       == other.mipLodBias &&
+           maxAnisotropy    == other.maxAnisotropy &&
+           compareEnable    == other.compareEnable &&
+           compareOp        == other.compareOp &&
+           minLod           == other.minLod &&
+           maxLod           == other.maxLod &&
+           borderColor      == other.borderColor;
+}
+
+static void hashCombine(size_t& seed, size_t value){
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t SamplerKeyHash::operator()(const SamplerKey& key) const{
+    size_t seed = 0;
+    hashCombine(seed, std::hash<int>()(key.magFilter));
+    hashCombine(seed, std::hash<int>()(key.minFilter));
+    hashCombine(seed, std::hash<int>()(key.mipmapMode));
+    hashCombine(seed, std::hash<int>()(key.addressModeU));
+    hashCombine(seed, std::hash<int>()(key.addressModeV));
+    hashCombine(seed, std::hash<int>()(key.addressModeW));
+    hashCombine(seed, std::hash<float>()(key.mipLodBias));
+    hashCombine(seed, std::hash<float>()(key.maxAnisotropy));
+    hashCombine(seed, std::hash<int>()(key.compareEnable));
+    hashCombine(seed, std::hash<int>()(key.compareOp));
+    hashCombine(seed, std::hash<float>()(key.minLod));
+    hashCombine(seed, std::hash<float>()(key.maxLod));
+    hashCombine(seed, std::hash<int>()(key.borderColor));
+    return seed;
+}
+
+void SamplerCache::init(VkDevice device){
+    mDevice = device;
+}
+
+VkSampler SamplerCache::get(const SamplerKey& key){
+    auto it = mSamplers.find(key);
+    if(it != mSamplers.end()){
+        return it->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter               = key.magFilter;
+    samplerInfo.minFilter               = key.minFilter;
+    samplerInfo.mipmapMode              = key.mipmapMode;
+    samplerInfo.addressModeU            = key.addressModeU;
+    samplerInfo.addressModeV            = key.addressModeV;
+    samplerInfo.addressModeW            = key.addressModeW;
+    samplerInfo.mipLodBias              = key.mipLodBias;
+    samplerInfo.anisotropyEnable        = key.maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy           = key.maxAnisotropy;
+    samplerInfo.compareEnable           = key.compareEnable;
+    samplerInfo.compareOp               = key.compareOp;
+    samplerInfo.minLod                  = key.minLod;
+    samplerInfo.maxLod                  = key.maxLod;
+    samplerInfo.borderColor             = key.borderColor;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkSampler sampler;
+    if(vkCreateSampler(mDevice, &samplerInfo, nullptr, &sampler) != VK_SUCCESS){
+        throw std::runtime_error("failed to create sampler");
+    }
+
+    mSamplers.emplace(key, sampler);
+
+    return sampler;
+}
+
+size_t SamplerCache::size() const{
+    return mSamplers.size();
+}
+
+void SamplerCache::cleanup(){
+    for(auto& entry : mSamplers){
+        vkDestroySampler(mDevice, entry.second, nullptr);
+    }
+    mSamplers.clear();
+}
+
+// TextureManager
+// .............................................................................
+
+void TextureManager::init(VkDevice device,
+                          VkPhysicalDevice physicalDevice,
+                          VkQueue queue,
+                          uint32_t queueFamilyIndex,
+                          float maxAnisotropy){
+    mDevice         = device;
+    mPhysicalDevice = physicalDevice;
+    mQueue          = queue;
+    mMaxAnisotropy  = maxAnisotropy;
+
+    samplers.init(device);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex   = queueFamilyIndex;
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool) != VK_SUCCESS){
+        throw std::runtime_error("failed to create upload command pool");
+    }
+}
+
+void TextureManager::cleanup(){
+    for(auto& texture : mTextures){
+        vkDestroyImageView(mDevice, texture.view, nullptr);
+        vkDestroyImage(mDevice, texture.image, nullptr);
+        vkFreeMemory(mDevice, texture.memory, nullptr);
+    }
+    mTextures.clear();
+
+    samplers.cleanup();
+
+    vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+}
+
+TextureCompressionSupport TextureManager::compressionSupport() const{
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(mPhysicalDevice, &features);
+
+    TextureCompressionSupport support;
+    support.bc      = features.textureCompressionBC == VK_TRUE;
+    support.etc2    = features.textureCompressionETC2 == VK_TRUE;
+    support.astc    = features.textureCompressionASTC_LDR == VK_TRUE;
+
+    return support;
+}
+
+bool TextureManager::formatSupported(VkFormat format) const{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, format, &props);
+
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+const Texture& TextureManager::get(uint32_t index) const{
+    return mTextures[index];
+}
+
+size_t TextureManager::count() const{
+    return mTextures.size();
+}
+
+uint32_t TextureManager::createTexture(const TextureData& data, const SamplerKey& samplerKey){
+    if(data.levels.empty()){
+        throw std::runtime_error("texture has no pixel data");
+    }
+
+    Texture texture;
+    texture.format  = data.format;
+    texture.width   = data.width;
+    texture.height  = data.height;
+
+    // Block compressed formats can't be blitted, their chain has to come from the file
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, data.format, &props);
+
+    const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                              VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    bool generateMips = data.generateMips &&
+                        data.levels.size() == 1 &&
+                        (props.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+    texture.mipLevels = generateMips ?
+        static_cast<uint32_t>(std::floor(std::log2(std::max(data.width, data.height)))) + 1 :
+        static_cast<uint32_t>(data.levels.size());
+
+    // Pack every provided level into one staging buffer. Offsets stay 16 byte
+    // aligned, which satisfies the texel block size of every format we load.
+    std::vector<VkDeviceSize> offsets(data.levels.size());
+    VkDeviceSize stagingSize = 0;
+    for(size_t i = 0; i < data.levels.size(); i++){
+        offsets[i]   = stagingSize;
+        stagingSize += (data.levels[i].size() + 15) & ~VkDeviceSize(15);
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    createBuffer(mDevice, mPhysicalDevice, stagingSize,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 stagingBuffer, stagingMemory);
+
+    void* mapped;
+    vkMapMemory(mDevice, stagingMemory, 0, stagingSize, 0, &mapped);
+    for(size_t i = 0; i < data.levels.size(); i++){
+        memcpy(static_cast<uint8_t*>(mapped) + offsets[i], data.levels[i].data(), data.levels[i].size());
+    }
+    vkUnmapMemory(mDevice, stagingMemory);
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if(generateMips){
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    createImage(mDevice, mPhysicalDevice,
+                texture.width, texture.height,
+                texture.mipLevels,
+                VK_SAMPLE_COUNT_1_BIT,
+                texture.format,
+                usage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                0,
+                texture.image,
+                texture.memory);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands(mDevice, mCommandPool);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask                   = 0;
+    barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = texture.image;
+    barrier.subresourceRange                = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    std::vector<VkBufferImageCopy> regions(data.levels.size());
+    for(uint32_t i = 0; i < regions.size(); i++){
+        regions[i].bufferOffset                     = offsets[i];
+        regions[i].bufferRowLength                  = 0;
+        regions[i].bufferImageHeight                = 0;
+        regions[i].imageSubresource                 = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+        regions[i].imageOffset                      = {0, 0, 0};
+        regions[i].imageExtent                      = {std::max(1u, texture.width >> i),
+                                                       std::max(1u, texture.height >> i),
+                                                       1};
+    }
+
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()), regions.data());
+
+    if(generateMips){
+        mGenerateMips(commandBuffer, texture);
+    } else {
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    endSingleTimeCommands(mDevice, mCommandPool, mQueue, commandBuffer);
+
+    vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
+    vkFreeMemory(mDevice, stagingMemory, nullptr);
+
+    texture.view = createImageView(mDevice, texture.image, texture.format,
+                                   VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
+
+    SamplerKey key = samplerKey;
+    key.maxAnisotropy = std::min(key.maxAnisotropy, mMaxAnisotropy);
+    texture.sampler = samplers.get(key);
+
+    mTextures.push_back(texture);
+
+    return static_cast<uint32_t>(mTextures.size() - 1);
+}
+
+/**
+ * Downsamples level i-1 into level i with linear blits. Each level moves to
+ * SHADER_READ_ONLY as soon as it has been used as a blit source.
+**/
+
+void TextureManager::mGenerateMips(VkCommandBuffer commandBuffer, const Texture& texture){
+    VkImageMemoryBarrier barrier{};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image                           = texture.image;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange                = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    int32_t mipWidth  = static_cast<int32_t>(texture.width);
+    int32_t mipHeight = static_cast<int32_t>(texture.height);
+
+    for(uint32_t i = 1; i < texture.mipLevels; i++){
+        barrier.subresourceRange.baseMipLevel   = i - 1;
+        barrier.oldLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        int32_t nextWidth  = mipWidth > 1 ? mipWidth / 2 : 1;
+        int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0]      = {0, 0, 0};
+        blit.srcOffsets[1]      = {mipWidth, mipHeight, 1};
+        blit.srcSubresource     = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1};
+        blit.dstOffsets[0]      = {0, 0, 0};
+        blit.dstOffsets[1]      = {nextWidth, nextHeight, 1};
+        blit.dstSubresource     = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+
+        vkCmdBlitImage(commandBuffer,
+                       texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        mipWidth  = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // Last level was only ever written
+    barrier.subresourceRange.baseMipLevel   = texture.mipLevels - 1;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask                   = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint32_t TextureManager::loadTexture(const std::string& basePath, const SamplerKey& samplerKey){
+    TextureCompressionSupport support = compressionSupport();
+
+    // Smallest / best quality first, uncompressed as the last resort
+    struct Variant{ const char* suffix; bool allowed; };
+    const Variant variants[] = {
+        {".bc7.ktx",  support.bc},
+        {".astc.ktx", support.astc},
+        {".etc2.ktx", support.etc2},
+        {".ktx",      true}
+    };
+
+    for(const Variant& variant : variants){
+        if(!variant.allowed) continue;
+
+        TextureData data;
+        if(loadKTX((basePath + variant.suffix).c_str(), data) && formatSupported(data.format)){
+            return createTexture(data, samplerKey);
+        }
+    }
+
+    throw std::runtime_error("failed to load texture " + basePath);
+}
+
+// KTX 1.1
+// .............................................................................
+
+// glInternalFormat -> VkFormat for the formats we ship
+static VkFormat vkFormatFromGL(uint32_t glInternalFormat){
+    switch(glInternalFormat){
+        case 0x8058: return VK_FORMAT_R8G8B8A8_UNORM;           // GL_RGBA8
+        case 0x8C43: return VK_FORMAT_R8G8B8A8_SRGB;            // GL_SRGB8_ALPHA8
+        case 0x83F0: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;      // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+        case 0x83F1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;     // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+        case 0x83F2: return VK_FORMAT_BC2_UNORM_BLOCK;          // GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+        case 0x83F3: return VK_FORMAT_BC3_UNORM_BLOCK;          // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        case 0x8C4C: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;       // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+        case 0x8C4F: return VK_FORMAT_BC3_SRGB_BLOCK;           // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+        case 0x8DBB: return VK_FORMAT_BC4_UNORM_BLOCK;          // GL_COMPRESSED_RED_RGTC1
+        case 0x8DBD: return VK_FORMAT_BC5_UNORM_BLOCK;          // GL_COMPRESSED_RG_RGTC2
+        case 0x8E8C: return VK_FORMAT_BC7_UNORM_BLOCK;          // GL_COMPRESSED_RGBA_BPTC_UNORM
+        case 0x8E8D: return VK_FORMAT_BC7_SRGB_BLOCK;           // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+        case 0x9274: return VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;  // GL_COMPRESSED_RGB8_ETC2
+        case 0x9275: return VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;   // GL_COMPRESSED_SRGB8_ETC2
+        case 0x9278: return VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;// GL_COMPRESSED_RGBA8_ETC2_EAC
+        case 0x9279: return VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK; // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+        case 0x93B0: return VK_FORMAT_ASTC_4x4_UNORM_BLOCK;     // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+        case 0x93B4: return VK_FORMAT_ASTC_6x6_UNORM_BLOCK;     // GL_COMPRESSED_RGBA_ASTC_6x6_KHR
+        case 0x93B7: return VK_FORMAT_ASTC_8x8_UNORM_BLOCK;     // GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+        case 0x93D0: return VK_FORMAT_ASTC_4x4_SRGB_BLOCK;      // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+        case 0x93D4: return VK_FORMAT_ASTC_6x6_SRGB_BLOCK;      // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR
+        case 0x93D7: return VK_FORMAT_ASTC_8x8_SRGB_BLOCK;      // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR
+        default:     return VK_FORMAT_UNDEFINED;
+    }
+}
+
+bool loadKTX(const char* path, TextureData& data){
+    std::string _path = logl_root;
+    _path += path;
+
+    FILE *f = fopen(_path.c_str(), "rb");
+    if(f == nullptr){
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    std::vector<uint8_t> file(fsize);
+    size_t read = fread(file.data(), 1, fsize, f);
+    fclose(f);
+
+    const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    const size_t headerSize = 64;
+    if(read != file.size() || file.size() < headerSize || memcmp(file.data(), identifier, 12) != 0){
+        return false;
+    }
+
+    uint32_t header[13];
+    memcpy(header, file.data() + 12, sizeof(header));
+
+    enum { Endianness, GlType, GlTypeSize, GlFormat, GlInternalFormat, GlBaseInternalFormat,
+           PixelWidth, PixelHeight, PixelDepth, ArrayElements, Faces, MipLevels, KeyValueBytes };
+
+    // Only plain, native endian 2D textures
+    if(header[Endianness] != 0x04030201 || header[PixelDepth] > 1 ||
+       header[ArrayElements] > 1 || header[Faces] != 1){
+        return false;
+    }
+
+    data.format = vkFormatFromGL(header[GlInternalFormat]);
+    if(data.format == VK_FORMAT_UNDEFINED){
+        return false;
+    }
+
+    data.width          = header[PixelWidth];
+    data.height         = std::max(1u, header[PixelHeight]);
+    data.generateMips   = true;
+    data.levels.clear();
+
+    uint32_t mipLevels = std::max(1u, header[MipLevels]);
+    size_t offset = headerSize + header[KeyValueBytes];
+
+    for(uint32_t level = 0; level < mipLevels; level++){
+        uint32_t imageSize;
+        if(offset + sizeof(imageSize) > file.size()) return false;
+        memcpy(&imageSize, file.data() + offset, sizeof(imageSize));
+        offset += sizeof(imageSize);
+
+        if(offset + imageSize > file.size()) return false;
+        data.levels.emplace_back(file.begin() + offset, file.begin() + offset + imageSize);
+
+        // mipPadding
+        offset += (imageSize + 3) & ~3u;
+    }
+
+    return true;
+}
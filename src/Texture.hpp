@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+struct Texture{
+    VkImage         image       = VK_NULL_HANDLE;
+    VkDeviceMemory  memory      = VK_NULL_HANDLE;
+    VkImageView     view        = VK_NULL_HANDLE;
+    VkSampler       sampler     = VK_NULL_HANDLE;
+    VkFormat        format      = VK_FORMAT_UNDEFINED;
+    uint32_t        width       = 0;
+    uint32_t        height      = 0;
+    uint32_t        mipLevels   = 1;
+};
+
+// CPU side pixels for one texture. `levels` holds one entry per mip level that
+// is already present; when only the base level is given and the format can be
+// blitted, the rest of the chain is generated on the GPU.
+struct TextureData{
+    VkFormat                            format  = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t                            width   = 0;
+    uint32_t                            height  = 0;
+    std::vector<std::vector<uint8_t>>   levels;
+    bool                                generateMips = true;
+};
+
+// Which block compressed families the device can sample from
+struct TextureCompressionSupport{
+    bool bc     = false;
+    bool etc2   = false;
+    bool astc   = false;
+};
+
+// Sampler state that matters for deduplication, VkSamplerCreateInfo minus sType/pNext
+struct SamplerKey{
+    VkFilter                magFilter       = VK_FILTER_LINEAR;
+    VkFilter                minFilter       = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode     mipmapMode      = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode    addressModeU    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode    addressModeV    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode    addressModeW    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    float                   mipLodBias      = 0.0f;
+    float                   maxAnisotropy   = 1.0f;
+    VkBool32                compareEnable   = VK_FALSE;
+    VkCompareOp             compareOp       = VK_COMPARE_OP_ALWAYS;
+    float                   minLod          = 0.0f;
+    float                   maxLod          = VK_LOD_CLAMP_NONE;
+    VkBorderColor           borderColor     = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    bool operator==(const SamplerKey&) const;
+};
+
+struct SamplerKeyHash{
+    size_t operator()(const SamplerKey&) const;
+};
+
+class SamplerCache{
+    public:
+        void init(VkDevice);
+        VkSampler get(const SamplerKey&);
+        size_t size() const;
+        void cleanup();
+
+    private:
+        VkDevice mDevice = VK_NULL_HANDLE;
+        std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> mSamplers;
+};
+
+/**
+ * Owns every texture. Uploads go through a staging buffer on the graphics
+ * queue; textures are addressed by index so they can later be bound bindlessly.
+**/
+
+class TextureManager{
+    public:
+        void init(VkDevice, VkPhysicalDevice, VkQueue, uint32_t, float maxAnisotropy = 1.0f);
+        void cleanup();
+
+        uint32_t createTexture(const TextureData&, const SamplerKey& = SamplerKey{});
+
+        // Loads the best variant the device supports: <base>.bc7.ktx, <base>.astc.ktx,
+        // <base>.etc2.ktx and finally the uncompressed <base>.ktx
+        uint32_t loadTexture(const std::string&, const SamplerKey& = SamplerKey{});
+
+        const Texture& get(uint32_t) const;
+        size_t count() const;
+
+        TextureCompressionSupport compressionSupport() const;
+        bool formatSupported(VkFormat) const;
+
+        SamplerCache samplers;
+
+    private:
+        VkDevice            mDevice         = VK_NULL_HANDLE;
+        VkPhysicalDevice    mPhysicalDevice = VK_NULL_HANDLE;
+        VkQueue             mQueue          = VK_NULL_HANDLE;
+        VkCommandPool       mCommandPool    = VK_NULL_HANDLE;
+        float               mMaxAnisotropy  = 1.0f;
+
+        std::vector<Texture> mTextures;
+
+        void mGenerateMips(VkCommandBuffer, const Texture&);
+};
+
+// Parses a KTX 1.1 container. Returns false when the file is missing or its
+// internal format has no Vulkan equivalent we handle.
+bool loadKTX(const char*, TextureData&);
@@ -1,6 +1,8 @@
 #include "MyApp.hpp"
 #include <cstdlib>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 MyApp::MyApp(int width, int height, const char* title) : 
             App(width, height, title)
 {
@@ -8,11 +10,69 @@ MyApp::MyApp(int width, int height, const char* title) :
 }
 
 void MyApp::initDraw(){
+    float aspect = (float) mSwapChain.swapChainExtent.width / (float) mSwapChain.swapChainExtent.height;
+
+    // Depth in [0, 1] to match Vulkan clip space, Y flipped so +Y is up on screen
+    mCamera.projection = glm::perspectiveRH_ZO(glm::radians(60.0f), aspect, 0.1f, 1000.0f);
+    mCamera.projection[1][1] *= -1.0f;
+
+    // Cooked offline with MeshCook, the built in triangle is drawn either way
+    uint32_t mesh = mMeshes.load("/assets/model.mesh");
+    if(mesh == UINT32_MAX){
+        return;
+    }
+
+    glm::vec4 bounds = mMeshes.get(mesh).bounds;
+
+    mCamera.view = glm::lookAt(glm::vec3(bounds) + glm::vec3(0.0f, 0.0f, 3.0f * bounds.w),
+                               glm::vec3(bounds),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // A row of copies going into the distance, the far ones drop to coarser LODs
+    NodeId root = mScene.createNode();
+    for(int i = 0; i < 32; i++){
+        NodeId node = mScene.createNode(root);
+
+        mScene.setTranslation(node, glm::vec3(0.0f, 0.0f, -3.0f * bounds.w * i));
+        mScene.setLocalBounds(node, glm::vec3(bounds), bounds.w);
+        mScene.setRenderHandle(node, RenderHandle{mesh, 0});
+    }
+
+    // Thousands of small lights around the row, each only reaching a few
+    // copies; every fourth a spot pointing down
+    srand(1);
+    auto random = [](float low, float high){
+        return low + (high - low) * (rand() / float(RAND_MAX));
+    };
+
+    mLights.reserve(4096);
+    for(int i = 0; i < 4096; i++){
+        glm::vec3 position = glm::vec3(bounds) + glm::vec3(random(-2.0f, 2.0f) * bounds.w,
+                                                           random(-1.0f, 2.0f) * bounds.w,
+                                                           random(-96.0f, 1.0f) * bounds.w);
+        glm::vec3 color = glm::vec3(random(0.2f, 1.0f), random(0.2f, 1.0f), random(0.2f, 1.0f)) * bounds.w * bounds.w;
+        float range = random(0.5f, 1.5f) * bounds.w;
+
+        if(i % 4 == 0){
+            mLights.push_back(spotLight(position, glm::vec3(0.0f, -1.0f, 0.0f), range * 2.0f, color * 4.0f,
+                                        glm::radians(20.0f), glm::radians(35.0f)));
+        } else {
+            mLights.push_back(pointLight(position, range, color));
+        }
+    }
 
+    // The sun's shadows reach halfway down the row, cast by copies close by
+    mShadows.settings.distance          = 48.0f * bounds.w;
+    mShadows.settings.casterDistance    = 8.0f * bounds.w;
 }
 
 void MyApp::draw(){
-    vkWaitForFences(mInstance.device, 1, &mRenderPass.inFlightFences[mRenderPass.currentFrame], VK_TRUE, UINT64_MAX);
+    if(useTimeline()){
+        drawTimeline();
+        return;
+    }
+
+    // The frame slot's fence was already waited on before input was sampled
 
     uint32_t imageIndex;
     vkAcquireNextImageKHR(mInstance.device,
@@ -30,27 +90,17 @@ void MyApp::draw(){
     // Mark this image as now being in use by this frame
     mRenderPass.imagesInFlight[imageIndex] = mRenderPass.inFlightFences[mRenderPass.currentFrame];
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore waitSemaphores[]        = {mRenderPass.imageAvailableSemaphores[mRenderPass.currentFrame]};
-    VkPipelineStageFlags waitStages[]   = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount       = 1;
-    submitInfo.pWaitSemaphores          = waitSemaphores;
-    submitInfo.pWaitDstStageMask        = waitStages;
-
-    submitInfo.commandBufferCount       = 1;
-    submitInfo.pCommandBuffers          = &mRenderPass.commandBuffers[imageIndex];
+    recordCommandBuffer(imageIndex);
 
     VkSemaphore signalSemaphores[]       = {mRenderPass.renderFinishedSemaphores[mRenderPass.currentFrame]};
-    submitInfo.signalSemaphoreCount     = 1;
-    submitInfo.pSignalSemaphores        = signalSemaphores;
 
     vkResetFences(mInstance.device, 1, &mRenderPass.inFlightFences[mRenderPass.currentFrame]);
 
-    if(vkQueueSubmit(mQueue.graphicsQueue, 1, &submitInfo, mRenderPass.inFlightFences[mRenderPass.currentFrame]) != VK_SUCCESS){
-        throw std::runtime_error("failed to submit draw command buffer");
-    }
+    submit(mQueue.graphicsQueue,
+           1, &mRenderPass.commandBuffers[imageIndex],
+           mRenderPass.imageAvailableSemaphores[mRenderPass.currentFrame], acquireWaitStage(),
+           1, signalSemaphores, nullptr,
+           mRenderPass.inFlightFences[mRenderPass.currentFrame]);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType                   = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -71,13 +121,56 @@ void MyApp::draw(){
     mRenderPass.currentFrame = (mRenderPass.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void MyApp::processInput(){
-    if(keyPressed(GLFW_KEY_ESCAPE)){
+void MyApp::drawTimeline(){
+    // The frame slot was already waited on before input was sampled
+
+    uint32_t imageIndex;
+    vkAcquireNextImageKHR(mInstance.device,
+                          mSwapChain.swapChain,
+                          UINT64_MAX,
+                          mRenderPass.imageAvailableSemaphores[mRenderPass.currentFrame],
+                          VK_NULL_HANDLE,
+                          &imageIndex);
+
+    // Command buffers are per image, wait for the last frame that recorded into this one
+    waitTimeline(mTimeline.imageValues[imageIndex]);
+
+    recordCommandBuffer(imageIndex);
+
+    uint64_t frameValue = submitTimeline(mQueue.graphicsQueue,
+                                         1, &mRenderPass.commandBuffers[imageIndex],
+                                         mRenderPass.imageAvailableSemaphores[mRenderPass.currentFrame],
+                                         acquireWaitStage(),
+                                         mRenderPass.renderFinishedSemaphores[mRenderPass.currentFrame]);
+
+    mTimeline.frameValues[mRenderPass.currentFrame] = frameValue;
+    mTimeline.imageValues[imageIndex]               = frameValue;
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType                   = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount      = 1;
+    presentInfo.pWaitSemaphores         = &mRenderPass.renderFinishedSemaphores[mRenderPass.currentFrame];
+
+    VkSwapchainKHR swapchains[] = {mSwapChain.swapChain};
+    presentInfo.swapchainCount          = 1;
+    presentInfo.pSwapchains             = swapchains;
+    presentInfo.pImageIndices           = &imageIndex;
+
+    // No queue idle here, the timeline already bounds how far ahead the CPU runs
+    vkQueuePresentKHR(mQueue.presentQueue, &presentInfo);
+
+    mRenderPass.currentFrame = (mRenderPass.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void MyApp::processInput(const InputState& input){
+    if(input.keyDown(GLFW_KEY_ESCAPE)){
         terminate();
     }
+
+    processMouse(input);
 }
 
-void MyApp::processMouse(){
+void MyApp::processMouse(const InputState& input){
 
 }
 
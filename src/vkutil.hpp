@@ -5,15 +5,21 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <initializer_list>
 #include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #include <optional>
 #include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <shaderc/shaderc.hpp>
 
 #include "../configuration/root_directory.h"
 
-VkShaderModule createShaderModule(VkDevice device, const std::vector<char> & code){
+inline VkShaderModule createShaderModule(VkDevice device, const std::vector<char> & code){
     VkShaderModuleCreateInfo createInfo{};
     VkShaderModule shaderModule;
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -27,6 +33,20 @@ VkShaderModule createShaderModule(VkDevice device, const std::vector<char> & cod
     return shaderModule;
 }
 
+inline VkShaderModule createShaderModule(VkDevice device, const std::vector<uint32_t> & code){
+    VkShaderModuleCreateInfo createInfo{};
+    VkShaderModule shaderModule;
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS){
+        throw std::runtime_error("failed to create shader module");
+    }
+
+    return shaderModule;
+}
+
 inline std::vector<char> readFile(const char* path){
     std::string _path = logl_root;
     _path += path;
@@ -44,6 +64,79 @@ inline std::vector<char> readFile(const char* path){
     return buffer;
 }
 
+// Resolves `#include "file"` against the shader directory
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface{
+    struct Include{
+        std::string             name;
+        std::vector<char>       content;
+        shaderc_include_result  result;
+    };
+
+    shaderc_include_result* GetInclude(const char* requested, shaderc_include_type, const char*, size_t) override{
+        Include* include = new Include;
+        include->name = std::string("/shader/") + requested;
+
+        std::string _path = logl_root;
+        _path += include->name;
+
+        FILE *f = fopen(_path.c_str(), "rb");
+        if(f != nullptr){
+            fclose(f);
+            include->content = readFile(include->name.c_str());
+        } else {
+            // Empty source name and the message as content is how shaderc reports it
+            static const char message[] = "include file not found";
+            include->name.clear();
+            include->content.assign(message, message + sizeof(message) - 1);
+        }
+
+        include->result.source_name         = include->name.c_str();
+        include->result.source_name_length  = include->name.size();
+        include->result.content             = include->content.data();
+        include->result.content_length      = include->content.size();
+        include->result.user_data           = include;
+
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override{
+        delete static_cast<Include*>(result->user_data);
+    }
+};
+
+// Compiles a GLSL file (relative to the project root) to SPIR-V with shaderc.
+// Used for shaders that don't have a prebuilt blob in shader/spv. `defines`
+// are passed as preprocessor macros to select shader variants, `#include`
+// resolves against shader/.
+inline std::vector<uint32_t> compileShader(const char* path,
+                                           shaderc_shader_kind kind,
+                                           const std::vector<std::string>& defines = {}){
+    std::vector<char> source = readFile(path);
+
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    options.SetIncluder(std::make_unique<ShaderIncluder>());
+    for(const std::string& define : defines){
+        // "NAME" or "NAME=VALUE", like -D
+        size_t equals = define.find('=');
+        if(equals == std::string::npos){
+            options.AddMacroDefinition(define);
+        } else {
+            options.AddMacroDefinition(define.substr(0, equals), define.substr(equals + 1));
+        }
+    }
+
+    shaderc::SpvCompilationResult result =
+        compiler.CompileGlslToSpv(source.data(), source.size(), kind, path, options);
+
+    if(result.GetCompilationStatus() != shaderc_compilation_status_success){
+        throw std::runtime_error(result.GetErrorMessage());
+    }
+
+    return std::vector<uint32_t>(result.cbegin(), result.cend());
+}
 
 struct SwapChainSupportDetails{
     VkSurfaceCapabilitiesKHR capabilities;
@@ -66,14 +159,14 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
+inline void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
     auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
     if (func != nullptr) {
         func(instance, debugMessenger, pAllocator);
     }
 }
 
-VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats){
+inline VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats){
     for(const auto& availableFormat : availableFormats){
         if(availableFormat.format == VK_FORMAT_B8G8R8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR){
             return availableFormat;
@@ -83,7 +176,7 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
     return availableFormats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes){
+inline VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes){
     for(const auto& availablePresentMode : availablePresentModes){
         if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR){
             return availablePresentMode;
@@ -92,7 +185,7 @@ VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& avai
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window){
+inline VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window){
     if(capabilities.currentExtent.width != UINT32_MAX){
         return capabilities.currentExtent;
     } else {
@@ -141,7 +234,7 @@ inline bool checkValidationSupport(std::vector<const char*> validationLayers){
     return true;
 }
 
-SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice,  VkSurfaceKHR surface){
+inline SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice physicalDevice,  VkSurfaceKHR surface){
     SwapChainSupportDetails details;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &details.capabilities);
 
@@ -212,7 +305,7 @@ inline VkResult CreateDebugUtilsMessengerEXT(
     }
 }
 
-QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface = NULL){
+inline QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface = NULL){
     QueueFamilyIndices indices;
 
     uint32_t queueFamilyCount = 0;
@@ -251,7 +344,7 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
     return indices;
 }
 
-bool checkDeviceExtensionSupport(VkPhysicalDevice device){
+inline bool checkDeviceExtensionSupport(VkPhysicalDevice device){
 
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -283,4 +376,268 @@ inline bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface = NUL
 
 }
 
+// Memory type with all `required` flags, preferring one that also has `preferred`
+// (e.g. LAZILY_ALLOCATED for transient attachments) when the device has it
+inline uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
+                               uint32_t typeFilter,
+                               VkMemoryPropertyFlags required,
+                               VkMemoryPropertyFlags preferred = 0){
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    VkMemoryPropertyFlags wanted[2] = {required | preferred, required};
+
+    for(VkMemoryPropertyFlags properties : wanted){
+        for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++){
+            if((typeFilter & (1 << i)) &&
+               (memProperties.memoryTypes[i].propertyFlags & properties) == properties){
+                return i;
+            }
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type");
+}
+
+inline void createImage(VkDevice device,
+                        VkPhysicalDevice physicalDevice,
+                        uint32_t width, uint32_t height,
+                        uint32_t mipLevels,
+                        VkSampleCountFlagBits samples,
+                        VkFormat format,
+                        VkImageUsageFlags usage,
+                        VkMemoryPropertyFlags required,
+                        VkMemoryPropertyFlags preferred,
+                        VkImage& image,
+                        VkDeviceMemory& memory){
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+    imageInfo.extent        = {width, height, 1};
+    imageInfo.mipLevels     = mipLevels;
+    imageInfo.arrayLayers   = 1;
+    imageInfo.format        = format;
+    imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage         = usage;
+    imageInfo.samples       = samples;
+    imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+    if(vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS){
+        throw std::runtime_error("failed to create image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = memRequirements.size;
+    allocInfo.memoryTypeIndex   = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, required, preferred);
+
+    if(vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate image memory");
+    }
+
+    vkBindImageMemory(device, image, memory, 0);
+}
+
+inline void createBuffer(VkDevice device,
+                         VkPhysicalDevice physicalDevice,
+                         VkDeviceSize size,
+                         VkBufferUsageFlags usage,
+                         VkMemoryPropertyFlags properties,
+                         VkBuffer& buffer,
+                         VkDeviceMemory& memory){
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size         = size;
+    bufferInfo.usage        = usage;
+    bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+    if(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS){
+        throw std::runtime_error("failed to create buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = memRequirements.size;
+    allocInfo.memoryTypeIndex   = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+    if(vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate buffer memory");
+    }
+
+    vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+// One shot command buffers for uploads and other setup work
+inline VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool){
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool           = commandPool;
+    allocInfo.commandBufferCount    = 1;
+
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+inline void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer){
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &commandBuffer;
+
+    if(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS){
+        throw std::runtime_error("failed to submit single time commands");
+    }
+
+    vkQueueWaitIdle(queue);
+
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+inline VkImageView createImageView(VkDevice device,
+                                   VkImage image,
+                                   VkFormat format,
+                                   VkImageAspectFlags aspectFlags,
+                                   uint32_t mipLevels = 1){
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType                              = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image                              = image;
+    viewInfo.viewType                           = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format                             = format;
+    viewInfo.subresourceRange.aspectMask        = aspectFlags;
+    viewInfo.subresourceRange.baseMipLevel      = 0;
+    viewInfo.subresourceRange.levelCount        = mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer    = 0;
+    viewInfo.subresourceRange.layerCount        = 1;
+
+    VkImageView imageView;
+    if(vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS){
+        throw std::runtime_error("failed to create image view");
+    }
+
+    return imageView;
+}
+
+// FNV-1a over 32 bit words, for the signatures below
+inline uint64_t hashWords(uint64_t hash, std::initializer_list<uint32_t> words){
+    for(uint32_t word : words){
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * What a descriptor set layout holds, the same from run to run where its
+ * handle isn't: bindings, their flags and whether they have immutable
+ * samplers (not which ones).
+**/
+
+inline uint64_t setLayoutSignature(const VkDescriptorSetLayoutCreateInfo& info){
+    const VkDescriptorBindingFlags* bindingFlags = nullptr;
+    for(const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(info.pNext); next != nullptr; next = next->pNext){
+        if(next->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO){
+            bindingFlags = reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(next)->pBindingFlags;
+        }
+    }
+
+    uint64_t hash = hashWords(14695981039346656037ull, {info.flags, info.bindingCount});
+    for(uint32_t i = 0; i < info.bindingCount; i++){
+        const VkDescriptorSetLayoutBinding& binding = info.pBindings[i];
+        hash = hashWords(hash, {binding.binding,
+                                static_cast<uint32_t>(binding.descriptorType),
+                                binding.descriptorCount,
+                                binding.stageFlags,
+                                binding.pImmutableSamplers != nullptr,
+                                bindingFlags != nullptr ? bindingFlags[i] : 0u});
+    }
+    return hash;
+}
+
+// A pipeline layout's, from the signatures of its sets in set order and its
+// push constant ranges
+inline uint64_t pipelineLayoutSignature(const std::vector<uint64_t>& sets, const std::vector<VkPushConstantRange>& pushConstants){
+    uint64_t hash = hashWords(14695981039346656037ull, {static_cast<uint32_t>(sets.size())});
+    for(uint64_t set : sets){
+        hash = hashWords(hash, {static_cast<uint32_t>(set), static_cast<uint32_t>(set >> 32)});
+    }
+    for(const VkPushConstantRange& range : pushConstants){
+        hash = hashWords(hash, {range.stageFlags, range.offset, range.size});
+    }
+    return hash;
+}
+
+inline bool hasStencilComponent(VkFormat format){
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+/**
+ * Picks the depth format for the device. A requested format wins when it is
+ * usable, otherwise D32 (native everywhere that matters) then D24S8, with D16
+ * as the format the spec guarantees.
+**/
+
+inline VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, VkFormat requested = VK_FORMAT_UNDEFINED){
+    const VkFormat candidates[] = {
+        requested,
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_D24_UNORM_S8_UINT,
+        VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D16_UNORM
+    };
+
+    for(VkFormat format : candidates){
+        if(format == VK_FORMAT_UNDEFINED) continue;
+
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+        if(props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT){
+            return format;
+        }
+    }
+
+    throw std::runtime_error("failed to find supported depth format");
+}
+
+// Highest sample count not above `requested` usable for both color and depth
+inline VkSampleCountFlagBits getUsableSampleCount(VkPhysicalDevice physicalDevice, VkSampleCountFlagBits requested){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+                                properties.limits.framebufferDepthSampleCounts;
+
+    const VkSampleCountFlagBits candidates[] = {
+        VK_SAMPLE_COUNT_8_BIT,
+        VK_SAMPLE_COUNT_4_BIT,
+        VK_SAMPLE_COUNT_2_BIT
+    };
+
+    for(VkSampleCountFlagBits samples : candidates){
+        if(samples <= requested && (counts & samples)){
+            return samples;
+        }
+    }
+
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
 #endif /** __VK_UTILS_HPP */
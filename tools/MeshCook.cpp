@@ -0,0 +1,92 @@
+// Offline mesh cooker: imports anything Assimp reads, builds the LOD chain,
+// optimises every level for the vertex cache, overdraw and vertex fetch, splits
+// LOD 0 into meshlets for GPU cluster culling and writes the cooked format MeshManager::load() expects.
+//
+//     MeshCook [--pack] <input> <output.mesh> [max lods] [max error, fraction of radius]
+//
+// --pack stores half positions, octahedral normals and half UVs (16 bytes a vertex).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../src/Mesh.hpp"
+#include "../src/MeshCooker.hpp"
+
+int main(int argc, char** argv){
+    bool pack = false;
+    std::vector<const char*> args;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--pack") == 0){
+            pack = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if(args.size() < 2){
+        fprintf(stderr, "usage: %s [--pack] <input> <output.mesh> [max lods] [max error]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    LodSettings settings;
+    if(args.size() > 2) settings.maxLods  = static_cast<uint32_t>(strtoul(args[2], nullptr, 10));
+    if(args.size() > 3) settings.maxError = strtof(args[3], nullptr);
+
+    CookedMesh mesh;
+    if(!importMesh(args[0], mesh)){
+        fprintf(stderr, "failed to import %s\n", args[0]);
+        return EXIT_FAILURE;
+    }
+
+    generateLods(mesh, settings);
+
+    std::vector<VertexCacheStats> before;
+    for(const MeshLod& lod : mesh.lods){
+        before.push_back(analyzeVertexCache(mesh.indices.data() + lod.indexOffset, lod.indexCount, mesh.vertices.size()));
+    }
+
+    size_t importedVertices = mesh.vertices.size();
+
+    optimizeMesh(mesh);
+
+    printf("%s: %zu -> %zu vertices, radius %.3f\n", args[0], importedVertices, mesh.vertices.size(), mesh.bounds.w);
+    for(size_t i = 0; i < mesh.lods.size(); i++){
+        const MeshLod& lod = mesh.lods[i];
+        VertexCacheStats after = analyzeVertexCache(mesh.indices.data() + lod.indexOffset, lod.indexCount, mesh.vertices.size());
+
+        printf("  lod %zu: %8u triangles, error %.5f, acmr %.3f -> %.3f, atvr %.3f -> %.3f\n",
+               i, lod.indexCount / 3, lod.error,
+               before[i].acmr, after.acmr, before[i].atvr, after.atvr);
+    }
+
+    buildMeshlets(mesh);
+
+    if(!mesh.meshlets.empty()){
+        size_t coneCulled = 0;
+        for(const Meshlet& meshlet : mesh.meshlets){
+            if(meshlet.cone.w < 1.0f) coneCulled++;
+        }
+
+        printf("  meshlets: %zu, %.1f triangles and %.1f vertices each, %zu with a normal cone\n",
+               mesh.meshlets.size(),
+               double(mesh.lods[0].indexCount / 3) / mesh.meshlets.size(),
+               double(mesh.meshletVertices.size()) / mesh.meshlets.size(),
+               coneCulled);
+    }
+
+    if(pack){
+        convertVertexFormat(mesh, VertexFormat::Packed);
+        printf("  packed: %zu -> %zu bytes of vertices\n",
+               mesh.packedVertices.size() * sizeof(Vertex), mesh.packedVertices.size() * sizeof(PackedVertex));
+    }
+
+    if(!writeCookedMesh(args[1], mesh)){
+        fprintf(stderr, "failed to write %s\n", args[1]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}